@@ -5,48 +5,119 @@
 #include "ast.h"
 #include "ast_type.h"
 #include "ast_decl.h"
+#include "ast_expr.h"
 #include "symtable.h"
+#include "bast.h"
 #include <string.h> // strdup
 #include <stdio.h>  // printf
 
 Node::Node(yyltype loc) {
     location = new yyltype(loc);
     parent = NULL;
+    height = 0;
 }
 
 Node::Node() {
     location = NULL;
     parent = NULL;
+    height = 0;
 }
 
-SymbolTable* Node::symbolTable = new SymbolTable();
+thread_local SymbolTable* Node::symbolTable = new SymbolTable();
 
-MyStack* Node::loop_switchStack = new MyStack();
+thread_local MyStack* Node::loop_switchStack = new MyStack();
 
-/* The Print method is used to print the parse tree nodes.
- * If this node has a location (most nodes do, but some do not), it
- * will first print the line number to help you match the parse tree 
- * back to the source text. It then indents the proper number of levels 
- * and prints the "print name" of the node. It then will invoke the
- * virtual function PrintChildren which is expected to print the
- * internals of the node (itself & children) as appropriate.
+TreeWalker::TreeWalker(Node *root, const char *label, bool l) : leaves(l) {
+    Frame f = { root, label, 0, false };
+    stack.push_back(f);
+}
+
+bool TreeWalker::Next() {
+    if (stack.empty()) return false;
+    current = stack.back();
+    stack.pop_back();
+    if (current.leaving) return true;
+    if (leaves) {
+        Frame leave = current;
+        leave.leaving = true;
+        stack.push_back(leave);
+    }
+    children.clear();
+    current.node->GetChildren(children);
+    for (int i = children.size() - 1; i >= 0; i--) {
+        Frame f = { children[i].node, children[i].label, current.depth + 1, false };
+        stack.push_back(f);
+    }
+    return true;
+}
+
+/* The Emit method walks the subtree into an AstSink: for each node its
+ * location, print name and label (and, for an expression, the type the
+ * checker gave it), then its value, then its children.
  */
-void Node::Print(int indentLevel, const char *label) { 
-    const int numSpaces = 3;
-    printf("\n");
-    if (GetLocation()) 
-        printf("%*d", numSpaces, GetLocation()->first_line);
-    else 
-        printf("%*s", numSpaces, "");
-    printf("%*s%s%s: ", indentLevel*numSpaces, "", 
-           label? label : "", GetPrintNameForNode());
-   PrintChildren(indentLevel);
-} 
+void Node::Emit(AstSink *w, const char *label) {
+    for (TreeWalker walk(this, label, true); walk.Next(); ) {
+        if (walk.IsLeaving()) {
+            w->EndNode();
+            continue;
+        }
+        Node *n = walk.GetNode();
+        Expr *expr = dynamic_cast<Expr*>(n);
+        w->BeginNode(n->GetPrintNameForNode(), n->GetLocation(), walk.GetLabel(),
+                     expr ? expr->type : NULL);
+        n->EmitValue(w);
+    }
+}
+
+void Node::Check() {
+    struct Frame {
+        Node *node;
+        int checked;
+    };
+    vector<Frame> stack(1, Frame{ this, 0 });
+    while (!stack.empty()) {
+        Frame &top = stack.back();
+        Node *child = top.node->CheckNext(top.checked);
+        if (child == NULL) {
+            stack.pop_back();
+            continue;
+        }
+        top.checked++;
+        stack.push_back(Frame{ child, 0 });
+    }
+}
+
+// The children handed to DeleteChild() and not yet deleted, while it is
+// deleting on this thread
+static thread_local vector<Node*> *doomed;
+
+void Node::DeleteChild(Node *child) {
+    if (child == NULL) return;
+    if (doomed != NULL) {
+        doomed->push_back(child);
+        return;
+    }
+    vector<Node*> pending(1, child);
+    doomed = &pending;
+    while (!pending.empty()) {
+        Node *n = pending.back();
+        pending.pop_back();
+        delete n;
+    }
+    doomed = NULL;
+}
+
+Node *Node::FindTooDeep(int maxDepth) {
+    for (TreeWalker walk(this); walk.Next(); )
+        if (walk.GetDepth() > maxDepth)
+            return walk.GetNode();
+    return NULL;
+}
 	 
 Identifier::Identifier(yyltype loc, const char *n) : Node(loc) {
-    name = strdup(n);
+    name = n;
 } 
 
-void Identifier::PrintChildren(int indentLevel) {
-    printf("%s", name);
+void Identifier::EmitValue(AstSink *w) {
+    w->SetName(name);
 }
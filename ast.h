@@ -20,17 +20,33 @@
  * set up links in both directions. The parent link is typically not used 
  * during parsing, but is more important in later phases.
  *
- * Printing: This functionaility is saved from pp2 of the node classes to 
- * print out the AST tree for debugging purpose.  Each node class is 
- * responsible for printing itself/children by overriding the virtual 
- * PrintChildren() and GetPrintNameForNode() methods. All the classes we 
- * provide already implement these methods, so your job is to construct the
- * nodes and wire them up during parsing. Once that's done, printing is a snap!
+ * Children: Each node class lists its children, in order, by overriding
+ * the virtual GetChildren(), and a leaf that carries a value (a name, an
+ * operator, a constant) hands it over in EmitValue(). Passes over the
+ * whole tree use a TreeWalker, which keeps the nodes still to visit on
+ * a heap-allocated stack instead of recursing, so no depth of nesting
+ * can overflow the C++ stack.
+ *
+ * Printing: Emit() walks the node and its subtree into an AstSink (see
+ * bast.h), either to print it for debugging (-d dumpAST) or to write a
+ * binary AST file (--emit-ast), using GetPrintNameForNode() as the
+ * node's name.
 
  * Semantic analysis: For pp3 you are adding "Check" behavior to the ast
  * node classes. Your semantic analyzer should do an inorder walk on the
  * parse tree, and when visiting each node, verify the particular
  * semantic rules that apply to that construct.
+ *
+ * Depth: nothing that walks the tree recurses. Check() runs each node's
+ * CheckNext() steps from a heap-allocated stack, and the destructors hand
+ * their children to DeleteChild(), which deletes them in a loop. What a
+ * walk takes is its stack, a few words a level, so the parser rejects a
+ * declaration nested more than --max-depth levels as a resource limit
+ * (FindTooDeep() then finds the node to report).
+ *
+ * Ownership: deleting a statement, expression or declaration deletes the
+ * subtree under it. Types and type qualifiers are shared (the built-in
+ * ones are singletons) and are never deleted through the tree.
 
  */
 
@@ -40,54 +56,124 @@
 #include <stdlib.h>   // for NULL
 #include "location.h"
 #include <iostream>
+#include <vector>
 
 using namespace std;
 
+class AstSink;
 class SymbolTable;
 class MyStack;
 class FnDecl;
+class Node;
+
+// A child of a node, with the label it is printed with ("(body) ")
+struct Child {
+    Node *node;
+    const char *label;
+
+    Child(Node *n, const char *l = NULL) : node(n), label(l) {}
+};
 
 class Node  {
   protected:
     yyltype *location;
     Node *parent;
+    int height;        // levels of nodes below this one, see SetParent
 
   public:
     Node(yyltype loc);
     Node();
-    virtual ~Node() {}
+    virtual ~Node() { delete location; }
     
-    static SymbolTable* symbolTable;
-    static MyStack* loop_switchStack;
+    // Each checking thread has its own (see Program::CheckInPhases)
+    static thread_local SymbolTable* symbolTable;
+    static thread_local MyStack* loop_switchStack;
     yyltype *GetLocation()   { return location; }
-    void SetParent(Node *p)  { parent = p; }
+    // Children are complete before they are given a parent (the parse is
+    // bottom-up), so each parent learns its height from its children here
+    void SetParent(Node *p)  { parent = p;
+                               if (p->height <= height) p->height = height + 1; }
     Node *GetParent()        { return parent; }
+    int GetHeight()          { return height; }
 
     virtual const char *GetPrintNameForNode() = 0;
-    
-    // Print() is deliberately _not_ virtual
-    // subclasses should override PrintChildren() instead
-    void Print(int indentLevel, const char *label = NULL); 
-    virtual void PrintChildren(int indentLevel)  {}
 
-    virtual void Check() {}
+    // Appends the node's children, in order
+    virtual void GetChildren(vector<Child> &children)  {}
+
+    // Emit() is deliberately _not_ virtual; subclasses override
+    // GetChildren() and, for a value of their own, EmitValue()
+    void Emit(AstSink *w, const char *label = NULL);
+    virtual void EmitValue(AstSink *w)  {}
+
+    // Returns a node nested more than maxDepth levels below this one,
+    // or NULL if there is none
+    Node *FindTooDeep(int maxDepth);
+
+    // Checks the subtree: runs CheckNext() for the node, then for each
+    // child it returns, from a heap-allocated stack
+    virtual void Check();
+
+    // One step of the node's own check. checked children have been
+    // checked so far (they are the ones the steps before returned);
+    // returns the next child to check, or NULL once the node is done
+    virtual Node *CheckNext(int checked)  { return NULL; }
+
+    // Deletes a child, for the destructors. While one call deletes, the
+    // subtrees the destructors it runs hand over are only queued, so a
+    // subtree of any depth is deleted in a loop
+    static void DeleteChild(Node *child);
 };
    
 
 class Identifier : public Node 
 {
   protected:
-    char *name;
+    const char *name;    // interned by the scanner, not owned
     
   public:
     Identifier(yyltype loc, const char *name);
     const char *GetPrintNameForNode()   { return "Identifier"; }
-    char *GetName() const { return name; }
-    void PrintChildren(int indentLevel);
+    const char *GetName() const { return name; }
+    void EmitValue(AstSink *w);
     friend ostream& operator<<(ostream& out, Identifier *id) { return out << id->name; }
 };
 
 
+/* Class: TreeWalker
+ * -----------------
+ * Visits a subtree in preorder without recursion:
+ *
+ *   for (TreeWalker walk(root); walk.Next(); )
+ *       Visit(walk.GetNode(), walk.GetDepth());
+ *
+ * The nodes still to visit are kept on a heap-allocated stack. A node's
+ * children are fetched with GetChildren() when the node is visited. With
+ * leaves set, each node is visited a second time once its subtree is
+ * done, with IsLeaving() true.
+ */
+class TreeWalker {
+    struct Frame {
+        Node *node;
+        const char *label;
+        int depth;
+        bool leaving;
+    };
+    vector<Frame> stack;
+    vector<Child> children;
+    Frame current;
+    bool leaves;
+
+  public:
+    TreeWalker(Node *root, const char *label = NULL, bool leaves = false);
+    bool Next();    // false once the subtree is done
+    Node *GetNode() const        { return current.node; }
+    const char *GetLabel() const { return current.label; }
+    int GetDepth() const         { return current.depth; }    // the root's is 0
+    bool IsLeaving() const       { return current.leaving; }
+};
+
+
 // This node class is designed to represent a portion of the tree that 
 // encountered syntax errors during parsing. The partial completed tree
 // is discarded along with the states being popped, and an instance of
@@ -6,23 +6,30 @@
 #include "ast_type.h"
 #include "ast_stmt.h"
 #include "symtable.h"        
+#include "bast.h"
          
 Decl::Decl(Identifier *n) : Node(*n->GetLocation()) {
     Assert(n != NULL);
     (id=n)->SetParent(this); 
 }
 
+Decl::~Decl() {
+    delete id;
+}
+
 VarDecl::VarDecl(Identifier *n, Type *t, Expr *e) : Decl(n) {
     Assert(n != NULL && t != NULL);
     (type=t)->SetParent(this);
-    if (e) (assignTo=e)->SetParent(this);
+    assignTo = e;
+    if (e) e->SetParent(this);
     typeq = NULL;
 }
 
 VarDecl::VarDecl(Identifier *n, TypeQualifier *tq, Expr *e) : Decl(n) {
     Assert(n != NULL && tq != NULL);
     (typeq=tq)->SetParent(this);
-    if (e) (assignTo=e)->SetParent(this);
+    assignTo = e;
+    if (e) e->SetParent(this);
     type = NULL;
 }
 
@@ -30,35 +37,56 @@ VarDecl::VarDecl(Identifier *n, Type *t, TypeQualifier *tq, Expr *e) : Decl(n) {
     Assert(n != NULL && t != NULL && tq != NULL);
     (type=t)->SetParent(this);
     (typeq=tq)->SetParent(this);
-    if (e) (assignTo=e)->SetParent(this);
+    assignTo = e;
+    if (e) e->SetParent(this);
+}
+
+VarDecl::~VarDecl() {
+    DeleteChild(assignTo);
 }
   
-void VarDecl::PrintChildren(int indentLevel) { 
-   if (typeq) typeq->Print(indentLevel+1);
-   if (type) type->Print(indentLevel+1);
-   if (id) id->Print(indentLevel+1);
-   if (assignTo) assignTo->Print(indentLevel+1, "(initializer) ");
+void VarDecl::GetChildren(vector<Child> &children) {
+   if (typeq) children.push_back(Child(typeq));
+   if (type) children.push_back(Child(type));
+   if (id) children.push_back(Child(id));
+   if (assignTo) children.push_back(Child(assignTo, "(initializer) "));
 }
 
 //Semantic check for VarDecl
-void VarDecl::Check(){
-	//Check if this Variable is declared before in the scope table
-	Symbol varsym(this->GetIdentifier()->GetName(),this,E_VarDecl);
-	Symbol* preVarsym = symbolTable->find(varsym.name);
-	if ( preVarsym != NULL ){
-		ReportError::DeclConflict(this,preVarsym->decl);
-		symbolTable->remove(*preVarsym);
-	}
-
-	symbolTable->insert(varsym);
+Node *VarDecl::CheckNext(int checked){
+	if ( checked == 0 ){
+		//Check if this Variable is declared before in the scope table
+		Symbol varsym(this->GetIdentifier()->GetName(),this,E_VarDecl);
+		Symbol* preVarsym = symbolTable->find(varsym.name);
+		if ( preVarsym != NULL ){
+			ReportError::DeclConflict(this,preVarsym->decl);
+			symbolTable->remove(*preVarsym);
+		}
 
-	if (assignTo != NULL){
-		assignTo->Check();
+		symbolTable->insert(varsym);
 
-		if ( (this->GetType() != assignTo->type ) && ( assignTo->type != Type::errorType ) ){ 
-			ReportError::InvalidInitialization(this->GetIdentifier(), this->GetType(), assignTo->type);
-		}
+		if (assignTo != NULL)
+			return assignTo;
 	}
+	else if ( (this->GetType() != assignTo->type ) && ( assignTo->type != Type::errorType ) ){ 
+		ReportError::InvalidInitialization(this->GetIdentifier(), this->GetType(), assignTo->type);
+	}
+
+	ArrayType* arrType = dynamic_cast<ArrayType*>(this->GetType());
+	if ( arrType != NULL && arrType->GetElemCount() <= 0 )
+		ReportError::InvalidArraySize(this->GetIdentifier(), arrType->GetElemCount());
+	return NULL;
+}
+
+Constant VarDecl::GetConstant() const {
+	if ( typeq != TypeQualifier::constTypeQualifier || assignTo == NULL )
+		return Constant();
+	Constant c = assignTo->GetConstant();
+	if ( (c.kind == Constant::Int && type == Type::intType) ||
+	     (c.kind == Constant::Float && type == Type::floatType) ||
+	     (c.kind == Constant::Bool && type == Type::boolType) )
+		return c;
+	return Constant();
 }
 
 FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
@@ -67,6 +95,7 @@ FnDecl::FnDecl(Identifier *n, Type *r, List<VarDecl*> *d) : Decl(n) {
     (formals=d)->SetParentAll(this);
     body = NULL;
     returnTypeq = NULL;
+    scopes = NULL;
 }
 
 FnDecl::FnDecl(Identifier *n, Type *r, TypeQualifier *rq, List<VarDecl*> *d) : Decl(n) {
@@ -75,34 +104,90 @@ FnDecl::FnDecl(Identifier *n, Type *r, TypeQualifier *rq, List<VarDecl*> *d) : D
     (returnTypeq=rq)->SetParent(this);
     (formals=d)->SetParentAll(this);
     body = NULL;
+    scopes = NULL;
+}
+
+FnDecl::~FnDecl() {
+    if (formals) {
+        formals->DeleteAll();
+        delete formals;
+    }
+    DeleteChild(body);
+    delete scopes;
 }
 
 void FnDecl::SetFunctionBody(Stmt *b) { 
     (body=b)->SetParent(this);
 }
 
-void FnDecl::PrintChildren(int indentLevel) {
-    if (returnType) returnType->Print(indentLevel+1, "(return type) ");
-    if (id) id->Print(indentLevel+1);
-    if (formals) formals->PrintAll(indentLevel+1, "(formals) ");
-    if (body) body->Print(indentLevel+1, "(body) ");
+/* Function: ReleaseBody
+ * ---------------------
+ * Frees the body of a function that has been checked. The declaration
+ * itself stays valid, since calls are checked against its formals and
+ * return type.
+ */
+void FnDecl::ReleaseBody() {
+    DeleteChild(body);
+    body = NULL;
+    delete scopes;
+    scopes = NULL;
+}
+
+void FnDecl::GetChildren(vector<Child> &children) {
+    if (returnType) children.push_back(Child(returnType, "(return type) "));
+    if (id) children.push_back(Child(id));
+    if (formals) formals->AddChildren(children, "(formals) ");
+    if (body) children.push_back(Child(body, "(body) "));
 }
 
 //Semantic Check for Function Declaration
 void FnDecl::Check(){
-	//Check if this function is already declared in the current scope
+	CheckDeclaration();
+	CheckBody();
+}
+
+//Enter the function in the current scope, as an overload of the
+//functions already declared with its name
+void FnDecl::CheckDeclaration(){
 	Symbol Fnsym(this->GetIdentifier()->GetName(),this,E_FunctionDecl);
         Symbol* preFnsym = symbolTable->find(Fnsym.name);
-        if ( preFnsym != NULL ){
+        if ( preFnsym != NULL && preFnsym->overloads == NULL ){
+                //A variable has the name
                 ReportError::DeclConflict(this,preFnsym->decl);
                 symbolTable->remove(*preFnsym);
+                preFnsym = NULL;
+        }
+
+        Fnsym.overloads = preFnsym ? preFnsym->overloads : symbolTable->newOverloadSet();
+        FnDecl* replaced;
+        Fnsym.overloadCount = Fnsym.overloads->add(this, &replaced);
+        if ( replaced != NULL ){
+                //Only functions with different formal types overload
+                ReportError::DeclConflict(this,replaced);
+        }
+        if ( preFnsym != NULL ){
+                symbolTable->remove(*preFnsym);
         }
 
         symbolTable->insert(Fnsym);
-	
+}
+
+//Check the formals and body in a new scope
+void FnDecl::CheckBody(){
 	if ( this->GetBody() != NULL ){
 		symbolTable->returnFound = false;
-		symbolTable->push(); //push new scoped table	
+		if ( SymbolTable::keepScopes ){
+			// a block the check does not reach must not keep a scope
+			// of the last check
+			for ( TreeWalker walk(body); walk.Next(); ){
+				StmtBlock *block = dynamic_cast<StmtBlock*>(walk.GetNode());
+				if ( block != NULL ) block->ForgetScope();
+			}
+			delete scopes;
+			scopes = symbolTable->pushSaved(); //push a scoped table that is kept
+		}
+		else
+			symbolTable->push(); //push new scoped table	
 		List<VarDecl*>* formals = this->GetFormals();
 		for ( int i = 0; i < formals->NumElements(); i++ ){
 			formals->Nth(i)->Check();
@@ -22,6 +22,7 @@ class TypeQualifier;
 class NamedType;
 class Identifier;
 class Stmt;
+class SavedScope;
 
 void yyerror(const char *msg);
 
@@ -33,10 +34,9 @@ class Decl : public Node
   public:
     Decl() : id(NULL) {}
     Decl(Identifier *name);
+    ~Decl();
     Identifier *GetIdentifier() const { return id; }
     friend ostream& operator<<(ostream& out, Decl *d) { return out << d->id; }
-    
-    virtual void Check() = 0;
 };
 
 class VarDecl : public Decl 
@@ -51,10 +51,16 @@ class VarDecl : public Decl
     VarDecl(Identifier *name, Type *type, Expr *assignTo = NULL);
     VarDecl(Identifier *name, TypeQualifier *typeq, Expr *assignTo = NULL);
     VarDecl(Identifier *name, Type *type, TypeQualifier *typeq, Expr *assignTo = NULL);
+    ~VarDecl();
     const char *GetPrintNameForNode() { return "VarDecl"; }
-    void PrintChildren(int indentLevel);
+    void GetChildren(vector<Child> &children);
     Type *GetType() const { return type; }
-    void Check();
+    TypeQualifier *GetTypeQualifier() const { return typeq; }
+    Node *CheckNext(int checked);
+
+    // The value of a const variable whose initializer is constant and of
+    // the variable's type
+    Constant GetConstant() const;
 };
 
 class VarDeclError : public VarDecl
@@ -71,19 +77,26 @@ class FnDecl : public Decl
     Type *returnType;
     TypeQualifier *returnTypeq;
     Stmt *body;
+    SavedScope *scopes;    // kept by CheckBody() if SymbolTable::keepScopes
     
   public:
-    FnDecl() : Decl(), formals(NULL), returnType(NULL), returnTypeq(NULL), body(NULL) {}
+    FnDecl() : Decl(), formals(NULL), returnType(NULL), returnTypeq(NULL), body(NULL),
+               scopes(NULL) {}
     FnDecl(Identifier *name, Type *returnType, List<VarDecl*> *formals);
     FnDecl(Identifier *name, Type *returnType, TypeQualifier *returnTypeq, List<VarDecl*> *formals);
+    ~FnDecl();
     void SetFunctionBody(Stmt *b);
+    void ReleaseBody();
     const char *GetPrintNameForNode() { return "FnDecl"; }
-    void PrintChildren(int indentLevel);
+    void GetChildren(vector<Child> &children);
 
     Type *GetType() const { return returnType; }
+    TypeQualifier *GetTypeQualifier() const { return returnTypeq; }
     List<VarDecl*> *GetFormals() {return formals;}
     Stmt *GetBody() { return body; }
     void Check();
+    void CheckDeclaration();
+    void CheckBody();
 };
 
 class FormalsError : public FnDecl
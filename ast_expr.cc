@@ -3,50 +3,149 @@
  * Implementation of expression node classes.
  */
 
+#include <limits.h>
 #include <string.h>
 #include "ast_expr.h"
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "symtable.h"
+#include "bast.h"
+#include "builtins.h"
+
+void Expr::SetConstant(const Constant &c) {
+    constKind = c.kind;
+    switch (c.kind) {
+      case Constant::Int:   constValue.intValue = c.intValue; break;
+      case Constant::Float: constValue.floatValue = c.floatValue; break;
+      case Constant::Bool:  constValue.boolValue = c.boolValue; break;
+      case Constant::None:  break;
+    }
+}
+
+Constant Expr::GetConstant() const {
+    switch (constKind) {
+      case Constant::Int:   return Constant::OfInt(constValue.intValue);
+      case Constant::Float: return Constant::OfFloat(constValue.floatValue);
+      case Constant::Bool:  return Constant::OfBool(constValue.boolValue);
+    }
+    return Constant();
+}
+
+// Expressions the checker folded carry their value into the emitted AST
+void Expr::EmitValue(AstSink *w) {
+    switch (constKind) {
+      case Constant::Int:   w->SetInt(constValue.intValue); break;
+      case Constant::Float: w->SetFloat(constValue.floatValue); break;
+      case Constant::Bool:  w->SetBool(constValue.boolValue); break;
+    }
+}
+
+void Expr::FoldSubtree(Node *root) {
+    for (TreeWalker walk(root, NULL, true); walk.Next(); )
+        if (walk.IsLeaving())
+            if (Expr *e = dynamic_cast<Expr*>(walk.GetNode()))
+                e->Fold();
+}
+
+/* Binary operators over two constants of the same kind. Integer
+ * arithmetic wraps around rather than overflowing, and a division that
+ * would trap (by zero, or INT_MIN by -1) is left to run time.
+ */
+static Constant FoldInts(const char *op, int a, int b) {
+    unsigned ua = a, ub = b;
+    if (!strcmp(op, "+")) return Constant::OfInt((int)(ua + ub));
+    if (!strcmp(op, "-")) return Constant::OfInt((int)(ua - ub));
+    if (!strcmp(op, "*")) return Constant::OfInt((int)(ua * ub));
+    if (!strcmp(op, "/")) {
+        if (b == 0 || (a == INT_MIN && b == -1)) return Constant();
+        return Constant::OfInt(a / b);
+    }
+    if (!strcmp(op, "==")) return Constant::OfBool(a == b);
+    if (!strcmp(op, "!=")) return Constant::OfBool(a != b);
+    if (!strcmp(op, "<"))  return Constant::OfBool(a < b);
+    if (!strcmp(op, ">"))  return Constant::OfBool(a > b);
+    if (!strcmp(op, "<=")) return Constant::OfBool(a <= b);
+    if (!strcmp(op, ">=")) return Constant::OfBool(a >= b);
+    return Constant();
+}
+
+static Constant FoldFloats(const char *op, double a, double b) {
+    if (!strcmp(op, "+")) return Constant::OfFloat(a + b);
+    if (!strcmp(op, "-")) return Constant::OfFloat(a - b);
+    if (!strcmp(op, "*")) return Constant::OfFloat(a * b);
+    if (!strcmp(op, "/")) return Constant::OfFloat(a / b);
+    if (!strcmp(op, "==")) return Constant::OfBool(a == b);
+    if (!strcmp(op, "!=")) return Constant::OfBool(a != b);
+    if (!strcmp(op, "<"))  return Constant::OfBool(a < b);
+    if (!strcmp(op, ">"))  return Constant::OfBool(a > b);
+    if (!strcmp(op, "<=")) return Constant::OfBool(a <= b);
+    if (!strcmp(op, ">=")) return Constant::OfBool(a >= b);
+    return Constant();
+}
+
+static Constant FoldBools(const char *op, bool a, bool b) {
+    if (!strcmp(op, "==")) return Constant::OfBool(a == b);
+    if (!strcmp(op, "!=")) return Constant::OfBool(a != b);
+    if (!strcmp(op, "&&")) return Constant::OfBool(a && b);
+    if (!strcmp(op, "||")) return Constant::OfBool(a || b);
+    return Constant();
+}
+
+static Constant FoldBinary(Operator *op, const Constant &l, const Constant &r) {
+    if (!l.IsKnown() || l.kind != r.kind) return Constant();
+    switch (l.kind) {
+      case Constant::Int:   return FoldInts(op->GetOpTokStr(), l.intValue, r.intValue);
+      case Constant::Float: return FoldFloats(op->GetOpTokStr(), l.floatValue, r.floatValue);
+      case Constant::Bool:  return FoldBools(op->GetOpTokStr(), l.boolValue, r.boolValue);
+      default:              return Constant();
+    }
+}
 
 IntConstant::IntConstant(yyltype loc, int val) : Expr(loc) {
     value = val;
+    SetConstant(Constant::OfInt(val));
 }
-void IntConstant::PrintChildren(int indentLevel) { 
-    printf("%d", value);
+void IntConstant::EmitValue(AstSink *w) {
+    w->SetInt(value);
 }
 
 //Semantic check for intconstant
-void IntConstant::Check(){
+Node *IntConstant::CheckNext(int checked){
 	this->type = Type::intType;
+	return NULL;
 }
 
 FloatConstant::FloatConstant(yyltype loc, double val) : Expr(loc) {
     value = val;
+    SetConstant(Constant::OfFloat(val));
 }
-void FloatConstant::PrintChildren(int indentLevel) { 
-    printf("%g", value);
+void FloatConstant::EmitValue(AstSink *w) {
+    w->SetFloat(value);
 }
 
 //Semantic check for float constant
-void FloatConstant::Check(){
+Node *FloatConstant::CheckNext(int checked){
 	this->type = Type::floatType;
+	return NULL;
 }
 
 BoolConstant::BoolConstant(yyltype loc, bool val) : Expr(loc) {
     value = val;
+    SetConstant(Constant::OfBool(val));
 }
-void BoolConstant::PrintChildren(int indentLevel) { 
-    printf("%s", value ? "true" : "false");
+void BoolConstant::EmitValue(AstSink *w) {
+    w->SetBool(value);
 }
 
-void BoolConstant::Check(){
+Node *BoolConstant::CheckNext(int checked){
 	this->type = Type::boolType;
+	return NULL;
 }
 
 //Semantic check for emptyExpr
-void EmptyExpr::Check(){
+Node *EmptyExpr::CheckNext(int checked){
 	this->type = Type::voidType;
+	return NULL;
 }
 
 VarExpr::VarExpr(yyltype loc, Identifier *ident) : Expr(loc) {
@@ -54,39 +153,57 @@ VarExpr::VarExpr(yyltype loc, Identifier *ident) : Expr(loc) {
     this->id = ident;
 }
 
-//Semantic check for VarExpr
-void VarExpr::Check() {
-	Identifier* id = this->GetIdentifier();
+Symbol *VarExpr::Lookup() {
 	Symbol* sym = NULL;
 	for ( int i = symbolTable->GetTables()->size()-1; i >=0; i--){
 		sym = symbolTable->GetTables()->at(i)->find(id->GetName());
 		if ( sym != NULL )
 			break;
 	}
+	return sym;
+}
+
+//Semantic check for VarExpr
+Node *VarExpr::CheckNext(int checked) {
+	Identifier* id = this->GetIdentifier();
+	Symbol* sym = Lookup();
 
 	if ( sym == NULL ){
 		this->type = Type::errorType;
+		SetConstant(Constant());   // in case it is checked again
 		ReportError::IdentifierNotDeclared(id, LookingForVariable);
 	}
 	else{
 		VarDecl* vardecl = dynamic_cast<VarDecl*>(sym->decl);
 		this->type = vardecl->GetType();
+		SetConstant(vardecl->GetConstant());
 	}
+	return NULL;
 }
 
-void VarExpr::PrintChildren(int indentLevel) {
-    id->Print(indentLevel+1);
+// Outside of Check(), a const variable is looked up without reporting
+void VarExpr::Fold() {
+	Symbol* sym = Lookup();
+	VarDecl* vardecl = sym ? dynamic_cast<VarDecl*>(sym->decl) : NULL;
+	SetConstant(vardecl ? vardecl->GetConstant() : Constant());
 }
 
-//Semantic check for relational expr
-void RelationalExpr::Check(){
-	this->type = Type::boolType;
-	left->Check();
+void VarExpr::GetChildren(vector<Child> &children) {
+    children.push_back(Child(id));
+}
 
-	if ( left->type == Type::errorType )
-                right->type = Type::errorType;
-        else
-                right->Check();
+//Semantic check for relational expr
+Node *RelationalExpr::CheckNext(int checked){
+	if ( checked == 0 ){
+		this->type = Type::boolType;
+		return left;
+	}
+	if ( checked == 1 ){
+		if ( left->type == Type::errorType )
+			right->type = Type::errorType;
+		else
+			return right;
+	}
 	
 	if ( left->type != Type::errorType && right->type != Type::errorType ){
 		if ( left->type != right->type ){
@@ -97,18 +214,25 @@ void RelationalExpr::Check(){
 	else {
 		this->type = Type::errorType;
 	}
-	
+	Fold();
+	return NULL;
+}
+
+void RelationalExpr::Fold() {
+	SetConstant(FoldBinary(op, left->GetConstant(), right->GetConstant()));
 }
 
 //Semantic Check for Arithmetic expr
-void ArithmeticExpr::Check(){
+Node *ArithmeticExpr::CheckNext(int checked){
 	if (left != NULL){
-        	left->Check();
-
-		if ( left->type == Type::errorType )
-                	right->type = Type::errorType;
-        	else
-                	right->Check();
+		if ( checked == 0 )
+			return left;
+		if ( checked == 1 ){
+			if ( left->type == Type::errorType )
+				right->type = Type::errorType;
+			else
+				return right;
+		}
 
 	        if ( left->type != Type::errorType && right->type != Type::errorType ){
         	        if ( left->type != right->type ){
@@ -132,7 +256,8 @@ void ArithmeticExpr::Check(){
 	}
 
 	else { //Unary Expr
-		right->Check();
+		if ( checked == 0 )
+			return right;
 		if ( right->type == Type::boolType ){
 			ReportError::IncompatibleOperand(op, right->type);
 			this->type = Type::errorType;
@@ -141,11 +266,31 @@ void ArithmeticExpr::Check(){
 			this->type = right->type;
 		}
 	}
+	Fold();
+	return NULL;
+}
+
+// Unary + and - fold too; ++ and -- never apply to a constant
+void ArithmeticExpr::Fold() {
+	Constant r = right->GetConstant();
+	if (left != NULL) {
+		SetConstant(FoldBinary(op, left->GetConstant(), r));
+		return;
+	}
+	Constant c;
+	if (op->IsOp("+") && (r.kind == Constant::Int || r.kind == Constant::Float))
+		c = r;
+	else if (op->IsOp("-") && r.kind == Constant::Int)
+		c = Constant::OfInt((int)(0u - (unsigned)r.intValue));
+	else if (op->IsOp("-") && r.kind == Constant::Float)
+		c = Constant::OfFloat(-r.floatValue);
+	SetConstant(c);
 }
 
 //Semantic Check for postfix expr
-void PostfixExpr::Check(){
-	left->Check();
+Node *PostfixExpr::CheckNext(int checked){
+	if ( checked == 0 )
+		return left;
 	if ( left->type == Type::boolType ){
 		ReportError::IncompatibleOperand(op, left->type);
 		this->type = Type::errorType;
@@ -153,15 +298,18 @@ void PostfixExpr::Check(){
 	else {
 		this->type = left->type; 
 	}
+	return NULL;
 }
 
 //Semantic Check for AssignExpr
-void AssignExpr::Check(){
-	left->Check();
+Node *AssignExpr::CheckNext(int checked){
+	if ( checked == 0 )
+		return left;
 	if ( left->type == Type::errorType )
 		this->type = right->type = Type::errorType;
+	else if ( checked == 1 )
+		return right;
 	else{
-		right->Check();
 		if ( right->type == Type::errorType )
 			this->type = left->type = Type::errorType;
 		else{
@@ -173,6 +321,7 @@ void AssignExpr::Check(){
 				this->type = left->type;
 		}
 	}
+	return NULL;
 }
 
 Operator::Operator(yyltype loc, const char *tok) : Node(loc) {
@@ -180,8 +329,8 @@ Operator::Operator(yyltype loc, const char *tok) : Node(loc) {
     strncpy(tokenString, tok, sizeof(tokenString));
 }
 
-void Operator::PrintChildren(int indentLevel) {
-    printf("%s",tokenString);
+void Operator::EmitValue(AstSink *w) {
+    w->SetString(tokenString);
 }
 
 bool Operator::IsOp(const char *op) const {
@@ -209,12 +358,19 @@ CompoundExpr::CompoundExpr(Expr *l, Operator *o)
     Assert(l != NULL && o != NULL);
     (left=l)->SetParent(this);
     (op=o)->SetParent(this);
+    right = NULL;
 }
 
-void CompoundExpr::PrintChildren(int indentLevel) {
-   if (left) left->Print(indentLevel+1);
-   op->Print(indentLevel+1);
-   if (right) right->Print(indentLevel+1);
+CompoundExpr::~CompoundExpr() {
+    DeleteChild(left);
+    DeleteChild(op);
+    DeleteChild(right);
+}
+
+void CompoundExpr::GetChildren(vector<Child> &children) {
+   if (left) children.push_back(Child(left));
+   children.push_back(Child(op));
+   if (right) children.push_back(Child(right));
 }
    
 ConditionalExpr::ConditionalExpr(Expr *c, Expr *t, Expr *f)
@@ -225,45 +381,83 @@ ConditionalExpr::ConditionalExpr(Expr *c, Expr *t, Expr *f)
     (falseExpr=f)->SetParent(this);
 }
 
-void ConditionalExpr::PrintChildren(int indentLevel) {
-    cond->Print(indentLevel+1, "(cond) ");
-    trueExpr->Print(indentLevel+1, "(true) ");
-    falseExpr->Print(indentLevel+1, "(false) ");
+ConditionalExpr::~ConditionalExpr() {
+    DeleteChild(cond);
+    DeleteChild(trueExpr);
+    DeleteChild(falseExpr);
+}
+
+// The operands are not checked, so they are folded here on their own;
+// a conditional that folds takes the type of its value
+Node *ConditionalExpr::CheckNext(int checked) {
+    FoldSubtree(cond);
+    FoldSubtree(trueExpr);
+    FoldSubtree(falseExpr);
+    Fold();
+    switch (constKind) {
+      case Constant::Int:   type = Type::intType; break;
+      case Constant::Float: type = Type::floatType; break;
+      case Constant::Bool:  type = Type::boolType; break;
+    }
+    return NULL;
+}
+
+void ConditionalExpr::Fold() {
+    Constant c = cond->GetConstant(), t = trueExpr->GetConstant(), f = falseExpr->GetConstant();
+    if (c.kind == Constant::Bool && t.IsKnown() && t.kind == f.kind)
+        SetConstant(c.boolValue ? t : f);
+    else
+        SetConstant(Constant());
+}
+
+void ConditionalExpr::GetChildren(vector<Child> &children) {
+    children.push_back(Child(cond, "(cond) "));
+    children.push_back(Child(trueExpr, "(true) "));
+    children.push_back(Child(falseExpr, "(false) "));
 }
 ArrayAccess::ArrayAccess(yyltype loc, Expr *b, Expr *s) : LValue(loc) {
     (base=b)->SetParent(this); 
     (subscript=s)->SetParent(this);
 }
 
-void ArrayAccess::PrintChildren(int indentLevel) {
-    base->Print(indentLevel+1);
-    subscript->Print(indentLevel+1, "(subscript) ");
+ArrayAccess::~ArrayAccess() {
+    DeleteChild(base);
+    DeleteChild(subscript);
+}
+
+void ArrayAccess::GetChildren(vector<Child> &children) {
+    children.push_back(Child(base));
+    children.push_back(Child(subscript, "(subscript) "));
 }
 
 //Semantic Check for Array Access
-void ArrayAccess::Check(){
-	base->Check();
+Node *ArrayAccess::CheckNext(int checked){
+	if ( checked == 0 )
+		return base;
+	ArrayType* arrType = dynamic_cast<ArrayType*>(base->type);
+	if ( checked == 2 ){
+		if ( subscript->type != Type::errorType )
+			this->type = arrType->GetElemType();
+		else
+			this->type = Type::errorType;
+		return NULL;
+	}
 	VarExpr* varExpr = dynamic_cast<VarExpr*>(base);
 	if ( varExpr == NULL ){
 		// this must be variable expr. FloatConstant,IntConstant,BoolConstant is unacceptable;
 		this->type = Type::errorType;
 	}
 	else {
-		ArrayType* arrType = dynamic_cast<ArrayType*>(base->type);
 		if ( arrType == NULL ){
 			ReportError::NotAnArray(varExpr->GetIdentifier());
 			this->type = Type::errorType;
 		}
 		else if ( base->type == Type::errorType )
 			this->type = Type::errorType;
-		else{
-			subscript->Check();
-			if ( subscript->type != Type::errorType )
-				this->type = arrType->GetElemType();
-			else
-				this->type = Type::errorType;
-		}
+		else
+			return subscript;
 	}
+	return NULL;
 }
 
      
@@ -275,21 +469,25 @@ FieldAccess::FieldAccess(Expr *b, Identifier *f)
     (field=f)->SetParent(this);
 }
 
+FieldAccess::~FieldAccess() {
+    DeleteChild(base);
+    DeleteChild(field);
+}
 
-void FieldAccess::PrintChildren(int indentLevel) {
-    if (base) base->Print(indentLevel+1);
-    field->Print(indentLevel+1);
+void FieldAccess::GetChildren(vector<Child> &children) {
+    if (base) children.push_back(Child(base));
+    children.push_back(Child(field));
 }
 
 //Semantic Check for FieldAccess expr:
-void FieldAccess::Check(){
-	if ( base != NULL )
-		base->Check();
+Node *FieldAccess::CheckNext(int checked){
+	if ( checked == 0 && base != NULL )
+		return base;
 	
 	if ( base->type != Type::vec2Type && base->type !=Type::vec3Type && base->type != Type::vec4Type ){
 		ReportError::InaccessibleSwizzle(field, base);
 		this->type = Type::errorType;
-		return;
+		return NULL;
 	}
 
 	string swiz = string(field->GetName());
@@ -297,7 +495,7 @@ void FieldAccess::Check(){
 		if ( swiz[i] != 'x' && swiz[i] != 'y' && swiz[i] != 'z' && swiz[i]!= 'w' ){
 			ReportError::InvalidSwizzle(field, base);
 			this->type = Type::errorType;
-			return;
+			return NULL;
 		}
 	}
 	
@@ -306,7 +504,7 @@ void FieldAccess::Check(){
                 	if ( swiz[i] == 'z' ||  swiz[i] == 'w' ){
 				ReportError::SwizzleOutOfBound(field, base);
                         	this->type = Type::errorType;
-                        	return;
+                        	return NULL;
 			}
                 }
         }
@@ -316,7 +514,7 @@ void FieldAccess::Check(){
                 	if ( swiz[i] == 'w' ){
                         	ReportError::SwizzleOutOfBound(field, base);
                         	this->type = Type::errorType;
-                        	return;
+                        	return NULL;
                 	}
 		}
 
@@ -325,7 +523,7 @@ void FieldAccess::Check(){
 	if (swiz.size() > 4) {
 		ReportError::OversizedVector(field, base);
 		this->type = Type::errorType;
-		return;
+		return NULL;
 	}
 	
 
@@ -335,6 +533,7 @@ void FieldAccess::Check(){
 		case 2: this->type = Type::vec2Type; break;
 		default: this->type = Type::floatType; break;
 	}
+	return NULL;
 }
 
 Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(loc)  {
@@ -345,67 +544,182 @@ Call::Call(yyltype loc, Expr *b, Identifier *f, List<Expr*> *a) : Expr(loc)  {
     (actuals=a)->SetParentAll(this);
 }
 
-void Call::PrintChildren(int indentLevel) {
-   if (base) base->Print(indentLevel+1);
-   if (field) field->Print(indentLevel+1);
-   if (actuals) actuals->PrintAll(indentLevel+1, "(actuals) ");
+Call::~Call() {
+    DeleteChild(base);
+    DeleteChild(field);
+    if (actuals) {
+        actuals->DeleteAll();
+        delete actuals;
+    }
+}
+
+void Call::GetChildren(vector<Child> &children) {
+   if (base) children.push_back(Child(base));
+   if (field) children.push_back(Child(field));
+   if (actuals) actuals->AddChildren(children, "(actuals) ");
 }
 
-//Semantic Check for Call expr
-void Call::Check(){
+//Semantic Check for Call expr. The function is looked up again at each
+//step, which finds the same one, since checking an actual declares nothing
+Node *Call::CheckNext(int checked){
 	if ( base != NULL ){
-		base->Check();
+		if ( checked == 0 )
+			return base;
+		checked--; //Count the actuals only
 	}
-	Decl* decl = NULL;
+	Symbol* fnSym = NULL;
 	// Check for function declaration in global scope
 	for ( int i = symbolTable->GetTables()->size() - 1; i >= 0; i-- ){
-		Symbol* fnSym = symbolTable->GetTables()->at(i)->find(field->GetName());
+		fnSym = symbolTable->GetTables()->at(i)->find(field->GetName());
 		if ( fnSym != NULL ){
-			decl = fnSym->decl;
 			break;
 		}
 	}
 	
-		
-	if(decl == NULL) {
-		ReportError::IdentifierNotDeclared(field, LookingForFunction);
-		this->type = Type::errorType;	
+	Node* next = NULL;
+	if(fnSym == NULL) {
+		if ( !CheckBuiltin(checked, &next) ){
+			ReportError::IdentifierNotDeclared(field, LookingForFunction);
+			this->type = Type::errorType;
+		}
+	}
+	else if ( fnSym->overloads == NULL ){
+		ReportError::ReportError::NotAFunction(field);
+		this->type = Type::errorType;
+	}
+	else if ( FnDecl* fndecl = fnSym->overloads->lone(fnSym->overloadCount) ){
+		next = CheckActuals(fndecl, checked);
 	}
 	else{
-		FnDecl* fndecl = dynamic_cast<FnDecl*>(decl);	
-		if ( fndecl == NULL ){
-			ReportError::ReportError::NotAFunction(field);
+		next = CheckOverloaded(fnSym, checked);
+	}
+	return next;
+}
+
+//Check the actuals against the formals of the only function of the name,
+//which must have exactly their types (only overloads convert, see
+//CheckOverloaded). The first actual whose type does not match ends the
+//check
+Node *Call::CheckActuals(FnDecl* fndecl, int checked){
+	if ( checked == 0 ){
+		if(fndecl->GetFormals()->NumElements() > actuals->NumElements()) {
+			ReportError::LessFormals(field, fndecl->GetFormals()->NumElements(), actuals->NumElements());
 			this->type = Type::errorType;
+			return NULL;
 		}
-		else{
-			if(fndecl->GetFormals()->NumElements() > actuals->NumElements()) {
-				ReportError::LessFormals(field, fndecl->GetFormals()->NumElements(), actuals->NumElements());
-				this->type = Type::errorType;
-			}
-			else if(fndecl->GetFormals()->NumElements() < actuals->NumElements()) {
-				ReportError::ExtraFormals(field, fndecl->GetFormals()->NumElements(), actuals->NumElements());
+		else if(fndecl->GetFormals()->NumElements() < actuals->NumElements()) {
+			ReportError::ExtraFormals(field, fndecl->GetFormals()->NumElements(), actuals->NumElements());
+			this->type = Type::errorType;
+			return NULL;
+		}
+		this->type = fndecl->GetType();
+	}
+	else{
+		Expr* actual = actuals->Nth(checked - 1);
+		if ( actual->type != Type::errorType ){
+			Type* giventype = fndecl->GetFormals()->Nth(checked - 1)->GetType();
+			if ( actual->type != giventype ){
+				ReportError::FormalsTypeMismatch(field, checked, giventype, actual->type);
 				this->type = Type::errorType;
+				return NULL;
 			}
-			else{
-				this->type = fndecl->GetType();
-
-				for(int i = 0; i < actuals->NumElements(); i++) {
-					Expr* actual = actuals->Nth(i);
-					actual->Check();
-					
-					if ( actual->type != Type::errorType ){
-						Type* giventype = fndecl->GetFormals()->Nth(i)->GetType();
-						if ( actual->type != giventype ){
-							ReportError::FormalsTypeMismatch(field, i+1, giventype, actual->type);
-							this->type = Type::errorType;
-							break;
-						}
-					}
-					else{
-						this->type = Type::errorType;
-					}
-				}
-			}		
 		}
+		else{
+			this->type = Type::errorType;
+		}
+	}
+	return checked < actuals->NumElements() ? actuals->Nth(checked) : NULL;
+}
+
+/* Function: CheckOverloaded
+ * -------------------------
+ * Checks a call to a name several functions are declared with, which
+ * takes the one whose formals have exactly the types of the actuals, or
+ * else the best one the actuals convert to (see OverloadSet), once all
+ * the actuals are checked.
+ */
+Node *Call::CheckOverloaded(Symbol* fnSym, int checked){
+	if ( checked < actuals->NumElements() ){
+		return actuals->Nth(checked);
+	}
+	vector<Type*> actualTypes;
+	bool actualError = false;
+	for ( int i = 0; i < actuals->NumElements(); i++ ){
+		Expr* actual = actuals->Nth(i);
+		actualTypes.push_back(actual->type);
+		if ( actual->type == Type::errorType ){
+			actualError = true;
+		}
+	}
+	this->type = Type::errorType;
+	if ( actualError ){
+		return NULL;
+	}
+	bool ambiguous;
+	FnDecl* fndecl = fnSym->overloads->resolve(actualTypes, fnSym->overloadCount, &ambiguous);
+	if ( fndecl != NULL ){
+		this->type = fndecl->GetType();
+	}
+	else if ( ambiguous ){
+		ReportError::AmbiguousCall(field, actualTypes);
+	}
+	else{
+		ReportError::NoMatchingOverload(field, actualTypes);
+	}
+	return NULL;
+}
+
+/* Function: CheckBuiltin
+ * ----------------------
+ * Checks a call to a name no declaration in scope has against the
+ * built-in functions (builtins.h), setting *next to the actual to check
+ * next, if any. Returns false, having checked nothing, if there is no
+ * built-in by that name either.
+ */
+bool Call::CheckBuiltin(int checked, Node **next){
+	int fewest, most;
+	if ( !IsBuiltinFunction(field->GetName(), &fewest, &most) ){
+		return false;
+	}
+	*next = NULL;
+	if ( checked == 0 ){
+		this->type = Type::errorType;
+		if ( actuals->NumElements() < fewest ){
+			ReportError::LessFormals(field, fewest, actuals->NumElements());
+			return true;
+		}
+		if ( actuals->NumElements() > most ){
+			ReportError::ExtraFormals(field, most, actuals->NumElements());
+			return true;
+		}
+	}
+	if ( checked < actuals->NumElements() ){
+		*next = actuals->Nth(checked);
+		return true;
+	}
+
+	vector<Type*> actualTypes;
+	bool actualError = false;
+	for ( int i = 0; i < actuals->NumElements(); i++ ){
+		Expr* actual = actuals->Nth(i);
+		actualTypes.push_back(actual->type);
+		if ( actual->type == Type::errorType ){
+			actualError = true;
+		}
+	}
+	if ( actualError ){
+		return true;
+	}
+	bool ambiguous;
+	Type* result = BuiltinResult(field->GetName(), actualTypes, &ambiguous);
+	if ( result == NULL && ambiguous ){
+		ReportError::AmbiguousCall(field, actualTypes);
+	}
+	else if ( result == NULL ){
+		ReportError::NoMatchingOverload(field, actualTypes);
+	}
+	else{
+		this->type = result;
 	}
+	return true;
 }
@@ -7,6 +7,14 @@
  *
  * pp3: You will need to extend the Expr classes to implement
  * semantic analysis for rules pertaining to expressions.
+ *
+ * Constants: an expression made only of constants (literals, const
+ * variables with constant initializers, and the operators over them) is
+ * folded as it is checked, and GetConstant() then returns its value.
+ * Literals carry their value from the start. Fold() works from the
+ * operands' values alone, so it needs no types and never reports errors;
+ * operands of different kinds (a type error) or an integer division by
+ * zero simply leave the expression unfolded.
  */
 
 
@@ -20,17 +28,57 @@
 
 void yyerror(const char *msg);
 
+struct Symbol;
+
+// The value of a constant expression, see Expr::GetConstant()
+struct Constant {
+    enum Kind { None, Int, Float, Bool };
+    Kind kind;
+    union {
+        int intValue;
+        double floatValue;
+        bool boolValue;
+    };
+
+    Constant() : kind(None), intValue(0) {}
+    static Constant OfInt(int v)      { Constant c; c.kind = Int; c.intValue = v; return c; }
+    static Constant OfFloat(double v) { Constant c; c.kind = Float; c.floatValue = v; return c; }
+    static Constant OfBool(bool v)    { Constant c; c.kind = Bool; c.boolValue = v; return c; }
+    bool IsKnown() const              { return kind != None; }
+};
+
 class Expr : public Stmt 
 {
+  protected:
+    // The folded value, kept as two fields so the kind fits in the
+    // padding at the end of Node
+    unsigned char constKind;        // a Constant::Kind
+    union {
+        int intValue;
+        double floatValue;
+        bool boolValue;
+    } constValue;
+
+    void SetConstant(const Constant &c);
+
   public:
-    Expr(yyltype loc) : Stmt(loc) {}
-    Expr() : Stmt() {}
-    Type* type;
+    Expr(yyltype loc) : Stmt(loc), constKind(Constant::None), type(NULL) {}
+    Expr() : Stmt(), constKind(Constant::None), type(NULL) {}
+    Type* type;    // set by the check, NULL until then
 
     friend std::ostream& operator<< (std::ostream& stream, Expr * expr) {
         return stream << expr->GetPrintNameForNode();
     }
-    virtual void Check() {}
+
+    // The value this expression was folded to (kind None if it is not
+    // constant); Fold() recomputes it from the operands' values
+    Constant GetConstant() const;
+    virtual void Fold() {}
+    void EmitValue(AstSink *w);
+
+    // Folds every expression in the subtree, operands first, for
+    // subtrees that Check() does not visit
+    static void FoldSubtree(Node *root);
 };
 
 class ExprError : public Expr
@@ -47,7 +95,7 @@ class EmptyExpr : public Expr
 {
   public:
     const char *GetPrintNameForNode() { return "Empty"; }
-    virtual void Check();
+    Node *CheckNext(int checked);
 };
 
 class IntConstant : public Expr 
@@ -58,8 +106,8 @@ class IntConstant : public Expr
   public:
     IntConstant(yyltype loc, int val);
     const char *GetPrintNameForNode() { return "IntConstant"; }
-    void PrintChildren(int indentLevel);
-    virtual void Check();
+    void EmitValue(AstSink *w);
+    Node *CheckNext(int checked);
     
 };
 
@@ -71,8 +119,8 @@ class FloatConstant: public Expr
   public:
     FloatConstant(yyltype loc, double val);
     const char *GetPrintNameForNode() { return "FloatConstant"; }
-    void PrintChildren(int indentLevel);
-    virtual void Check();
+    void EmitValue(AstSink *w);
+    Node *CheckNext(int checked);
 };
 
 class BoolConstant : public Expr 
@@ -83,8 +131,8 @@ class BoolConstant : public Expr
   public:
     BoolConstant(yyltype loc, bool val);
     const char *GetPrintNameForNode() { return "BoolConstant"; }
-    void PrintChildren(int indentLevel);
-    virtual void Check();
+    void EmitValue(AstSink *w);
+    Node *CheckNext(int checked);
 };
 
 class VarExpr : public Expr
@@ -94,10 +142,13 @@ class VarExpr : public Expr
 
   public:
     VarExpr(yyltype loc, Identifier *id);
+    ~VarExpr() { delete id; }
     const char *GetPrintNameForNode() { return "VarExpr"; }
-    void PrintChildren(int indentLevel);
+    void GetChildren(vector<Child> &children);
     Identifier *GetIdentifier() {return id;}
-    virtual void Check();
+    Node *CheckNext(int checked);     // takes the value of a const variable
+    void Fold();
+    Symbol *Lookup();         // in the current scopes, NULL if undeclared
 };
 
 class Operator : public Node 
@@ -108,7 +159,7 @@ class Operator : public Node
   public:
     Operator(yyltype loc, const char *tok);
     const char *GetPrintNameForNode() { return "Operator"; }
-    void PrintChildren(int indentLevel);
+    void EmitValue(AstSink *w);
     friend ostream& operator<<(ostream& out, Operator *o) { return out << o->tokenString; }
     bool IsOp(const char *op) const;
     char* GetOpTokStr() { return tokenString; };
@@ -124,8 +175,8 @@ class CompoundExpr : public Expr
     CompoundExpr(Expr *lhs, Operator *op, Expr *rhs); // for binary
     CompoundExpr(Operator *op, Expr *rhs);             // for unary
     CompoundExpr(Expr *lhs, Operator *op);             // for unary
-    void PrintChildren(int indentLevel);
-    virtual void Check() {};
+    ~CompoundExpr();
+    void GetChildren(vector<Child> &children);
 };
 
 class ArithmeticExpr : public CompoundExpr 
@@ -134,7 +185,8 @@ class ArithmeticExpr : public CompoundExpr
     ArithmeticExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     ArithmeticExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "ArithmeticExpr"; }
-    void Check();
+    Node *CheckNext(int checked);
+    void Fold();
 };
 
 class RelationalExpr : public CompoundExpr 
@@ -142,7 +194,8 @@ class RelationalExpr : public CompoundExpr
   public:
     RelationalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "RelationalExpr"; }
-    void Check();
+    Node *CheckNext(int checked);
+    void Fold();
 };
 
 class EqualityExpr : public CompoundExpr 
@@ -158,7 +211,6 @@ class LogicalExpr : public CompoundExpr
     LogicalExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     LogicalExpr(Operator *op, Expr *rhs) : CompoundExpr(op,rhs) {}
     const char *GetPrintNameForNode() { return "LogicalExpr"; }
-    void Check() {};
 };
 
 class AssignExpr : public CompoundExpr 
@@ -166,7 +218,7 @@ class AssignExpr : public CompoundExpr
   public:
     AssignExpr(Expr *lhs, Operator *op, Expr *rhs) : CompoundExpr(lhs,op,rhs) {}
     const char *GetPrintNameForNode() { return "AssignExpr"; }
-    void Check();
+    Node *CheckNext(int checked);
 };
 
 class PostfixExpr : public CompoundExpr
@@ -174,7 +226,7 @@ class PostfixExpr : public CompoundExpr
   public:
     PostfixExpr(Expr *lhs, Operator *op) : CompoundExpr(lhs,op) {}
     const char *GetPrintNameForNode() { return "PostfixExpr"; }
-    void Check();
+    Node *CheckNext(int checked);
 };
 
 class ConditionalExpr : public Expr
@@ -183,9 +235,11 @@ class ConditionalExpr : public Expr
     Expr *cond, *trueExpr, *falseExpr;
   public:
     ConditionalExpr(Expr *c, Expr *t, Expr *f);
-    void PrintChildren(int indentLevel);
+    ~ConditionalExpr();
+    void GetChildren(vector<Child> &children);
     const char *GetPrintNameForNode() { return "ConditionalExpr"; }
-    void Check() { /*does not report error in this case*/ };
+    Node *CheckNext(int checked);     // does not report errors, only folds
+    void Fold();
 };
 
 class LValue : public Expr 
@@ -201,9 +255,10 @@ class ArrayAccess : public LValue
     
   public:
     ArrayAccess(yyltype loc, Expr *base, Expr *subscript);
+    ~ArrayAccess();
     const char *GetPrintNameForNode() { return "ArrayAccess"; }
-    void PrintChildren(int indentLevel);
-    void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
 };
 
 /* Note that field access is used both for qualified names
@@ -219,9 +274,10 @@ class FieldAccess : public LValue
     
   public:
     FieldAccess(Expr *base, Identifier *field); //ok to pass NULL base
+    ~FieldAccess();
     const char *GetPrintNameForNode() { return "FieldAccess"; }
-    void PrintChildren(int indentLevel);
-    void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
 };
 
 /* Like field access, call is used both for qualified base.field()
@@ -234,13 +290,19 @@ class Call : public Expr
     Expr *base;	// will be NULL if no explicit base
     Identifier *field;
     List<Expr*> *actuals;
+
+    // Each takes the call's check a step further, as CheckNext() does
+    Node *CheckActuals(FnDecl *fndecl, int checked);
+    Node *CheckOverloaded(Symbol *fnSym, int checked);
+    bool CheckBuiltin(int checked, Node **next);
     
   public:
     Call() : Expr(), base(NULL), field(NULL), actuals(NULL) {}
     Call(yyltype loc, Expr *base, Identifier *field, List<Expr*> *args);
+    ~Call();
     const char *GetPrintNameForNode() { return "Call"; }
-    void PrintChildren(int indentLevel);
-    void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
 };
 
 class ActualsError : public Call
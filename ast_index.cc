@@ -0,0 +1,125 @@
+/* File: ast_index.cc
+ * ------------------
+ * Building and querying an AstIndex (see ast_index.h).
+ */
+
+#include <algorithm>
+#include "ast_index.h"
+#include "ast.h"
+#include "ast_expr.h"
+
+// A position as one number that orders positions as the text does
+static uint64_t Key(int line, int column)
+{
+    return (uint64_t)(uint32_t)line << 32 | (uint32_t)column;
+}
+
+void AstIndex::SpanSet::Add(uint64_t start, uint64_t end, Node *node) {
+    starts.push_back(start);
+    ends.push_back(end);
+    nodes.push_back(node);
+}
+
+/* Function: SpanSet::Finish
+ * -------------------------
+ * Sorts the spans added, keeping the order they were added in (preorder)
+ * among equal ones so that a child with the span of its parent comes
+ * after it, and builds the tree of furthest ends over them.
+ */
+void AstIndex::SpanSet::Finish() {
+    size_t n = nodes.size();
+    vector<uint32_t> order(n);
+    for (size_t i = 0; i < n; i++)
+        order[i] = i;
+    stable_sort(order.begin(), order.end(), [this](uint32_t a, uint32_t b) {
+        return starts[a] < starts[b] || (starts[a] == starts[b] && ends[a] > ends[b]);
+    });
+
+    vector<uint64_t> s(n), e(n);
+    vector<Node *> v(n);
+    for (size_t i = 0; i < n; i++) {
+        s[i] = starts[order[i]];
+        e[i] = ends[order[i]];
+        v[i] = nodes[order[i]];
+    }
+    starts.swap(s);
+    ends.swap(e);
+    nodes.swap(v);
+
+    for (leaves = 1; leaves < n; leaves *= 2)
+        ;
+    maxEnd.assign(2 * leaves, 0);
+    for (size_t i = 0; i < n; i++)
+        maxEnd[leaves + i] = ends[i];
+    for (size_t i = leaves - 1; i > 0; i--)
+        maxEnd[i] = max(maxEnd[2 * i], maxEnd[2 * i + 1]);
+}
+
+/* Function: SpanSet::Last
+ * -----------------------
+ * Returns the last span at or before k that ends at or after p, among
+ * the spans lo up to hi under tree node i, or Size() if there is none.
+ * Only one node on each level can straddle k, and a node lying wholly
+ * before k is entered only if it has such a span, so this visits
+ * O(log n) nodes.
+ */
+size_t AstIndex::SpanSet::Last(size_t i, size_t lo, size_t hi, size_t k, uint64_t p) const {
+    if (lo > k || maxEnd[i] < p)
+        return nodes.size();
+    if (hi - lo == 1)
+        return lo;
+    size_t mid = (lo + hi) / 2;
+    size_t found = Last(2 * i + 1, mid, hi, k, p);
+    return found < nodes.size() ? found : Last(2 * i, lo, mid, k, p);
+}
+
+// The innermost span holding p: the last one starting by p that has not
+// ended before it
+Node *AstIndex::SpanSet::At(uint64_t p) const {
+    size_t k = upper_bound(starts.begin(), starts.end(), p) - starts.begin();
+    if (k == 0)
+        return NULL;
+    size_t found = Last(1, 0, leaves, k - 1, p);
+    return found < nodes.size() ? nodes[found] : NULL;
+}
+
+AstIndex::AstIndex(Node *root) {
+    Add(root);
+    all.Finish();
+    typed.Finish();
+}
+
+AstIndex::AstIndex(const vector<Node *> &roots) {
+    for (Node *root : roots)
+        Add(root);
+    all.Finish();
+    typed.Finish();
+}
+
+void AstIndex::Add(Node *root) {
+    for (TreeWalker walk(root); walk.Next(); ) {
+        Node *node = walk.GetNode();
+        yyltype *loc = node->GetLocation();
+        if (loc == NULL)
+            continue;
+        uint64_t start = Key(loc->first_line, loc->first_column);
+        uint64_t end = Key(loc->last_line, loc->last_column);
+        all.Add(start, end, node);
+        Expr *expr = dynamic_cast<Expr*>(node);
+        if (expr && expr->type)
+            typed.Add(start, end, node);
+    }
+}
+
+Node *AstIndex::NodeAt(int line, int column) const {
+    return all.At(Key(line, column));
+}
+
+Expr *AstIndex::ExprAt(int line, int column) const {
+    return static_cast<Expr*>(typed.At(Key(line, column)));
+}
+
+Type *AstIndex::TypeAt(int line, int column) const {
+    Expr *expr = ExprAt(line, column);
+    return expr ? expr->type : NULL;
+}
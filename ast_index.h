@@ -0,0 +1,73 @@
+/* File: ast_index.h
+ * -----------------
+ * AstIndex answers "what is at line:column" for a tree: the innermost
+ * node whose span holds the position, and the innermost expression the
+ * checker has typed there along with its type. This is what an editor
+ * asks on hover, and glc --query-type=<file>:<line>:<col> prints it.
+ *
+ * The index is built once from a parsed and checked tree, in one walk,
+ * as two arrays of spans (one of all the located nodes, one of just the
+ * typed expressions) sorted by where they start. Each array has a tree
+ * over it holding the furthest end of each range of spans, so a query is
+ * a binary search for the last span starting at or before the position
+ * and then one descent for the last of those that ends at or after it,
+ * both O(log n) however large the tree.
+ *
+ *   AstIndex index(program);
+ *   if (Type *t = index.TypeAt(12, 7))
+ *       cout << t << endl;
+ *
+ * Lines and columns are numbered from 1, as in yyltype, and a span holds
+ * its last column. The index keeps pointers into the tree, so it must
+ * not outlive it, and the tree's locations must not change under it.
+ */
+
+#ifndef _H_ast_index
+#define _H_ast_index
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+class Node;
+class Expr;
+class Type;
+
+class AstIndex {
+    // Spans sorted by start, and among those starting together, widest
+    // first, so that a node comes before the nodes nested in it
+    class SpanSet {
+        vector<uint64_t> starts, ends;   // see Key() in ast_index.cc
+        vector<Node *> nodes;
+        vector<uint64_t> maxEnd;         // the tree, maxEnd[1] at its root
+        size_t leaves;
+
+        size_t Last(size_t i, size_t lo, size_t hi, size_t k, uint64_t p) const;
+
+      public:
+        void Add(uint64_t start, uint64_t end, Node *node);
+        void Finish();
+        Node *At(uint64_t p) const;
+        size_t Size() const  { return nodes.size(); }
+    };
+
+    SpanSet all, typed;
+
+    void Add(Node *root);
+
+  public:
+    AstIndex(Node *root);
+    AstIndex(const vector<Node *> &roots);    // of one tree in pieces
+
+    // The innermost node whose span holds the position, or NULL
+    Node *NodeAt(int line, int column) const;
+    // The innermost expression with a type there, or NULL
+    Expr *ExprAt(int line, int column) const;
+    // The type ExprAt() has, or NULL
+    Type *TypeAt(int line, int column) const;
+
+    int NumNodes() const  { return all.Size(); }
+};
+
+#endif
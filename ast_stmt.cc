@@ -6,17 +6,24 @@
 #include "ast_type.h"
 #include "ast_decl.h"
 #include "ast_expr.h"
+#include "bast.h"
 #include "errors.h"
 #include "symtable.h"
+#include "utility.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+const vector<Decl*> *Program::prelude = NULL;
 
 Program::Program(List<Decl*> *d) {
     Assert(d != NULL);
     (decls=d)->SetParentAll(this);
 }
 
-void Program::PrintChildren(int indentLevel) {
-    decls->PrintAll(indentLevel+1);
-    printf("\n");
+void Program::GetChildren(vector<Child> &children) {
+    decls->AddChildren(children);
 }
 
 void Program::Check() {
@@ -28,46 +35,203 @@ void Program::Check() {
      *      and polymorphism in the node classes.
      */
 
-    // sample test - not the actual working code
-    // replace it with your own implementation
-    
-    symbolTable->push(); //Add a global scope table 
+    CheckInPhases(NumCheckThreads());
+}
 
-    if ( decls->NumElements() > 0 ) {
-      for ( int i = 0; i < decls->NumElements(); ++i ) {
-        Decl *d = decls->Nth(i);
-	
-	FnDecl *fnDecl = dynamic_cast<FnDecl*>(d);
+int Program::NumCheckThreads() {
+    int numThreads = 1;
+    if ( const char *threads = GetOption("check-threads") )
+        numThreads = *threads ? atoi(threads) : thread::hardware_concurrency();
+    return numThreads > 1 ? numThreads : 1;
+}
 
-	if ( fnDecl != NULL ){
-		symbolTable->setCurrentFn(fnDecl);
-	}
-	
-        d->Check();
-      }
+/* Function: CheckInPhases
+ * -----------------------
+ * Phase one checks the global declarations alone, entering functions
+ * without their bodies, and records the global scope as it stood after
+ * each declaration; the recorded scope is then frozen into a read-only
+ * table. Phase two checks the function bodies on numThreads threads;
+ * each body only reads the frozen global scope (as of its own position)
+ * and its own locals, and every thread has its own symbol table and
+ * loop/switch stack.
+ *
+ * Diagnostics are collected per top-level declaration and printed in
+ * declaration order once all threads are done, which reproduces the
+ * order of a single pass exactly.
+ */
+void Program::CheckInPhases(int numThreads) {
+    int n = decls->NumElements();
+    vector< vector<Diagnostic> > found(n), bodyFound(n);
+    GlobalScope *global = CheckGlobals(found);
+    CheckBodies(global, vector<bool>(n, true), numThreads, bodyFound);
+
+    for ( int i = 0; i < n; ++i ) {
+        for ( size_t j = 0; j < found[i].size(); j++ )
+            ReportError::Replay(found[i][j]);
+        for ( size_t j = 0; j < bodyFound[i].size(); j++ )
+            ReportError::Replay(bodyFound[i][j]);
     }
+}
 
+GlobalScope *Program::CheckGlobals(vector< vector<Diagnostic> > &found) {
+    int n = decls->NumElements();
+    GlobalScope *global = new GlobalScope;
+    ScopedTable *table = new ScopedTable;
+
+    symbolTable->push(table); //Add a global scope table
+    EnterPrelude(global);
+    for ( int i = 0; i < n; ++i ) {
+        Decl *d = decls->Nth(i);
+        FnDecl *fnDecl = dynamic_cast<FnDecl*>(d);
+        ReportError::CollectOnThisThread(&found[i]);
+        if ( fnDecl != NULL ) fnDecl->CheckDeclaration();
+        else d->Check();
+        global->record(i, *symbolTable->find(d->GetIdentifier()->GetName()));
+    }
+    ReportError::CollectOnThisThread(NULL);
     symbolTable->pop(); //Pop the global scope table
+    global->freeze(table);
+    return global;
+}
+
+bool Program::CheckBodies(GlobalScope *global, const vector<bool> &which, int numThreads,
+                          vector< vector<Diagnostic> > &bodyFound,
+                          vector< vector<const char *> > *lookups,
+                          const atomic<bool> *cancel) {
+    int n = decls->NumElements();
+    atomic<int> next(0);
+    auto checkBodies = [&]() {
+        for ( int i = next++; i < n; i = next++ ) {
+            if ( cancel && *cancel )
+                break;
+            FnDecl *fnDecl = dynamic_cast<FnDecl*>(decls->Nth(i));
+            if ( !which[i] || fnDecl == NULL || fnDecl->GetBody() == NULL )
+                continue;
+            ReportError::CollectOnThisThread(&bodyFound[i]);
+            ScopedTable::RecordGlobalLookups(lookups ? &(*lookups)[i] : NULL);
+            symbolTable->push(new ScopedTable(global, i));
+            symbolTable->setCurrentFn(fnDecl);
+            fnDecl->CheckBody();
+            symbolTable->pop();
+        }
+        ReportError::CollectOnThisThread(NULL);
+        ScopedTable::RecordGlobalLookups(NULL);
+    };
+    vector<thread> workers;
+    for ( int t = 1; t < numThreads; t++ )
+        workers.push_back(thread(checkBodies));
+    checkBodies();
+    for ( size_t t = 0; t < workers.size(); t++ )
+        workers[t].join();
+    return !(cancel && *cancel);
+}
+
+/* Function: EnterPrelude
+ * -----------------------
+ * Enters the prelude's declarations in the global scope table, and in
+ * the recorded global scope, if any, at positions before the first
+ * declaration's (in their own order), so that they are visible at every
+ * position.
+ */
+void Program::EnterPrelude(GlobalScope *global) {
+    if ( prelude == NULL )
+        return;
+    for ( size_t i = 0; i < prelude->size(); i++ ) {
+        Decl *d = (*prelude)[i];
+        if ( FnDecl *fnDecl = dynamic_cast<FnDecl*>(d) ) {
+            fnDecl->CheckDeclaration(); // joins the overloads before it
+        } else {
+            Symbol sym(d->GetIdentifier()->GetName(), d, E_VarDecl);
+            symbolTable->insert(sym);
+        }
+        if ( global != NULL )
+            global->record((int)i - (int)prelude->size(),
+                           *symbolTable->find(d->GetIdentifier()->GetName()));
+    }
+}
+
+void Program::CheckDecl(Decl *d) {
+    FnDecl *fnDecl = dynamic_cast<FnDecl*>(d);
+    if ( fnDecl != NULL ){
+        symbolTable->setCurrentFn(fnDecl);
+    }
+    d->Check();
 }
 
-StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s) {
+static bool streamStarted;
+static int checkErrors;    // errors reported by the streamed checks
+
+/* Function: CheckStreamed
+ * -----------------------
+ * Check() only runs on a program that parsed without errors. Streaming,
+ * we cannot know that in advance, so we check until the first error
+ * that did not come from a check (a syntax or scanner error) and stop
+ * there; semantic errors already printed for earlier declarations stay.
+ */
+void Program::CheckStreamed(Decl *d, AstSink *sink) {
+    if ( ReportError::NumErrors() != checkErrors )
+        return;
+    if ( !streamStarted ) {
+        symbolTable->push(); //Add a global scope table
+        EnterPrelude(NULL);
+        streamStarted = true;
+    }
+    CheckDecl(d);
+    checkErrors = ReportError::NumErrors();
+    if ( sink != NULL )
+        d->Emit(sink);
+
+    FnDecl *fnDecl = dynamic_cast<FnDecl*>(d);
+    if ( fnDecl != NULL )
+        fnDecl->ReleaseBody();
+}
+
+void Program::FinishStreamedCheck() {
+    if ( streamStarted ) {
+        symbolTable->pop(); //Pop the global scope table
+        streamStarted = false;
+    }
+    checkErrors = 0;
+}
+
+StmtBlock::StmtBlock(List<VarDecl*> *d, List<Stmt*> *s, yyltype b)
+  : braces(b), scope(NULL) {
     Assert(d != NULL && s != NULL);
     (decls=d)->SetParentAll(this);
     (stmts=s)->SetParentAll(this);
 }
 
-void StmtBlock::PrintChildren(int indentLevel) {
-    decls->PrintAll(indentLevel+1);
-    stmts->PrintAll(indentLevel+1);
+StmtBlock::~StmtBlock() {
+    decls->DeleteAll();
+    stmts->DeleteAll();
+    delete decls;
+    delete stmts;
+}
+
+void StmtBlock::GetChildren(vector<Child> &children) {
+    decls->AddChildren(children);
+    stmts->AddChildren(children);
 }
 
-void StmtBlock::Check(){
-	for ( int i = 0; i < decls->NumElements(); i++ ){
-		decls->Nth(i)->Check();
+//Semantic Check for StmtBlock: the declarations, then the statements,
+//a nested block in a scope of its own
+Node *StmtBlock::CheckNext(int checked){
+	int numDecls = decls->NumElements();
+	if ( checked == 0 ){
+		scope = symbolTable->getSavedScope();
+	}
+	else if ( checked > numDecls ){
+		StmtBlock* stmtBlk = dynamic_cast<StmtBlock*>(stmts->Nth(checked - 1 - numDecls));
+		if ( stmtBlk != NULL){
+			symbolTable->pop();
+		}
 	}
 
-	for ( int i = 0; i < stmts->NumElements(); i++ ){
-		Stmt* stmt = stmts->Nth(i);
+	if ( checked < numDecls ){
+		return decls->Nth(checked);
+	}
+	if ( checked - numDecls < stmts->NumElements() ){
+		Stmt* stmt = stmts->Nth(checked - numDecls);
 		StmtBlock* stmtBlk = dynamic_cast<StmtBlock*>(stmt);
 	 	ReturnStmt* returnStmt = dynamic_cast<ReturnStmt*>(stmt);
 		if ( returnStmt != NULL ){
@@ -77,13 +241,9 @@ void StmtBlock::Check(){
 		if ( stmtBlk != NULL ){
 			symbolTable->push();
 		}
-
-		stmt->Check();
-
-		if ( stmtBlk != NULL){
-			symbolTable->pop();
-		}
+		return stmt;
 	}
+	return NULL;
 }
 
 DeclStmt::DeclStmt(Decl *d) {
@@ -92,12 +252,16 @@ DeclStmt::DeclStmt(Decl *d) {
 }
 
 //Semantic Check for DeclStmt
-void DeclStmt::Check(){
-	decl->Check();
+Node *DeclStmt::CheckNext(int checked){
+	return checked == 0 ? decl : NULL;
 }
 
-void DeclStmt::PrintChildren(int indentLevel) {
-    decl->Print(indentLevel+1);
+DeclStmt::~DeclStmt() {
+    DeleteChild(decl);
+}
+
+void DeclStmt::GetChildren(vector<Child> &children) {
+    children.push_back(Child(decl));
 }
 
 ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) { 
@@ -106,6 +270,11 @@ ConditionalStmt::ConditionalStmt(Expr *t, Stmt *b) {
     (body=b)->SetParent(this);
 }
 
+ConditionalStmt::~ConditionalStmt() {
+    DeleteChild(test);
+    DeleteChild(body);
+}
+
 ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b): LoopStmt(t, b) { 
     Assert(i != NULL && t != NULL && b != NULL);
     (init=i)->SetParent(this);
@@ -114,56 +283,72 @@ ForStmt::ForStmt(Expr *i, Expr *t, Expr *s, Stmt *b): LoopStmt(t, b) {
       (step=s)->SetParent(this);
 }
 
-void ForStmt::PrintChildren(int indentLevel) {
-    init->Print(indentLevel+1, "(init) ");
-    test->Print(indentLevel+1, "(test) ");
+ForStmt::~ForStmt() {
+    DeleteChild(init);
+    DeleteChild(step);
+}
+
+void ForStmt::GetChildren(vector<Child> &children) {
+    children.push_back(Child(init, "(init) "));
+    children.push_back(Child(test, "(test) "));
     if ( step )
-      step->Print(indentLevel+1, "(step) ");
-    body->Print(indentLevel+1, "(body) ");
+      children.push_back(Child(step, "(step) "));
+    children.push_back(Child(body, "(body) "));
 }
 
 //Semantic Check for For Stmt
-void ForStmt::Check(){
-	symbolTable->push();
-	loop_switchStack->push(this);
-	
-	init->Check();
-	test->Check();
-
-	if(!(test->type == Type::boolType)) {
-		ReportError::TestNotBoolean(test);
-		test->type = Type::errorType;
+Node *ForStmt::CheckNext(int checked){
+	if ( checked == 0 ){
+		symbolTable->push();
+		loop_switchStack->push(this);
+		return init;
 	}
+	if ( checked == 1 )
+		return test;
+
+	if ( checked == 2 ){
+		if(!(test->type == Type::boolType)) {
+			ReportError::TestNotBoolean(test);
+			test->type = Type::errorType;
+		}
 
-	if(step != NULL) {
-		step->Check();
+		if(step != NULL) {
+			return step;
+		}
 	}
 
-	body->Check();
+	if ( checked == (step != NULL ? 3 : 2) )
+		return body;
 
 	loop_switchStack->pop();
 	symbolTable->pop();
+	return NULL;
 }
 
-void WhileStmt::PrintChildren(int indentLevel) {
-    test->Print(indentLevel+1, "(test) ");
-    body->Print(indentLevel+1, "(body) ");
+void WhileStmt::GetChildren(vector<Child> &children) {
+    children.push_back(Child(test, "(test) "));
+    children.push_back(Child(body, "(body) "));
 }
 
 //Semantic Check for While Stmt
-void WhileStmt::Check(){
-	symbolTable->push();
-	loop_switchStack->push(this);
-	test->Check();
+Node *WhileStmt::CheckNext(int checked){
+	if ( checked == 0 ){
+		symbolTable->push();
+		loop_switchStack->push(this);
+		return test;
+	}
 	
-	if ( !(test->type == Type::boolType) ){
-		ReportError::TestNotBoolean(test);
-		test->type = Type::errorType;
+	if ( checked == 1 ){
+		if ( !(test->type == Type::boolType) ){
+			ReportError::TestNotBoolean(test);
+			test->type = Type::errorType;
+		}
+		return body;
 	}
 
-	body->Check();
 	loop_switchStack->pop();
 	symbolTable->pop();
+	return NULL;
 }
 
 IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(t, tb) { 
@@ -172,28 +357,37 @@ IfStmt::IfStmt(Expr *t, Stmt *tb, Stmt *eb): ConditionalStmt(t, tb) {
     if (elseBody) elseBody->SetParent(this);
 }
 
-void IfStmt::PrintChildren(int indentLevel) {
-    if (test) test->Print(indentLevel+1, "(test) ");
-    if (body) body->Print(indentLevel+1, "(then) ");
-    if (elseBody) elseBody->Print(indentLevel+1, "(else) ");
+void IfStmt::GetChildren(vector<Child> &children) {
+    if (test) children.push_back(Child(test, "(test) "));
+    if (body) children.push_back(Child(body, "(then) "));
+    if (elseBody) children.push_back(Child(elseBody, "(else) "));
 }
 
 //Semantic Check for IfStmt
-void IfStmt::Check(){
-	test->Check();
-	if ( test->type != Type::boolType ){
-		ReportError::TestNotBoolean(test);
-		test->type = Type::errorType;
-	}
+Node *IfStmt::CheckNext(int checked){
+	switch ( checked ){
+	  case 0:
+		return test;
+
+	  case 1:
+		if ( test->type != Type::boolType ){
+			ReportError::TestNotBoolean(test);
+			test->type = Type::errorType;
+		}
+		symbolTable->push(); //Push new scope for If body expr
+		return body;
 
-	symbolTable->push(); //Push new scope for If body expr
-	body->Check();
-	symbolTable->pop(); //Pop If body expr scope
+	  case 2:
+		symbolTable->pop(); //Pop If body expr scope
+		if (elseBody != NULL ){
+			symbolTable->push();
+			return elseBody;
+		}
+		return NULL;
 
-	if (elseBody != NULL ){
-		symbolTable->push();
-		elseBody->Check();
+	  default:
 		symbolTable->pop();
+		return NULL;
 	}
 }
 ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) { 
@@ -201,16 +395,21 @@ ReturnStmt::ReturnStmt(yyltype loc, Expr *e) : Stmt(loc) {
     if (e != NULL) expr->SetParent(this);
 }
 
-void ReturnStmt::PrintChildren(int indentLevel) {
-    if ( expr ) 
-      expr->Print(indentLevel+1);
+ReturnStmt::~ReturnStmt() {
+    DeleteChild(expr);
+}
+
+void ReturnStmt::GetChildren(vector<Child> &children) {
+    if ( expr )
+      children.push_back(Child(expr));
 }
 
 //Semantic check for Return Stmt
-void ReturnStmt::Check(){
+Node *ReturnStmt::CheckNext(int checked){
 	FnDecl* currFn = symbolTable->getCurrentFn();
 	if ( expr != NULL ){
-		expr->Check();
+		if ( checked == 0 )
+			return expr;
 		if ( expr->type != Type::errorType ){
 			if ( currFn->GetType() != expr->type ){
 				ReportError::ReturnMismatch(this, expr->type, currFn->GetType());
@@ -221,6 +420,7 @@ void ReturnStmt::Check(){
 			ReportError::ReturnMismatch(this, expr->type, currFn->GetType());
 		}
 	}
+	return NULL;
 }
 
 SwitchLabel::SwitchLabel(Expr *l, Stmt *s) {
@@ -235,12 +435,17 @@ SwitchLabel::SwitchLabel(Stmt *s) {
     (stmt=s)->SetParent(this);
 }
 
-void SwitchLabel::PrintChildren(int indentLevel) {
-    if (label) label->Print(indentLevel+1);
-    if (stmt)  stmt->Print(indentLevel+1);
+SwitchLabel::~SwitchLabel() {
+    DeleteChild(label);
+    DeleteChild(stmt);
 }
 
-SwitchStmt::SwitchStmt(Expr *e, List<Stmt *> *c, Default *d) {
+void SwitchLabel::GetChildren(vector<Child> &children) {
+    if (label) children.push_back(Child(label));
+    if (stmt)  children.push_back(Child(stmt));
+}
+
+SwitchStmt::SwitchStmt(Expr *e, List<Stmt *> *c, Default *d) : nextCase(0) {
     Assert(e != NULL && c != NULL && c->NumElements() != 0 );
     (expr=e)->SetParent(this);
     (cases=c)->SetParentAll(this);
@@ -248,63 +453,102 @@ SwitchStmt::SwitchStmt(Expr *e, List<Stmt *> *c, Default *d) {
     if (def) def->SetParent(this);
 }
 
-void SwitchStmt::PrintChildren(int indentLevel) {
-    if (expr) expr->Print(indentLevel+1);
-    if (cases) cases->PrintAll(indentLevel+1);
-    if (def) def->Print(indentLevel+1);
+SwitchStmt::~SwitchStmt() {
+    DeleteChild(expr);
+    if (cases) {
+        cases->DeleteAll();
+        delete cases;
+    }
+    DeleteChild(def);
+}
+
+void SwitchStmt::GetChildren(vector<Child> &children) {
+    if (expr) children.push_back(Child(expr));
+    if (cases) cases->AddChildren(children);
+    if (def) children.push_back(Child(def));
 }
 
 //Semactic check for switch stmt
-void SwitchStmt::Check(){
-	symbolTable->push(); //Push scope
-	loop_switchStack->push(this); 
-	expr->Check();
-	for ( int i = 0; i < cases->NumElements(); i++ ){
-		AssignExpr* assignExpr = dynamic_cast<AssignExpr*>(cases->Nth(i));
-		if ( assignExpr != NULL )
-			continue; //Skip semantic checking of assignexpr inside switch statement
-		cases->Nth(i)->Check();
+Node *SwitchStmt::CheckNext(int checked){
+	if ( checked == 0 ){
+		symbolTable->push(); //Push scope
+		loop_switchStack->push(this); 
+		nextCase = 0;
+		return expr;
+	}
+	if ( checked > 1 ){
+		// Case labels are folded by their check. Labels in a row
+		// (case 1: case 2: ...) nest, each the statement of the one before
+		SwitchLabel* l = dynamic_cast<SwitchLabel*>(cases->Nth(nextCase - 1));
+		for ( ; l != NULL; l = dynamic_cast<SwitchLabel*>(l->GetStmt()) ){
+			Case* c = dynamic_cast<Case*>(l);
+			if ( c == NULL || c->GetLabel()->type == Type::errorType )
+				continue;
+			Constant value = c->GetLabel()->GetConstant();
+			if ( value.kind != Constant::Int )
+				ReportError::CaseNotConstant(c->GetLabel());
+			else if ( find(labels.begin(), labels.end(), value.intValue) != labels.end() )
+				ReportError::DuplicateCase(c->GetLabel(), value.intValue);
+			else
+				labels.push_back(value.intValue);
+		}
+	}
+
+	for ( ; nextCase < cases->NumElements(); nextCase++ ){
+		AssignExpr* assignExpr = dynamic_cast<AssignExpr*>(cases->Nth(nextCase));
+		if ( assignExpr == NULL )
+			return cases->Nth(nextCase++);
+		//Skip semantic checking of assignexpr inside switch statement
 	}
+	labels.clear();
 	loop_switchStack->pop();
 	symbolTable->pop(); //Pop scope
+	return NULL;
 }
 
 //Semantic Check for Case stmt
-void Case::Check(){
-	label->Check();
+Node *Case::CheckNext(int checked){
+	if ( checked == 0 )
+		return label;
 	StmtBlock* stmtBlock = dynamic_cast<StmtBlock*>(stmt);
-	if ( stmtBlock != NULL)	
-		symbolTable->push();
-
-	stmt->Check();
+	if ( checked == 1 ){
+		if ( stmtBlock != NULL)	
+			symbolTable->push();
+		return stmt;
+	}
 
 	if (stmtBlock != NULL )
 		symbolTable->pop();
+	return NULL;
 }
 
 //Semantic Check for Default Stmt
-void Default::Check(){
+Node *Default::CheckNext(int checked){
 	StmtBlock* stmtBlock = dynamic_cast<StmtBlock*>(stmt);
-	if ( stmtBlock != NULL )
-		symbolTable->push();
-	
-	stmt->Check();
+	if ( checked == 0 ){
+		if ( stmtBlock != NULL )
+			symbolTable->push();
+		return stmt;
+	}
 
 	if ( stmtBlock != NULL )
 		symbolTable->pop();
+	return NULL;
 }
 
 //Semantic Check for Break Stmt
-void BreakStmt::Check(){
+Node *BreakStmt::CheckNext(int checked){
 	if ( !(loop_switchStack->insideLoop()) && !(loop_switchStack->insideSwitch())){
 		ReportError::BreakOutsideLoop(this);
 	}
+	return NULL;
 }
 
 // Semantic Check for Continue Stmt
 
-void ContinueStmt::Check(){
+Node *ContinueStmt::CheckNext(int checked){
 	if ( !loop_switchStack->insideLoop() ){
 		ReportError::ContinueOutsideLoop(this);
 	}
+	return NULL;
 }
@@ -13,6 +13,7 @@
 #ifndef _H_ast_stmt
 #define _H_ast_stmt
 
+#include <atomic>
 #include "list.h"
 #include "ast.h"
 
@@ -20,6 +21,9 @@ class Decl;
 class VarDecl;
 class Expr;
 class IntConstant;
+class GlobalScope;
+class SavedScope;
+struct Diagnostic;
   
 void yyerror(const char *msg);
 
@@ -27,12 +31,47 @@ class Program : public Node
 {
   protected:
      List<Decl*> *decls;
+     static const vector<Decl*> *prelude;
      
   public:
      Program(List<Decl*> *declList);
      const char *GetPrintNameForNode() { return "Program"; }
-     void PrintChildren(int indentLevel);
+     void GetChildren(vector<Child> &children);
+     List<Decl*> *GetDecls() { return decls; }
      virtual void Check();
+
+     // Declarations every check starts with in its global scope, ahead
+     // of the program's own (--prelude, see prelude.h)
+     static void UsePrelude(const vector<Decl*> *decls) { prelude = decls; }
+     static const vector<Decl*> *GetPrelude() { return prelude; }
+
+     // Streaming check (--stream-check, and --emit-ast): each top-level
+     // declaration is checked as soon as it has been parsed, emitted into
+     // sink if there is one, and a function's body is freed once checked.
+     // FinishStreamedCheck() ends the global scope.
+     static void CheckStreamed(Decl *d, AstSink *sink = NULL);
+     static void FinishStreamedCheck();
+
+     // The threads --check-threads asks for (1 without the option)
+     static int NumCheckThreads();
+
+     // The two phases of CheckInPhases, for a caller that keeps results
+     // between checks (see incremental.h). CheckGlobals() collects each
+     // declaration's errors in found[i] and returns the frozen global
+     // scope. CheckBodies() checks the bodies of the functions marked in
+     // which, collecting their errors in bodyFound[i] and, if lookups is
+     // given, the names each body looked up in the global scope. Once
+     // *cancel is set it checks no more bodies, and returns false.
+     GlobalScope *CheckGlobals(vector< vector<Diagnostic> > &found);
+     bool CheckBodies(GlobalScope *global, const vector<bool> &which, int numThreads,
+                      vector< vector<Diagnostic> > &bodyFound,
+                      vector< vector<const char *> > *lookups = NULL,
+                      const atomic<bool> *cancel = NULL);
+
+  private:
+     static void EnterPrelude(GlobalScope *global);
+     static void CheckDecl(Decl *d);
+     void CheckInPhases(int numThreads);
 };
 
 class Stmt : public Node
@@ -40,7 +79,6 @@ class Stmt : public Node
   public:
      Stmt() : Node() {}
      Stmt(yyltype loc) : Node(loc) {}
-     virtual void Check() { };
 };
 
 class StmtBlock : public Stmt 
@@ -48,12 +86,22 @@ class StmtBlock : public Stmt
   protected:
     List<VarDecl*> *decls;
     List<Stmt*> *stmts;
+    yyltype braces;        // from { to }; not the node's location, which
+                           // a block has never had
+    SavedScope *scope;     // what the block's names were entered in, if
+                           // kept (see SymbolTable::keepScopes)
     
   public:
-    StmtBlock(List<VarDecl*> *variableDeclarations, List<Stmt*> *statements);
+    StmtBlock(List<VarDecl*> *variableDeclarations, List<Stmt*> *statements,
+              yyltype braces);
+    ~StmtBlock();
     const char *GetPrintNameForNode() { return "StmtBlock"; }
-    void PrintChildren(int indentLevel);
-    virtual void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
+
+    yyltype *GetBraces()       { return &braces; }
+    SavedScope *GetScope()     { return scope; }
+    void ForgetScope()         { scope = NULL; }
 };
 
 class DeclStmt: public Stmt 
@@ -63,9 +111,10 @@ class DeclStmt: public Stmt
     
   public:
     DeclStmt(Decl *d);
+    ~DeclStmt();
     const char *GetPrintNameForNode() { return "DeclStmt"; }
-    void PrintChildren(int indentLevel);
-    virtual void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
 };
   
 class ConditionalStmt : public Stmt
@@ -77,6 +126,7 @@ class ConditionalStmt : public Stmt
   public:
     ConditionalStmt() : Stmt(), test(NULL), body(NULL) {}
     ConditionalStmt(Expr *testExpr, Stmt *body);
+    ~ConditionalStmt();
 
 };
 
@@ -94,9 +144,10 @@ class ForStmt : public LoopStmt
   
   public:
     ForStmt(Expr *init, Expr *test, Expr *step, Stmt *body);
+    ~ForStmt();
     const char *GetPrintNameForNode() { return "ForStmt"; }
-    void PrintChildren(int indentLevel);
-    void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
 };
 
 class WhileStmt : public LoopStmt 
@@ -104,8 +155,8 @@ class WhileStmt : public LoopStmt
   public:
     WhileStmt(Expr *test, Stmt *body) : LoopStmt(test, body) {}
     const char *GetPrintNameForNode() { return "WhileStmt"; }
-    void PrintChildren(int indentLevel);
-    void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
 };
 
 class IfStmt : public ConditionalStmt 
@@ -116,9 +167,10 @@ class IfStmt : public ConditionalStmt
   public:
     IfStmt() : ConditionalStmt(), elseBody(NULL) {}
     IfStmt(Expr *test, Stmt *thenBody, Stmt *elseBody);
+    ~IfStmt() { DeleteChild(elseBody); }
     const char *GetPrintNameForNode() { return "IfStmt"; }
-    void PrintChildren(int indentLevel);
-    void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
 
 };
 
@@ -134,7 +186,7 @@ class BreakStmt : public Stmt
   public:
     BreakStmt(yyltype loc) : Stmt(loc) {}
     const char *GetPrintNameForNode() { return "BreakStmt"; }
-    void Check();
+    Node *CheckNext(int checked);
 };
 
 class ContinueStmt : public Stmt 
@@ -142,7 +194,7 @@ class ContinueStmt : public Stmt
   public:
     ContinueStmt(yyltype loc) : Stmt(loc) {}
     const char *GetPrintNameForNode() { return "ContinueStmt"; }
-    void Check();
+    Node *CheckNext(int checked);
 };
 
 class ReturnStmt : public Stmt  
@@ -152,9 +204,10 @@ class ReturnStmt : public Stmt
   
   public:
     ReturnStmt(yyltype loc, Expr *expr = NULL);
+    ~ReturnStmt();
     const char *GetPrintNameForNode() { return "ReturnStmt"; }
-    void PrintChildren(int indentLevel);
-    void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
 };
 
 class SwitchLabel : public Stmt
@@ -167,7 +220,10 @@ class SwitchLabel : public Stmt
     SwitchLabel() { label = NULL; stmt = NULL; }
     SwitchLabel(Expr *label, Stmt *stmt);
     SwitchLabel(Stmt *stmt);
-    void PrintChildren(int indentLevel);
+    ~SwitchLabel();
+    void GetChildren(vector<Child> &children);
+    Expr *GetLabel() { return label; }
+    Stmt *GetStmt() { return stmt; }
 
 };
 
@@ -177,7 +233,7 @@ class Case : public SwitchLabel
     Case() : SwitchLabel() {}
     Case(Expr *label, Stmt *stmt) : SwitchLabel(label, stmt) {}
     const char *GetPrintNameForNode() { return "Case"; }
-    void Check();
+    Node *CheckNext(int checked);
 };
 
 class Default : public SwitchLabel
@@ -185,7 +241,7 @@ class Default : public SwitchLabel
   public:
     Default(Stmt *stmt) : SwitchLabel(stmt) {}
     const char *GetPrintNameForNode() { return "Default"; }
-    void Check();
+    Node *CheckNext(int checked);
 };
 
 class SwitchStmt : public Stmt
@@ -194,13 +250,16 @@ class SwitchStmt : public Stmt
     Expr *expr;
     List<Stmt*> *cases;
     Default *def;
+    vector<int> labels;    // the case values met so far, while checked
+    int nextCase;          // the case to check next, while checked
 
   public:
-    SwitchStmt() : expr(NULL), cases(NULL), def(NULL) {}
+    SwitchStmt() : expr(NULL), cases(NULL), def(NULL), nextCase(0) {}
     SwitchStmt(Expr *expr, List<Stmt*> *cases, Default *def);
+    ~SwitchStmt();
     virtual const char *GetPrintNameForNode() { return "SwitchStmt"; }
-    void PrintChildren(int indentLevel);
-    void Check();
+    void GetChildren(vector<Child> &children);
+    Node *CheckNext(int checked);
 };
 
 class SwitchStmtError : public SwitchStmt
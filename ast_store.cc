@@ -0,0 +1,121 @@
+/* File: ast_store.cc
+ * ------------------
+ * Filling an AstStore from an emitted tree (see ast_store.h).
+ */
+
+#include <string.h>
+#include "ast_store.h"
+#include "utility.h"
+
+static_assert(NumBastKinds <= 256, "kinds are stored in a byte");
+
+AstStore::AstStore() {
+    labels.push_back(NULL);
+    types.push_back(NULL);
+}
+
+uint32_t AstStore::AddText(const char *s) {
+    uint32_t off = text.size();
+    text.append(s, strlen(s) + 1);
+    return off;
+}
+
+void AstStore::BeginNode(const char *printName, yyltype *loc, const char *l, Type *t) {
+    uint32_t index = kind.size();
+    kind.push_back(KindOf(printName));
+    valueKind.push_back(BV_None);
+    value.push_back(0);
+
+    uint8_t labelId = 0;
+    if (l) {
+        unordered_map<const char *, uint8_t>::iterator it = labelIds.find(l);
+        if (it == labelIds.end()) {
+            Assert(labels.size() < 256);
+            it = labelIds.insert(make_pair(l, (uint8_t)labels.size())).first;
+            labels.push_back(l);
+        }
+        labelId = it->second;
+    }
+    label.push_back(labelId);
+
+    uint32_t typeId = 0;
+    if (t) {
+        unordered_map<Type *, uint32_t>::iterator it = typeIds.find(t);
+        if (it == typeIds.end()) {
+            it = typeIds.insert(make_pair(t, (uint32_t)types.size())).first;
+            types.push_back(t);
+        }
+        typeId = it->second;
+    }
+    type.push_back(typeId);
+
+    Span s = { 0, 0, 0, 0 };
+    if (loc) {
+        s.firstLine = loc->first_line;
+        s.firstColumn = loc->first_column;
+        s.lastLine = loc->last_line;
+        s.lastColumn = loc->last_column;
+    }
+    span.push_back(s);
+    hasLocation.push_back(loc != NULL);
+
+    firstChild.push_back(0);
+    nextSibling.push_back(0);
+    if (open.empty()) {
+        parent.push_back(0);
+    } else {
+        parent.push_back(open.back());
+        if (lastChild.back()) nextSibling[lastChild.back()] = index;
+        else firstChild[open.back()] = index;
+        lastChild.back() = index;
+    }
+    open.push_back(index);
+    lastChild.push_back(0);
+}
+
+void AstStore::EndNode() {
+    Assert(!open.empty());
+    open.pop_back();
+    lastChild.pop_back();
+}
+
+void AstStore::SetInt(int64_t v) {
+    valueKind[open.back()] = BV_Int;
+    value[open.back()] = ints.size();
+    ints.push_back(v);
+}
+
+void AstStore::SetFloat(double v) {
+    valueKind[open.back()] = BV_Float;
+    value[open.back()] = floats.size();
+    floats.push_back(v);
+}
+
+void AstStore::SetBool(bool v) {
+    valueKind[open.back()] = BV_Bool;
+    value[open.back()] = ints.size();
+    ints.push_back(v);
+}
+
+// Operators and type names belong to their nodes, so the text is copied
+void AstStore::SetString(const char *v) {
+    valueKind[open.back()] = BV_String;
+    value[open.back()] = AddText(v);
+}
+
+// Interned names live as long as the program, and recur, so each is
+// copied once
+void AstStore::SetName(const char *name) {
+    unordered_map<const char *, uint32_t>::iterator it = nameOffsets.find(name);
+    if (it == nameOffsets.end())
+        it = nameOffsets.insert(make_pair(name, AddText(name))).first;
+    valueKind[open.back()] = BV_String;
+    value[open.back()] = it->second;
+}
+
+size_t AstStore::MemoryUsed() const {
+    size_t n = NumNodes();
+    return n * (4 * sizeof(uint8_t) + 5 * sizeof(uint32_t) + sizeof(Span))
+         + ints.size() * sizeof(int64_t) + floats.size() * sizeof(double)
+         + text.size();
+}
@@ -0,0 +1,107 @@
+/* File: ast_store.h
+ * -----------------
+ * AstStore holds a tree in flat parallel arrays instead of as linked
+ * heap objects. Node i is described by kind[i], parent[i], span[i] and
+ * so on; nodes refer to each other by 32-bit index and are stored in
+ * preorder, with the Program at index 0. Index 0 also stands for "no
+ * node" in the child and sibling links, since the root is never a child.
+ *
+ * Values live in one array per value kind (the integer constants, the
+ * float constants, the text of names and operators), and value[i] is an
+ * index into the array that valueKind[i] selects. Expression types are
+ * numbered in order of first use, so type[i] is a small integer and the
+ * Type objects are only looked up when needed.
+ *
+ * A store is filled by emitting checked nodes into it (it is an
+ * AstSink), after which whole-tree passes can run over the arrays
+ * instead of chasing pointers: a pass that wants only the kinds, or only
+ * the spans, reads just that array. It takes well under half the memory
+ * of the tree it was built from.
+ *
+ * --emit-ast fills one a declaration at a time, as each is parsed and
+ * checked, and frees the function body it came from; the store is then
+ * the only whole copy of the program, and its file is written from it
+ * (see WriteAst in bast.h). Checking itself still walks the linked
+ * nodes, since it works through their scopes and reports on them.
+ */
+
+#ifndef _H_ast_store
+#define _H_ast_store
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "bast.h"
+
+using namespace std;
+
+class Type;
+
+class AstStore : public AstSink {
+  public:
+    struct Span {
+        int32_t firstLine, firstColumn, lastLine, lastColumn;
+    };
+
+  private:
+    vector<uint8_t> kind;            // BastKind
+    vector<uint8_t> valueKind;       // BastValueKind
+    vector<uint8_t> hasLocation;
+    vector<uint8_t> label;           // index into labels
+    vector<uint32_t> type;           // index into types, 0 for none
+    vector<uint32_t> parent, firstChild, nextSibling;
+    vector<uint32_t> value;
+    vector<Span> span;
+
+    vector<int64_t> ints;            // IntConstant, BoolConstant, ArrayType
+    vector<double> floats;           // FloatConstant
+    string text;                     // names and operators, NUL-terminated
+
+    vector<const char *> labels;     // labels[0] is NULL
+    vector<Type *> types;            // types[0] is NULL
+    unordered_map<const char *, uint8_t> labelIds;
+    unordered_map<Type *, uint32_t> typeIds;
+    unordered_map<const char *, uint32_t> nameOffsets;   // by pointer
+
+    vector<uint32_t> open;           // the nodes begun but not yet ended
+    vector<uint32_t> lastChild;      // parallel to open
+
+    uint32_t AddText(const char *s);
+
+  public:
+    AstStore();
+
+    void BeginNode(const char *printName, yyltype *loc, const char *label, Type *type);
+    void EndNode();
+    void SetInt(int64_t value);
+    void SetFloat(double value);
+    void SetBool(bool value);
+    void SetString(const char *value);
+    void SetName(const char *name);
+
+    uint32_t NumNodes() const                 { return kind.size(); }
+    BastKind Kind(uint32_t i) const           { return (BastKind)kind[i]; }
+    uint32_t Parent(uint32_t i) const         { return parent[i]; }
+    uint32_t FirstChild(uint32_t i) const     { return firstChild[i]; }
+    uint32_t NextSibling(uint32_t i) const    { return nextSibling[i]; }
+    const char *Label(uint32_t i) const       { return labels[label[i]]; }
+    uint8_t LabelId(uint32_t i) const         { return label[i]; }
+    Type *TypeOf(uint32_t i) const            { return types[type[i]]; }
+    uint32_t TypeId(uint32_t i) const         { return type[i]; }
+    uint32_t NumTypes() const                 { return types.size(); }
+    Type *TypeById(uint32_t id) const         { return types[id]; }
+    bool HasLocation(uint32_t i) const        { return hasLocation[i]; }
+    const Span &SpanOf(uint32_t i) const      { return span[i]; }
+
+    BastValueKind ValueKind(uint32_t i) const { return (BastValueKind)valueKind[i]; }
+    uint32_t Value(uint32_t i) const          { return value[i]; }
+    int64_t IntValue(uint32_t i) const        { return ints[value[i]]; }
+    double FloatValue(uint32_t i) const       { return floats[value[i]]; }
+    const char *StringValue(uint32_t i) const { return text.data() + value[i]; }
+
+    // The bytes the arrays hold, for comparing with the linked tree
+    size_t MemoryUsed() const;
+};
+
+#endif
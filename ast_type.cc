@@ -6,6 +6,7 @@
 #include <string.h>
 #include "ast_type.h"
 #include "ast_decl.h"
+#include "bast.h"
  
 /* Class constants
  * ---------------
@@ -47,8 +48,8 @@ Type::Type(const char *n) {
     typeName = strdup(n);
 }
 
-void Type::PrintChildren(int indentLevel) {
-    printf("%s", typeName);
+void Type::EmitValue(AstSink *w) {
+    w->SetString(typeName);
 }
 
 TypeQualifier::TypeQualifier(const char *n) {
@@ -56,8 +57,25 @@ TypeQualifier::TypeQualifier(const char *n) {
     typeQualifierName = strdup(n);
 }
 
-void TypeQualifier::PrintChildren(int indentLevel) {
-    printf("%s", typeQualifierName);
+void TypeQualifier::EmitValue(AstSink *w) {
+    w->SetString(typeQualifierName);
+}
+
+int Type::ConversionTo(Type *other) {
+    static Type **conversions[][2] = {
+        {&Type::intType, &Type::uintType}, {&Type::intType, &Type::floatType},
+        {&Type::uintType, &Type::floatType},
+        {&Type::ivec2Type, &Type::uvec2Type}, {&Type::ivec2Type, &Type::vec2Type},
+        {&Type::uvec2Type, &Type::vec2Type},
+        {&Type::ivec3Type, &Type::uvec3Type}, {&Type::ivec3Type, &Type::vec3Type},
+        {&Type::uvec3Type, &Type::vec3Type},
+        {&Type::ivec4Type, &Type::uvec4Type}, {&Type::ivec4Type, &Type::vec4Type},
+        {&Type::uvec4Type, &Type::vec4Type},
+    };
+    if (this == other) return 0;
+    for (Type **const *c : conversions)
+        if (*c[0] == this && *c[1] == other) return 1;
+    return -1;
 }
 
 bool Type::IsNumeric() { 
@@ -85,8 +103,8 @@ NamedType::NamedType(Identifier *i) : Type(*i->GetLocation()) {
     (id=i)->SetParent(this);
 } 
 
-void NamedType::PrintChildren(int indentLevel) {
-    id->Print(indentLevel+1);
+void NamedType::GetChildren(vector<Child> &children) {
+    children.push_back(Child(id));
 }
 
 ArrayType::ArrayType(yyltype loc, Type *et, int ec) : Type(loc) {
@@ -94,8 +112,12 @@ ArrayType::ArrayType(yyltype loc, Type *et, int ec) : Type(loc) {
     (elemType=et)->SetParent(this);
     elemCount=ec;
 }
-void ArrayType::PrintChildren(int indentLevel) {
-    elemType->Print(indentLevel+1);
+void ArrayType::EmitValue(AstSink *w) {
+    w->SetInt(elemCount);
+}
+
+void ArrayType::GetChildren(vector<Child> &children) {
+    children.push_back(Child(elemType));
 }
 
 
@@ -30,7 +30,7 @@ class TypeQualifier : public Node
     TypeQualifier(const char *str);
 
     const char *GetPrintNameForNode() { return "TypeQualifier"; }
-    void PrintChildren(int indentLevel);
+    void EmitValue(AstSink *w);
 };
 
 class Type : public Node 
@@ -51,12 +51,17 @@ class Type : public Node
     Type(const char *str);
     
     const char *GetPrintNameForNode() { return "Type"; }
-    void PrintChildren(int indentLevel);
+    void EmitValue(AstSink *w);
 
     virtual void PrintToStream(ostream& out) { out << typeName; }
     friend ostream& operator<<(ostream& out, Type *t) { t->PrintToStream(out); return out; }
     virtual bool IsEquivalentTo(Type *other) { return (this == other); }
     virtual bool IsConvertibleTo(Type *other) { return (this == other || this == errorType); }
+    // The cost of passing a value of this type to a parameter of type
+    // other: 0 if they are the same type, 1 by an implicit conversion
+    // (int to uint, int or uint to float, and their vectors alike), and
+    // -1 if it does not convert
+    int ConversionTo(Type *other);
     bool IsNumeric();
     bool IsVector();
     bool IsMatrix();
@@ -73,7 +78,7 @@ class NamedType : public Type
     NamedType(Identifier *i);
     
     const char *GetPrintNameForNode() { return "NamedType"; }
-    void PrintChildren(int indentLevel);
+    void GetChildren(vector<Child> &children);
     void PrintToStream(ostream& out) { out << id; }
 };
 
@@ -87,9 +92,11 @@ class ArrayType : public Type
     ArrayType(yyltype loc, Type *elemType, int elemCount);
     
     const char *GetPrintNameForNode() { return "ArrayType"; }
-    void PrintChildren(int indentLevel);
+    void EmitValue(AstSink *w);
+    void GetChildren(vector<Child> &children);
     void PrintToStream(ostream& out) { out << elemType << "[]"; }
     Type *GetElemType() {return elemType;}
+    int GetElemCount() {return elemCount;}
 };
 
  
@@ -0,0 +1,490 @@
+/* File: bast.cc
+ * -------------
+ * Writing, loading and printing .bast files (see bast.h).
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sstream>
+#include "bast.h"
+#include "ast_store.h"
+#include "ast_type.h"
+#include "utility.h"
+
+static const char *kindNames[NumBastKinds] = {
+    "Program", "Identifier", "Error",
+    "VarDecl", "VarDeclError", "FnDecl", "FormalsError",
+    "StmtBlock", "DeclStmt", "ForStmt", "WhileStmt", "IfStmt",
+    "IfStmtExprError", "BreakStmt", "ContinueStmt", "ReturnStmt",
+    "Case", "Default", "SwitchStmt", "SwitchStmtError",
+    "ExprError", "Empty", "IntConstant", "FloatConstant",
+    "BoolConstant", "VarExpr", "Operator", "ArithmeticExpr",
+    "RelationalExpr", "EqualityExpr", "LogicalExpr", "AssignExpr",
+    "PostfixExpr", "ConditionalExpr", "ArrayAccess", "FieldAccess",
+    "Call", "ActualsError",
+    "TypeQualifier", "Type", "NamedType", "ArrayType",
+};
+
+const char *BastKindName(int kind) {
+    Assert(kind >= 0 && kind < NumBastKinds);
+    return kindNames[kind];
+}
+
+
+/* Writing */
+
+// Print names are string literals, so each class nearly always passes
+// the same pointer and the search below runs once per class
+uint16_t AstSink::KindOf(const char *printName) {
+    unordered_map<const char *, uint16_t>::iterator it = kinds.find(printName);
+    if (it != kinds.end()) return it->second;
+    for (int k = 0; k < NumBastKinds; k++)
+        if (strcmp(kindNames[k], printName) == 0)
+            return kinds[printName] = k;
+    Failure("No .bast node kind for %s", printName);
+    return 0;
+}
+
+const char *AstSink::TypeName(Type *type) {
+    unordered_map<Type *, string>::iterator it = typeNames.find(type);
+    if (it == typeNames.end()) {
+        ostringstream name;
+        type->PrintToStream(name);
+        it = typeNames.insert(make_pair(type, name.str())).first;
+    }
+    return it->second.c_str();
+}
+
+/* The string table holds each text once. Labels and interned names are
+ * looked up by their index in the store rather than by text, since they
+ * recur on almost every node.
+ */
+class StringTable {
+    unordered_map<string, uint32_t> offsets;
+
+  public:
+    string strings;
+
+    StringTable() { strings.push_back('\0'); }    // offset 0 is the empty string
+
+    uint32_t Add(const char *s) {
+        if (!*s) return 0;
+        unordered_map<string, uint32_t>::iterator it = offsets.find(s);
+        if (it != offsets.end()) return it->second;
+        uint32_t off = strings.size();
+        strings.append(s, strlen(s) + 1);
+        offsets[s] = off;
+        return off;
+    }
+};
+
+static const uint32_t NotAdded = UINT32_MAX;
+
+/* The nodes go out a block at a time as they are converted, so the
+ * whole node array never exists in memory; the header, which needs the
+ * size of the string table, is written last.
+ */
+bool WriteAst(const AstStore &store, const char *path) {
+    uint32_t count = store.NumNodes();
+    Assert(count > 0);
+    FILE *f = fopen(path, "wb");
+    if (!f) return false;
+
+    BastHeader header;
+    memset(&header, 0, sizeof(header));
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1;
+
+    const uint32_t BlockSize = 1024;
+    BastNode block[BlockSize];
+    StringTable table;
+    vector<uint32_t> labelOffsets(256, NotAdded);
+    vector<uint32_t> typeOffsets(store.NumTypes(), NotAdded);
+    unordered_map<uint32_t, uint32_t> nameOffsets;    // by offset in the store
+
+    for (uint32_t i = 0; i < count && ok; i++) {
+        BastNode &n = block[i % BlockSize];
+        memset(&n, 0, sizeof(n));
+        n.kind = store.Kind(i);
+        if (uint8_t id = store.LabelId(i)) {
+            if (labelOffsets[id] == NotAdded) labelOffsets[id] = table.Add(store.Label(i));
+            n.label = labelOffsets[id];
+        }
+        if (uint32_t id = store.TypeId(i)) {
+            if (typeOffsets[id] == NotAdded) {
+                ostringstream name;
+                store.TypeById(id)->PrintToStream(name);
+                typeOffsets[id] = table.Add(name.str().c_str());
+            }
+            n.type = typeOffsets[id];
+        }
+        if (store.HasLocation(i)) {
+            const AstStore::Span &s = store.SpanOf(i);
+            n.hasLocation = 1;
+            n.firstLine = s.firstLine;
+            n.firstColumn = s.firstColumn;
+            n.lastLine = s.lastLine;
+            n.lastColumn = s.lastColumn;
+        }
+        n.firstChild = store.FirstChild(i);
+        n.nextSibling = store.NextSibling(i);
+        n.valueKind = store.ValueKind(i);
+        switch (n.valueKind) {
+          case BV_Int: case BV_Bool:
+            n.value.intValue = store.IntValue(i);
+            break;
+          case BV_Float:
+            n.value.floatValue = store.FloatValue(i);
+            break;
+          case BV_String:
+            if (n.kind == B_Identifier) {
+                unordered_map<uint32_t, uint32_t>::iterator it = nameOffsets.find(store.Value(i));
+                if (it == nameOffsets.end())
+                    it = nameOffsets.insert(make_pair(store.Value(i),
+                                                      table.Add(store.StringValue(i)))).first;
+                n.value.string = it->second;
+            } else {
+                n.value.string = table.Add(store.StringValue(i));
+            }
+            break;
+        }
+        uint32_t filled = i % BlockSize + 1;
+        if (filled == BlockSize || i == count - 1)
+            ok = fwrite(block, sizeof(BastNode), filled, f) == filled;
+    }
+
+    memcpy(header.magic, BastMagic, 4);
+    header.version = BastVersion;
+    header.nodeCount = count;
+    header.nodeOffset = sizeof(header);    // a multiple of 8
+    header.stringOffset = header.nodeOffset + count * sizeof(BastNode);
+    header.stringSize = table.strings.size();
+    ok = ok && fwrite(table.strings.data(), 1, table.strings.size(), f) == table.strings.size()
+            && fseek(f, 0, SEEK_SET) == 0
+            && fwrite(&header, sizeof(header), 1, f) == 1;
+    return fclose(f) == 0 && ok;
+}
+
+/* Loading */
+
+// Checks everything a reader follows. Children and next siblings come
+// after a node in preorder, so any walk along them terminates.
+static bool IsWellFormed(const BastFile *file) {
+    const BastHeader *h = file->header;
+    if (memcmp(h->magic, BastMagic, 4) != 0 || h->version != BastVersion)
+        return false;
+    if (h->nodeCount == 0 || h->nodeOffset % 8 != 0 || h->nodeOffset < sizeof(BastHeader)
+        || h->nodeOffset > file->size
+        || (file->size - h->nodeOffset) / sizeof(BastNode) < h->nodeCount)
+        return false;
+    if (h->stringSize == 0 || h->stringOffset > file->size
+        || file->size - h->stringOffset < h->stringSize)
+        return false;
+    if (file->strings[0] != '\0' || file->strings[h->stringSize - 1] != '\0')
+        return false;
+
+    for (uint32_t i = 0; i < h->nodeCount; i++) {
+        const BastNode &n = file->nodes[i];
+        if (n.kind >= NumBastKinds || n.valueKind > BV_String)
+            return false;
+        if ((n.firstChild && (n.firstChild <= i || n.firstChild >= h->nodeCount))
+            || (n.nextSibling && (n.nextSibling <= i || n.nextSibling >= h->nodeCount)))
+            return false;
+        if (n.label >= h->stringSize || n.type >= h->stringSize
+            || (n.valueKind == BV_String && n.value.string >= h->stringSize))
+            return false;
+    }
+    return true;
+}
+
+const BastFile *LoadAst(const char *path) {
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(BastHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+
+    BastFile *file = new BastFile;
+    file->header = (const BastHeader *)map;
+    file->size = st.st_size;
+    file->nodeCount = file->header->nodeCount;
+    file->nodes = (const BastNode *)((const char *)map + file->header->nodeOffset);
+    file->strings = (const char *)map + file->header->stringOffset;
+    if (!IsWellFormed(file)) {
+        UnloadAst(file);
+        return NULL;
+    }
+    return file;
+}
+
+void UnloadAst(const BastFile *file) {
+    munmap((void *)file->header, file->size);
+    delete file;
+}
+
+
+/* Printing
+ * --------
+ * Dumps are large, so they go through one output buffer and integers
+ * are formatted by hand; only floating-point constants use snprintf.
+ */
+class DumpBuffer {
+    char buf[64 * 1024];
+    size_t used;
+    FILE *out;
+
+  public:
+    DumpBuffer(FILE *f) : used(0), out(f) {}
+    ~DumpBuffer() { Flush(); }
+
+    void Flush() {
+        fwrite(buf, 1, used, out);
+        used = 0;
+    }
+    void Reserve(size_t len) {
+        if (used + len > sizeof(buf)) Flush();
+    }
+    void Put(char c) {
+        Reserve(1);
+        buf[used++] = c;
+    }
+    void Put(const char *s, size_t len) {
+        if (len > sizeof(buf)) {
+            Flush();
+            fwrite(s, 1, len, out);
+            return;
+        }
+        Reserve(len);
+        memcpy(buf + used, s, len);
+        used += len;
+    }
+    void Put(const char *s) { Put(s, strlen(s)); }
+    void PutSpaces(int n) {
+        for (; n > 0; n--) Put(' ');
+    }
+    // As printf("%*d", width, value)
+    void PutInt(int64_t value, int width = 0) {
+        char digits[24];
+        int len = 0;
+        uint64_t v = value < 0 ? -(uint64_t)value : value;
+        do {
+            digits[sizeof(digits) - ++len] = '0' + v % 10;
+            v /= 10;
+        } while (v);
+        if (value < 0) digits[sizeof(digits) - ++len] = '-';
+        PutSpaces(width - len);
+        Put(digits + sizeof(digits) - len, len);
+    }
+    void PutFloat(double value) {
+        char text[32];
+        Put(text, snprintf(text, sizeof(text), "%g", value));
+    }
+    // A JSON string literal
+    void PutQuoted(const char *s) {
+        Put('"');
+        for (; *s; s++) {
+            unsigned char c = *s;
+            if (c == '"' || c == '\\') {
+                Put('\\');
+                Put(c);
+            } else if (c < 0x20) {
+                static const char hex[] = "0123456789abcdef";
+                Put("\\u00", 4);
+                Put(hex[c >> 4]);
+                Put(hex[c & 15]);
+            } else {
+                Put(c);
+            }
+        }
+        Put('"');
+    }
+};
+
+AstPrinter::AstPrinter(AstFormat f) : out(new DumpBuffer(stdout)), format(f), pending(false) {}
+
+AstPrinter::~AstPrinter() {
+    delete out;    // flushes
+}
+
+void AstPrinter::Begin(int kind, bool hasLocation, int firstLine, int firstColumn,
+                       int lastLine, int lastColumn, const char *label, const char *type) {
+    PrintPending();
+    if (format == AstJson && !hasChildren.empty()) {
+        if (hasChildren.back()) out->Put(',');
+        else out->Put(",\"children\":[");
+    }
+    if (!hasChildren.empty()) hasChildren.back() = true;
+    hasChildren.push_back(false);
+
+    node.kind = kind;
+    node.hasLocation = hasLocation;
+    node.firstLine = firstLine;
+    node.firstColumn = firstColumn;
+    node.lastLine = lastLine;
+    node.lastColumn = lastColumn;
+    node.label = label ? label : "";
+    node.type = type;
+    node.valueKind = BV_None;
+    pending = true;
+}
+
+void AstPrinter::BeginNode(const char *printName, yyltype *loc, const char *label, Type *type) {
+    if (loc)
+        Begin(KindOf(printName), true, loc->first_line, loc->first_column,
+              loc->last_line, loc->last_column, label, type ? TypeName(type) : NULL);
+    else
+        Begin(KindOf(printName), false, 0, 0, 0, 0, label, type ? TypeName(type) : NULL);
+}
+
+void AstPrinter::EndNode() {
+    Assert(!hasChildren.empty());
+    PrintPending();
+    if (format == AstJson) {
+        if (hasChildren.back()) out->Put("]}", 2);
+        else out->Put('}');
+    }
+    hasChildren.pop_back();
+}
+
+void AstPrinter::SetInt(int64_t value) {
+    node.valueKind = BV_Int;
+    node.intValue = value;
+}
+
+void AstPrinter::SetFloat(double value) {
+    node.valueKind = BV_Float;
+    node.floatValue = value;
+}
+
+void AstPrinter::SetBool(bool value) {
+    node.valueKind = BV_Bool;
+    node.intValue = value;
+}
+
+void AstPrinter::SetString(const char *value) {
+    node.valueKind = BV_String;
+    node.string = value;
+}
+
+void AstPrinter::Finish() {
+    Assert(hasChildren.empty());
+    out->Put('\n');    // as Program::PrintChildren
+    out->Flush();
+}
+
+// Text: the same line Node::Print and PrintChildren produce for the
+// node. JSON: everything but the children and the closing brace.
+void AstPrinter::PrintPending() {
+    if (!pending) return;
+    pending = false;
+    const Pending &n = node;
+
+    if (format == AstText) {
+        const int numSpaces = 3;
+        out->Put('\n');
+        if (n.hasLocation)
+            out->PutInt(n.firstLine, numSpaces);
+        else
+            out->PutSpaces(numSpaces);
+        out->PutSpaces((hasChildren.size() - 1) * numSpaces);
+        out->Put(n.label);
+        out->Put(BastKindName(n.kind));
+        if (n.type) {
+            out->Put(" [", 2);
+            out->Put(n.type);
+            out->Put(']');
+        }
+        out->Put(": ", 2);
+        // Only the literals show their values; an array's count and the
+        // value an expression was folded to are left to the JSON format
+        switch (n.valueKind) {
+          case BV_Int:
+            if (n.kind == B_IntConstant) out->PutInt((int)n.intValue);
+            break;
+          case BV_Float:
+            if (n.kind == B_FloatConstant) out->PutFloat(n.floatValue);
+            break;
+          case BV_Bool:
+            if (n.kind == B_BoolConstant) out->Put(n.intValue ? "true" : "false");
+            break;
+          case BV_String: out->Put(n.string); break;
+        }
+        return;
+    }
+
+    out->Put("{\"kind\":");
+    out->PutQuoted(BastKindName(n.kind));
+    if (*n.label) {
+        out->Put(",\"label\":");
+        out->PutQuoted(n.label);
+    }
+    if (n.type) {
+        out->Put(",\"type\":");
+        out->PutQuoted(n.type);
+    }
+    if (n.hasLocation) {
+        out->Put(",\"span\":[");
+        out->PutInt(n.firstLine);
+        out->Put(',');
+        out->PutInt(n.firstColumn);
+        out->Put(',');
+        out->PutInt(n.lastLine);
+        out->Put(',');
+        out->PutInt(n.lastColumn);
+        out->Put(']');
+    }
+    if (n.valueKind != BV_None) out->Put(",\"value\":");
+    switch (n.valueKind) {
+      case BV_Int:    out->PutInt(n.intValue); break;
+      case BV_Float:  out->PutFloat(n.floatValue); break;
+      case BV_Bool:   out->Put(n.intValue ? "true" : "false"); break;
+      case BV_String: out->PutQuoted(n.string); break;
+    }
+}
+
+// Feeds the nodes to a printer in preorder, keeping the nodes whose
+// children are being printed on an explicit stack
+void PrintAst(const BastFile *file, AstFormat format) {
+    AstPrinter printer(format);
+    vector<uint32_t> open;
+    uint32_t i = 0;
+    for (;;) {
+        const BastNode &n = file->nodes[i];
+        printer.Begin(n.kind, n.hasLocation, n.firstLine, n.firstColumn, n.lastLine,
+                      n.lastColumn, BastString(file, n.label),
+                      n.type ? BastString(file, n.type) : NULL);
+        switch (n.valueKind) {
+          case BV_Int:    printer.SetInt(n.value.intValue); break;
+          case BV_Float:  printer.SetFloat(n.value.floatValue); break;
+          case BV_Bool:   printer.SetBool(n.value.intValue); break;
+          case BV_String: printer.SetString(BastString(file, n.value.string)); break;
+        }
+        if (n.firstChild) {
+            open.push_back(i);
+            i = n.firstChild;
+            continue;
+        }
+        printer.EndNode();
+        // climb to the nearest node with a sibling still to print
+        while (!file->nodes[i].nextSibling && !open.empty()) {
+            i = open.back();
+            open.pop_back();
+            printer.EndNode();
+        }
+        if (!file->nodes[i].nextSibling) break;
+        i = file->nodes[i].nextSibling;
+    }
+    printer.Finish();
+}
+
+AstFormat AstFormatOption() {
+    const char *format = GetOption("dump-format");
+    return format && !strcmp(format, "json") ? AstJson : AstText;
+}
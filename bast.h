@@ -0,0 +1,220 @@
+/* File: bast.h
+ * ------------
+ * The binary AST file format written by glc --emit-ast=<file>, and a
+ * loader for it. A .bast file holds the checked tree: every node's kind,
+ * source span, print label and payload (name, operator or constant), and
+ * for expressions the name of the type the checker resolved and the
+ * constant it folded them to, if any.
+ *
+ * The file is meant to be mapped and walked in place, so it contains no
+ * pointers. It is a header, then an array of fixed-size nodes, then a
+ * string table. Nodes refer to each other by index into the node array
+ * and to text by byte offset into the string table. Node 0 is the
+ * Program, and nodes are stored in preorder. Index 0 and string offset 0
+ * both stand for "none", because the root is never a child and the
+ * string table starts with an empty string. Fields use the host byte
+ * order.
+ *
+ * A tool loads a file once with LoadAst() and then reads nodes, children
+ * and strings directly out of the mapping:
+ *
+ *   const BastFile *ast = LoadAst("shader.bast");
+ *   for (uint32_t i = ast->nodes[0].firstChild; i; i = ast->nodes[i].nextSibling)
+ *       printf("%s\n", BastKindName(ast->nodes[i].kind));
+ */
+
+#ifndef _H_bast
+#define _H_bast
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "location.h"
+
+using namespace std;
+
+class Type;
+
+#define BastMagic "BAST"
+#define BastVersion 1
+
+/* Node kinds, one per AST class. The names are the classes' print names
+ * (GetPrintNameForNode); new kinds are only ever added at the end.
+ */
+enum BastKind {
+    B_Program, B_Identifier, B_Error,
+    B_VarDecl, B_VarDeclError, B_FnDecl, B_FormalsError,
+    B_StmtBlock, B_DeclStmt, B_ForStmt, B_WhileStmt, B_IfStmt,
+    B_IfStmtExprError, B_BreakStmt, B_ContinueStmt, B_ReturnStmt,
+    B_Case, B_Default, B_SwitchStmt, B_SwitchStmtError,
+    B_ExprError, B_EmptyExpr, B_IntConstant, B_FloatConstant,
+    B_BoolConstant, B_VarExpr, B_Operator, B_ArithmeticExpr,
+    B_RelationalExpr, B_EqualityExpr, B_LogicalExpr, B_AssignExpr,
+    B_PostfixExpr, B_ConditionalExpr, B_ArrayAccess, B_FieldAccess,
+    B_Call, B_ActualsError,
+    B_TypeQualifier, B_Type, B_NamedType, B_ArrayType,
+    NumBastKinds
+};
+
+// What the value field of a node holds
+enum BastValueKind {
+    BV_None, BV_Int, BV_Float, BV_Bool, BV_String
+};
+
+struct BastHeader {
+    char magic[4];           // BastMagic, not NUL-terminated
+    uint32_t version;        // BastVersion
+    uint32_t nodeCount;
+    uint32_t nodeOffset;     // byte offsets from the start of the file
+    uint32_t stringOffset;
+    uint32_t stringSize;
+};
+
+struct BastNode {
+    uint16_t kind;           // BastKind
+    uint8_t valueKind;       // BastValueKind
+    uint8_t hasLocation;     // 0 if the span below is meaningless
+    uint32_t label;          // string offset of the print label ("(body) ")
+    uint32_t type;           // string offset of an expression's type name
+    uint32_t firstChild;     // node indices
+    uint32_t nextSibling;
+    int32_t firstLine, firstColumn, lastLine, lastColumn;
+    union {                  // literals, and expressions folded to a constant:
+        int64_t intValue;    // int and bool values, ArrayType count
+        double floatValue;   // float values
+        uint32_t string;     // Identifier, Operator, Type, TypeQualifier
+    } value;
+};
+
+static_assert(sizeof(BastHeader) == 24 && sizeof(BastNode) == 48,
+              "the .bast layout must not depend on the compiler");
+
+/* A loaded file: the arrays point into the mapping. */
+struct BastFile {
+    const BastHeader *header;
+    const BastNode *nodes;
+    uint32_t nodeCount;
+    const char *strings;
+    size_t size;             // of the mapping
+};
+
+/* Function: LoadAst
+ * -----------------
+ * Maps the .bast file at path and checks that it is well formed (every
+ * index and offset in range), so the caller can then follow them without
+ * checks. Returns NULL if the file cannot be read or is not a valid
+ * .bast file of this version.
+ */
+const BastFile *LoadAst(const char *path);
+
+/* Function: UnloadAst
+ * -------------------
+ * Unmaps a file returned by LoadAst.
+ */
+void UnloadAst(const BastFile *file);
+
+// Returns the text at string offset off ("" for 0)
+inline const char *BastString(const BastFile *file, uint32_t off) {
+    return file->strings + off;
+}
+
+// Returns the print name of a BastKind
+const char *BastKindName(int kind);
+
+enum AstFormat {
+    AstText,      // the indented tree Node::Print produces
+    AstJson       // one object per node: kind, label, type, span, value, children
+};
+
+// The format selected with --dump-format=text|json (text by default)
+AstFormat AstFormatOption();
+
+/* Function: PrintAst
+ * ------------------
+ * Prints a loaded tree to stdout in the given format, walking the node
+ * array without recursion.
+ */
+void PrintAst(const BastFile *file, AstFormat format = AstText);
+
+
+/* Class: AstSink
+ * --------------
+ * What Node::Emit walks the tree into. BeginNode() starts a node as the
+ * next child of the node being emitted, Set*() give it its value, and
+ * EndNode() returns to its parent.
+ */
+class AstSink {
+    unordered_map<const char *, uint16_t> kinds;    // by print name pointer
+    unordered_map<Type *, string> typeNames;
+
+  protected:
+    uint16_t KindOf(const char *printName);
+    const char *TypeName(Type *type);
+
+  public:
+    virtual ~AstSink() {}
+    virtual void BeginNode(const char *printName, yyltype *loc, const char *label, Type *type) = 0;
+    virtual void EndNode() = 0;
+    virtual void SetInt(int64_t value) = 0;
+    virtual void SetFloat(double value) = 0;
+    virtual void SetBool(bool value) = 0;
+    virtual void SetString(const char *value) = 0;
+    // For interned names (see intern.h), which sinks may key by pointer
+    virtual void SetName(const char *name) { SetString(name); }
+};
+
+/* Function: WriteAst
+ * ------------------
+ * Writes the tree held in an AstStore (see ast_store.h) to path as a
+ * .bast file. Returns false if the file cannot be written.
+ */
+class AstStore;
+bool WriteAst(const AstStore &store, const char *path);
+
+/* Class: AstPrinter
+ * -----------------
+ * Prints the tree as it is emitted, through one output buffer, in the
+ * given format. The text format is exactly what Node::Print produces,
+ * except that each expression the checker has typed shows the type in
+ * brackets after its kind. JSON fields that do not apply to a node are
+ * left out. A node is printed once its value is known, when the next
+ * node begins or it ends; Finish() ends the output.
+ */
+class DumpBuffer;
+
+class AstPrinter : public AstSink {
+    struct Pending {
+        int kind;
+        bool hasLocation;
+        int firstLine, firstColumn, lastLine, lastColumn;
+        const char *label, *type;
+        int valueKind;            // BastValueKind
+        int64_t intValue;
+        double floatValue;
+        const char *string;
+    };
+    DumpBuffer *out;
+    AstFormat format;
+    Pending node;
+    bool pending;                 // node is begun but not printed yet
+    vector<bool> hasChildren;     // for each node begun and not ended
+
+    void PrintPending();
+
+  public:
+    AstPrinter(AstFormat format);
+    ~AstPrinter();
+    void Begin(int kind, bool hasLocation, int firstLine, int firstColumn,
+               int lastLine, int lastColumn, const char *label, const char *type);
+    void BeginNode(const char *printName, yyltype *loc, const char *label, Type *type);
+    void EndNode();
+    void SetInt(int64_t value);
+    void SetFloat(double value);
+    void SetBool(bool value);
+    void SetString(const char *value);
+    void Finish();
+};
+
+#endif
@@ -0,0 +1,105 @@
+#!/usr/bin/env python
+#
+# File: bench/gencorpus.py
+#
+# Generates a deterministic corpus of large, machine-generated-looking
+# shaders for benchmarking glc and for training profile-guided builds.
+# Every shader only uses constructs the parser accepts and is free of
+# semantic errors, so a run exercises the scanner, parser and checker
+# end to end.
+#
+# Usage: gencorpus.py <output-dir> [scale]
+
+import os
+import random
+import sys
+
+TYPES = ["int", "float", "vec2", "vec3", "vec4"]
+SWIZZLE = {"vec2": "xy", "vec3": "xyz", "vec4": "xyzw"}
+
+
+def literal(rnd, t):
+    """Returns a constant expression of type t."""
+    if t == "int":
+        return str(rnd.randint(0, 1 << 20))
+    if t == "float":
+        return "%d.%df" % (rnd.randint(0, 999), rnd.randint(0, 9999))
+    return "v_%s" % t
+
+
+def expr(rnd, t, names, depth):
+    """Returns a random well-typed expression of type t over names."""
+    cands = [n for n, nt in names if nt == t]
+    if depth <= 0 or rnd.random() < 0.3:
+        if cands and rnd.random() < 0.7:
+            return rnd.choice(cands)
+        return literal(rnd, t)
+    op = rnd.choice("+-*")
+    return "(%s %s %s)" % (expr(rnd, t, names, depth - 1), op,
+                           expr(rnd, t, names, depth - 1))
+
+
+def function(rnd, idx, out, comments):
+    ret = rnd.choice(TYPES)
+    params = [("p%d" % i, rnd.choice(TYPES)) for i in range(rnd.randint(0, 3))]
+    names = list(params)
+    if comments:
+        out.append("/* generated helper %d\n * returns %s\n */" % (idx, ret))
+    out.append("%s fn_%d_%s(%s)" % (ret, idx, "x" * (idx % 7),
+               ", ".join("%s %s" % (t, n) for n, t in params)))
+    out.append("{")
+    out.append("  int i;")
+    names.append(("i", "int"))
+    for j in range(rnd.randint(2, 8)):
+        t = rnd.choice(TYPES)
+        name = "local_%d_%d" % (idx, j)
+        out.append("  %s %s = %s;" % (t, name, expr(rnd, t, names, 3)))
+        names.append((name, t))
+        if comments:
+            out.append("  // %s\t%s" % (name, "lorem ipsum " * 4))
+    kind = rnd.randint(0, 2)
+    cond = "i < %d" % rnd.randint(1, 64)
+    if kind == 0:
+        out.append("  for (i = 0; %s; i++) {" % cond)
+        out.append("    if (i == 3) { continue; } else { break; }")
+        out.append("  }")
+    elif kind == 1:
+        out.append("  i = 0;")
+        out.append("  while (%s) { i = i + 1; }" % cond)
+    else:
+        out.append("  if (%s) { i = 2; } else { i = 3; }" % cond)
+    vecs = [(n, t) for n, t in names if t in SWIZZLE]
+    if vecs:
+        n, t = rnd.choice(vecs)
+        out.append("  float s = %s.%s;" % (n, rnd.choice(SWIZZLE[t])))
+    out.append("  return %s;" % expr(rnd, ret, names, 2))
+    out.append("}")
+    out.append("")
+
+
+def shader(path, seed, nfuncs, comments):
+    rnd = random.Random(seed)
+    out = []
+    for t in ("vec2", "vec3", "vec4"):
+        out.append("uniform %s v_%s;" % (t, t))
+    for i in range(nfuncs):
+        function(rnd, i, out, comments)
+    with open(path, "w") as f:
+        f.write("\n".join(out) + "\n")
+
+
+def main():
+    if len(sys.argv) < 2:
+        sys.stderr.write("usage: %s <output-dir> [scale]\n" % sys.argv[0])
+        sys.exit(2)
+    outdir = sys.argv[1]
+    scale = int(sys.argv[2]) if len(sys.argv) > 2 else 1
+    if not os.path.isdir(outdir):
+        os.makedirs(outdir)
+    shader(os.path.join(outdir, "funcs.glsl"), 1, 500 * scale, False)
+    shader(os.path.join(outdir, "comments.glsl"), 2, 300 * scale, True)
+    shader(os.path.join(outdir, "mixed.glsl"), 3, 1000 * scale, scale > 1)
+
+
+if __name__ == "__main__":
+    main()
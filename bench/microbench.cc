@@ -0,0 +1,339 @@
+/* File: bench/microbench.cc
+ * -------------------------
+ * Micro-benchmarks for the core data structures used by the semantic
+ * analyzer: ScopedTable, SymbolTable, GlobalScope, List<T>, the Type
+ * predicates, whole-tree passes over the AST and the AstStore, and
+ * position lookups in an AstIndex.
+ * Each benchmark reports the average time per operation and the number
+ * of heap allocations per operation, so that a change to one of these
+ * structures can be measured in isolation rather than guessed at from
+ * whole-program runs.
+ *
+ * Build and run with "make microbench && ./microbench". An optional
+ * argument selects the benchmarks whose name contains that substring,
+ * e.g. "./microbench ScopedTable".
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <new>
+#include <chrono>
+#include <vector>
+#include "../list.h"
+#include "../symtable.h"
+#include "../ast_type.h"
+#include "../intern.h"
+#include "../ast_expr.h"
+#include "../ast_stmt.h"
+#include "../ast_store.h"
+#include "../ast_index.h"
+
+/* The benchmark binary links the analyzer objects but not the scanner,
+ * so we provide the scanner symbols that errors.cc refers to.
+ */
+struct yyltype yylloc;
+const char *SourceLine(int file, int n) { return NULL; }
+const char *SourceName(int file) { return NULL; }
+
+
+/* Allocation counting
+ * -------------------
+ * Every operator new in the process goes through here, which lets each
+ * benchmark report allocations/op without any external tooling.
+ */
+static unsigned long numAllocs = 0;
+
+void *operator new(size_t size) {
+    numAllocs++;
+    void *p = malloc(size ? size : 1);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+void *operator new[](size_t size) { return operator new(size); }
+void operator delete(void *p) noexcept { free(p); }
+void operator delete[](void *p) noexcept { free(p); }
+void operator delete(void *p, size_t) noexcept { free(p); }
+void operator delete[](void *p, size_t) noexcept { free(p); }
+
+// Keeps the optimizer from discarding a computed value
+template<class T> static inline void Keep(const T &value) {
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+static const char *filter = NULL;
+
+/* Function: Report
+ * ----------------
+ * Prints one result line: name, ns/op and allocations/op.
+ */
+static void Report(const char *name, long ops, double ns, unsigned long allocs) {
+    printf("%-44s %12ld ops %10.2f ns/op %8.3f allocs/op\n",
+           name, ops, ns / ops, (double)allocs / ops);
+}
+
+/* Macro: BENCH
+ * ------------
+ * Times the statement body run "ops" times, where setup code placed
+ * before the macro is excluded from the measurement.
+ */
+#define BENCH(name, ops, body)                                              \
+    do {                                                                    \
+        if (filter && !strstr(name, filter)) break;                         \
+        unsigned long allocs0 = numAllocs;                                  \
+        std::chrono::steady_clock::time_point t0 =                          \
+            std::chrono::steady_clock::now();                               \
+        for (long op = 0; op < (ops); op++) { body; }                       \
+        std::chrono::steady_clock::time_point t1 =                          \
+            std::chrono::steady_clock::now();                               \
+        double ns = std::chrono::duration<double, std::nano>(t1 - t0).count(); \
+        Report(name, ops, ns, numAllocs - allocs0);                         \
+    } while (0)
+
+
+/* Names are generated once, up front, so the string building does not
+ * show up in the measurements. They look like typical shader locals.
+ */
+static vector<char *> MakeNames(int count) {
+    vector<char *> names;
+    char buf[32];
+    for (int i = 0; i < count; i++) {
+        snprintf(buf, sizeof(buf), "var_%d", i);
+        names.push_back(strdup(buf));
+    }
+    return names;
+}
+
+static void BenchScopedTable(int size) {
+    vector<char *> names = MakeNames(size);
+    char label[64];
+    const long rounds = size <= 16 ? 200000 : 200;
+
+    snprintf(label, sizeof(label), "ScopedTable::insert (%d syms)", size);
+    BENCH(label, rounds * size, {
+        static ScopedTable *t = NULL;
+        if (op % size == 0) { delete t; t = new ScopedTable(); }
+        Symbol sym(names[op % size], NULL, E_VarDecl);
+        t->insert(sym);
+    });
+
+    ScopedTable table;
+    for (int i = 0; i < size; i++) {
+        Symbol sym(names[i], NULL, E_VarDecl);
+        table.insert(sym);
+    }
+    snprintf(label, sizeof(label), "ScopedTable::find hit (%d syms)", size);
+    BENCH(label, rounds * size, Keep(table.find(names[op % size])));
+
+    snprintf(label, sizeof(label), "ScopedTable::find miss (%d syms)", size);
+    BENCH(label, rounds * size, Keep(table.find("not_declared")));
+
+    snprintf(label, sizeof(label), "ScopedTable::remove+insert (%d syms)", size);
+    BENCH(label, rounds * size, {
+        Symbol sym(names[op % size], NULL, E_VarDecl);
+        table.remove(sym);
+        table.insert(sym);
+    });
+}
+
+static void BenchSymbolTable() {
+    vector<char *> names = MakeNames(8);
+    SymbolTable st;
+    st.push();
+
+    BENCH("SymbolTable::push/pop (empty scope)", 1000000, {
+        st.push();
+        st.pop();
+    });
+
+    BENCH("SymbolTable::push/insert x4/pop", 500000, {
+        st.push();
+        for (int i = 0; i < 4; i++) {
+            Symbol sym(names[i], NULL, E_VarDecl);
+            st.insert(sym);
+        }
+        st.pop();
+    });
+}
+
+/* Function: NestedFind
+ * --------------------
+ * The lookup loop used by VarExpr::Check and Call::Check: walk the
+ * scopes from innermost to outermost until the name is found.
+ */
+static Symbol *NestedFind(SymbolTable *st, const char *name) {
+    vector<ScopedTable *> *tables = st->GetTables();
+    for (int i = tables->size() - 1; i >= 0; i--) {
+        Symbol *sym = tables->at(i)->find(name);
+        if (sym) return sym;
+    }
+    return NULL;
+}
+
+static void BenchNestedLookup(int depth, int globals) {
+    vector<char *> names = MakeNames(globals + depth);
+    SymbolTable st;
+    st.push();
+    for (int i = 0; i < globals; i++) {
+        Symbol sym(names[i], NULL, E_FunctionDecl);
+        st.insert(sym);
+    }
+    for (int d = 0; d < depth; d++) {
+        st.push();
+        Symbol sym(names[globals + d], NULL, E_VarDecl);
+        st.insert(sym);
+    }
+
+    char label[64];
+    snprintf(label, sizeof(label), "nested find local (depth %d)", depth);
+    BENCH(label, 1000000, Keep(NestedFind(&st, names[globals + depth - 1])));
+    snprintf(label, sizeof(label), "nested find global (depth %d, %d globals)",
+             depth, globals);
+    BENCH(label, 1000000, Keep(NestedFind(&st, names[op % globals])));
+}
+
+// The frozen global scope the checker reads, against the map it replaced
+static void BenchGlobalScope(int globals) {
+    vector<char *> names = MakeNames(globals);
+    vector<const char *> interned;
+    GlobalScope global;
+    ScopedTable *table = new ScopedTable;    // owned by global once frozen
+    for (int i = 0; i < globals; i++) {
+        interned.push_back(Intern(names[i], strlen(names[i])));
+        Symbol sym(interned[i], NULL, E_FunctionDecl);
+        global.record(i, sym);
+        table->insert(sym);
+    }
+    global.freeze(table);
+    const char *missing = Intern("not_declared", 12);
+
+    char label[64];
+    snprintf(label, sizeof(label), "GlobalScope::find hit (%d syms)", globals);
+    BENCH(label, 2000000, Keep(global.find(interned[op % globals], globals)));
+    snprintf(label, sizeof(label), "GlobalScope::find miss (%d syms)", globals);
+    BENCH(label, 2000000, Keep(global.find(missing, globals)));
+    snprintf(label, sizeof(label), "  vs ScopedTable::find hit (%d syms)", globals);
+    BENCH(label, 2000000, Keep(table->find(interned[op % globals])));
+}
+
+static void BenchList() {
+    BENCH("List<int>::Append x3 (new list)", 500000, {
+        List<int> *l = new List<int>;
+        l->Append(1); l->Append(2); l->Append(3);
+        Keep(l->NumElements());
+        delete l;
+    });
+
+    BENCH("List<int>::InsertAt(0) x3 (new list)", 500000, {
+        List<int> *l = new List<int>;
+        l->InsertAt(1, 0); l->InsertAt(2, 0); l->InsertAt(3, 0);
+        Keep(l->NumElements());
+        delete l;
+    });
+
+    BENCH("List<int>::InsertAt(0) x1024 (new list)", 2000, {
+        List<int> *l = new List<int>;
+        for (int i = 0; i < 1024; i++) l->InsertAt(i, 0);
+        Keep(l->NumElements());
+        delete l;
+    });
+
+    List<int> big;
+    for (int i = 0; i < 1024; i++) big.Append(i);
+    BENCH("List<int>::Nth (1024 elems)", 5000000, Keep(big.Nth(op & 1023)));
+
+    List<int> small;
+    for (int i = 0; i < 3; i++) small.Append(i);
+    BENCH("List<int>::Nth (3 elems)", 5000000, Keep(small.Nth(op % 3)));
+}
+
+static void BenchTypes() {
+    Type *types[] = { Type::intType, Type::floatType, Type::boolType,
+                      Type::vec3Type, Type::mat4Type, Type::ivec2Type };
+    const int n = sizeof(types) / sizeof(types[0]);
+
+    BENCH("Type::IsNumeric", 5000000, Keep(types[op % n]->IsNumeric()));
+    BENCH("Type::IsVector", 5000000, Keep(types[op % n]->IsVector()));
+    BENCH("Type::IsMatrix", 5000000, Keep(types[op % n]->IsMatrix()));
+}
+
+// x = a + b * c, 14 nodes
+static Stmt *MakeAssignment(yyltype loc) {
+    Expr *product = new ArithmeticExpr(new VarExpr(loc, new Identifier(loc, Intern("b", 1))),
+                                       new Operator(loc, "*"),
+                                       new VarExpr(loc, new Identifier(loc, Intern("c", 1))));
+    Expr *sum = new ArithmeticExpr(new VarExpr(loc, new Identifier(loc, Intern("a", 1))),
+                                   new Operator(loc, "+"), product);
+    return new AssignExpr(new VarExpr(loc, new Identifier(loc, Intern("x", 1))),
+                          new Operator(loc, "="), sum);
+}
+
+// The same pass, counting operators, over the linked tree and over the
+// store built from it
+static void BenchTreePass(int statements) {
+    yyltype loc = { 1, 1, 1, 1 };
+    List<Stmt*> *stmts = new List<Stmt*>;
+    for (int i = 0; i < statements; i++) stmts->Append(MakeAssignment(loc));
+    StmtBlock *block = new StmtBlock(new List<VarDecl*>, stmts, loc);
+    AstStore store;
+    block->Emit(&store);
+    const char *opName = Operator(loc, "+").GetPrintNameForNode();
+
+    char label[64];
+    snprintf(label, sizeof(label), "TreeWalker pass (%u nodes)", store.NumNodes());
+    BENCH(label, 20, {
+        int ops = 0;
+        for (TreeWalker walk(block); walk.Next(); )
+            ops += walk.GetNode()->GetPrintNameForNode() == opName;
+        Keep(ops);
+    });
+    snprintf(label, sizeof(label), "  vs AstStore pass (%.0f bytes/node)",
+             (double)store.MemoryUsed() / store.NumNodes());
+    BENCH(label, 20, {
+        int ops = 0;
+        for (uint32_t i = 0; i < store.NumNodes(); i++)
+            ops += store.Kind(i) == B_Operator;
+        Keep(ops);
+    });
+    delete block;
+}
+
+// Finding the node at a position in a tree of statements one per line,
+// as an editor does on hover
+static void BenchIndex(int statements) {
+    List<Stmt*> *stmts = new List<Stmt*>;
+    for (int i = 0; i < statements; i++) {
+        yyltype loc = { 0, i + 1, 1, i + 1, 14 };
+        stmts->Append(MakeAssignment(loc));
+    }
+    yyltype braces = { 0, 1, 1, statements, 14 };
+    StmtBlock *block = new StmtBlock(new List<VarDecl*>, stmts, braces);
+
+    char label[64];
+    snprintf(label, sizeof(label), "AstIndex build (%d lines)", statements);
+    BENCH(label, 5, {
+        AstIndex index(block);
+        Keep(index.NumNodes());
+    });
+    AstIndex index(block);
+    snprintf(label, sizeof(label), "AstIndex::NodeAt (%d lines)", statements);
+    BENCH(label, 1000000, Keep(index.NodeAt(op % statements + 1, op % 16)));
+    delete block;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc > 1) filter = argv[1];
+
+    BenchScopedTable(8);
+    BenchScopedTable(4096);
+    BenchSymbolTable();
+    BenchNestedLookup(4, 64);
+    BenchNestedLookup(16, 2048);
+    BenchGlobalScope(64);
+    BenchGlobalScope(4096);
+    BenchList();
+    BenchTypes();
+    BenchTreePass(20000);
+    BenchIndex(10000);
+    return 0;
+}
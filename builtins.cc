@@ -0,0 +1,368 @@
+/* File: builtins.cc
+ * -----------------
+ * The built-in function table and its compile-time hash.
+ */
+
+#include <stdint.h>
+#include <string.h>
+#include "builtins.h"
+#include "ast_type.h"
+#include "symtable.h"
+
+/* Parameter and result types
+ * --------------------------
+ * A type is a kind and a size: 1 to 4 for a scalar or vector of that
+ * many components, or a matrix of that many columns. A size of GenSize
+ * stands for any of 1 to 4 and VecSize for any of 2 to 4, like the
+ * genType and vec of the GLSL specification, and every such size in one
+ * signature stands for the same number: dot takes two vectors of the
+ * same size.
+ */
+enum Kind : uint8_t { K_Void, K_Float, K_Int, K_Uint, K_Bool, K_Mat };
+
+static constexpr uint8_t GenSize = 0, VecSize = 5;
+
+struct Slot {
+    uint8_t kind;
+    uint8_t size;
+};
+
+static constexpr Slot Void = {K_Void, 1};
+static constexpr Slot Float = {K_Float, 1}, Int = {K_Int, 1}, Uint = {K_Uint, 1}, Bool = {K_Bool, 1};
+static constexpr Slot Vec2 = {K_Float, 2}, Vec3 = {K_Float, 3}, Vec4 = {K_Float, 4};
+static constexpr Slot genType = {K_Float, GenSize}, genIType = {K_Int, GenSize},
+                      genUType = {K_Uint, GenSize}, genBType = {K_Bool, GenSize};
+static constexpr Slot vec = {K_Float, VecSize}, ivec = {K_Int, VecSize},
+                      uvec = {K_Uint, VecSize}, bvec = {K_Bool, VecSize};
+static constexpr Slot mat = {K_Mat, VecSize};
+
+static constexpr int MaxParams = 4;
+
+struct Builtin {
+    const char *name;
+    Slot result;
+    int count;
+    Slot params[MaxParams];
+};
+
+/* Builtin table
+ * -------------
+ * One row per overload, and the overloads of a name in consecutive rows.
+ * Out parameters (modf, uaddCarry, ...) are matched like the others.
+ */
+static constexpr Builtin builtins[] = {
+    // Angle and trigonometry functions
+    {"radians", genType, 1, {genType}},
+    {"degrees", genType, 1, {genType}},
+    {"sin", genType, 1, {genType}},
+    {"cos", genType, 1, {genType}},
+    {"tan", genType, 1, {genType}},
+    {"asin", genType, 1, {genType}},
+    {"acos", genType, 1, {genType}},
+    {"atan", genType, 2, {genType, genType}},
+    {"atan", genType, 1, {genType}},
+    {"sinh", genType, 1, {genType}},
+    {"cosh", genType, 1, {genType}},
+    {"tanh", genType, 1, {genType}},
+    {"asinh", genType, 1, {genType}},
+    {"acosh", genType, 1, {genType}},
+    {"atanh", genType, 1, {genType}},
+
+    // Exponential functions
+    {"pow", genType, 2, {genType, genType}},
+    {"exp", genType, 1, {genType}},
+    {"log", genType, 1, {genType}},
+    {"exp2", genType, 1, {genType}},
+    {"log2", genType, 1, {genType}},
+    {"sqrt", genType, 1, {genType}},
+    {"inversesqrt", genType, 1, {genType}},
+
+    // Common functions
+    {"abs", genType, 1, {genType}},
+    {"abs", genIType, 1, {genIType}},
+    {"sign", genType, 1, {genType}},
+    {"sign", genIType, 1, {genIType}},
+    {"floor", genType, 1, {genType}},
+    {"trunc", genType, 1, {genType}},
+    {"round", genType, 1, {genType}},
+    {"roundEven", genType, 1, {genType}},
+    {"ceil", genType, 1, {genType}},
+    {"fract", genType, 1, {genType}},
+    {"mod", genType, 2, {genType, Float}},
+    {"mod", genType, 2, {genType, genType}},
+    {"modf", genType, 2, {genType, genType}},
+    {"min", genType, 2, {genType, genType}},
+    {"min", genType, 2, {genType, Float}},
+    {"min", genIType, 2, {genIType, genIType}},
+    {"min", genIType, 2, {genIType, Int}},
+    {"min", genUType, 2, {genUType, genUType}},
+    {"min", genUType, 2, {genUType, Uint}},
+    {"max", genType, 2, {genType, genType}},
+    {"max", genType, 2, {genType, Float}},
+    {"max", genIType, 2, {genIType, genIType}},
+    {"max", genIType, 2, {genIType, Int}},
+    {"max", genUType, 2, {genUType, genUType}},
+    {"max", genUType, 2, {genUType, Uint}},
+    {"clamp", genType, 3, {genType, genType, genType}},
+    {"clamp", genType, 3, {genType, Float, Float}},
+    {"clamp", genIType, 3, {genIType, genIType, genIType}},
+    {"clamp", genIType, 3, {genIType, Int, Int}},
+    {"clamp", genUType, 3, {genUType, genUType, genUType}},
+    {"clamp", genUType, 3, {genUType, Uint, Uint}},
+    {"mix", genType, 3, {genType, genType, genType}},
+    {"mix", genType, 3, {genType, genType, Float}},
+    {"mix", genType, 3, {genType, genType, genBType}},
+    {"step", genType, 2, {genType, genType}},
+    {"step", genType, 2, {Float, genType}},
+    {"smoothstep", genType, 3, {genType, genType, genType}},
+    {"smoothstep", genType, 3, {Float, Float, genType}},
+    {"isnan", genBType, 1, {genType}},
+    {"isinf", genBType, 1, {genType}},
+    {"floatBitsToInt", genIType, 1, {genType}},
+    {"floatBitsToUint", genUType, 1, {genType}},
+    {"intBitsToFloat", genType, 1, {genIType}},
+    {"uintBitsToFloat", genType, 1, {genUType}},
+    {"fma", genType, 3, {genType, genType, genType}},
+
+    // Floating-point pack and unpack functions
+    {"packSnorm2x16", Uint, 1, {Vec2}},
+    {"unpackSnorm2x16", Vec2, 1, {Uint}},
+    {"packUnorm2x16", Uint, 1, {Vec2}},
+    {"unpackUnorm2x16", Vec2, 1, {Uint}},
+    {"packHalf2x16", Uint, 1, {Vec2}},
+    {"unpackHalf2x16", Vec2, 1, {Uint}},
+    {"packSnorm4x8", Uint, 1, {Vec4}},
+    {"unpackSnorm4x8", Vec4, 1, {Uint}},
+    {"packUnorm4x8", Uint, 1, {Vec4}},
+    {"unpackUnorm4x8", Vec4, 1, {Uint}},
+
+    // Geometric functions
+    {"length", Float, 1, {genType}},
+    {"distance", Float, 2, {genType, genType}},
+    {"dot", Float, 2, {genType, genType}},
+    {"cross", Vec3, 2, {Vec3, Vec3}},
+    {"normalize", genType, 1, {genType}},
+    {"faceforward", genType, 3, {genType, genType, genType}},
+    {"reflect", genType, 2, {genType, genType}},
+    {"refract", genType, 3, {genType, genType, Float}},
+
+    // Matrix functions (every matrix type is square)
+    {"matrixCompMult", mat, 2, {mat, mat}},
+    {"outerProduct", mat, 2, {vec, vec}},
+    {"transpose", mat, 1, {mat}},
+    {"determinant", Float, 1, {mat}},
+    {"inverse", mat, 1, {mat}},
+
+    // Vector relational functions
+    {"lessThan", bvec, 2, {vec, vec}},
+    {"lessThan", bvec, 2, {ivec, ivec}},
+    {"lessThan", bvec, 2, {uvec, uvec}},
+    {"lessThanEqual", bvec, 2, {vec, vec}},
+    {"lessThanEqual", bvec, 2, {ivec, ivec}},
+    {"lessThanEqual", bvec, 2, {uvec, uvec}},
+    {"greaterThan", bvec, 2, {vec, vec}},
+    {"greaterThan", bvec, 2, {ivec, ivec}},
+    {"greaterThan", bvec, 2, {uvec, uvec}},
+    {"greaterThanEqual", bvec, 2, {vec, vec}},
+    {"greaterThanEqual", bvec, 2, {ivec, ivec}},
+    {"greaterThanEqual", bvec, 2, {uvec, uvec}},
+    {"equal", bvec, 2, {vec, vec}},
+    {"equal", bvec, 2, {ivec, ivec}},
+    {"equal", bvec, 2, {uvec, uvec}},
+    {"equal", bvec, 2, {bvec, bvec}},
+    {"notEqual", bvec, 2, {vec, vec}},
+    {"notEqual", bvec, 2, {ivec, ivec}},
+    {"notEqual", bvec, 2, {uvec, uvec}},
+    {"notEqual", bvec, 2, {bvec, bvec}},
+    {"any", Bool, 1, {bvec}},
+    {"all", Bool, 1, {bvec}},
+    {"not", bvec, 1, {bvec}},
+
+    // Integer functions
+    {"uaddCarry", genUType, 3, {genUType, genUType, genUType}},
+    {"usubBorrow", genUType, 3, {genUType, genUType, genUType}},
+    {"umulExtended", Void, 4, {genUType, genUType, genUType, genUType}},
+    {"imulExtended", Void, 4, {genIType, genIType, genIType, genIType}},
+    {"bitfieldExtract", genIType, 3, {genIType, Int, Int}},
+    {"bitfieldExtract", genUType, 3, {genUType, Int, Int}},
+    {"bitfieldInsert", genIType, 4, {genIType, genIType, Int, Int}},
+    {"bitfieldInsert", genUType, 4, {genUType, genUType, Int, Int}},
+    {"bitfieldReverse", genIType, 1, {genIType}},
+    {"bitfieldReverse", genUType, 1, {genUType}},
+    {"bitCount", genIType, 1, {genIType}},
+    {"bitCount", genIType, 1, {genUType}},
+    {"findLSB", genIType, 1, {genIType}},
+    {"findLSB", genIType, 1, {genUType}},
+    {"findMSB", genIType, 1, {genIType}},
+    {"findMSB", genIType, 1, {genUType}},
+
+    // Derivative functions
+    {"dFdx", genType, 1, {genType}},
+    {"dFdy", genType, 1, {genType}},
+    {"fwidth", genType, 1, {genType}},
+};
+
+static constexpr int NumBuiltins = sizeof(builtins) / sizeof(builtins[0]);
+static constexpr int TableSize = 256;    // power of two, > 2 * the number of names
+
+static constexpr bool SameName(const char *a, const char *b) {
+    while (*a && *a == *b) a++, b++;
+    return *a == *b;
+}
+
+// FNV-1a, as for the keywords
+static constexpr unsigned Hash(const char *s) {
+    unsigned h = 2166136261u;
+    for (; *s; s++)
+        h = (h ^ (unsigned char)*s) * 16777619u;
+    return (h ^ (h >> 15)) & (TableSize - 1);
+}
+
+struct HashTable {
+    short first[TableSize];    // the first row of a name, or -1
+    short end[TableSize];      // one past its last row
+};
+
+/* Function: BuildTable
+ * --------------------
+ * Runs at compile time: gives each name the first free slot from its
+ * hash on, so a lookup probes from there to an empty slot.
+ */
+static constexpr HashTable BuildTable() {
+    HashTable table = {{}, {}};
+    for (int i = 0; i < TableSize; i++) table.first[i] = table.end[i] = -1;
+    for (int i = 0; i < NumBuiltins; ) {
+        int end = i + 1;
+        while (end < NumBuiltins && SameName(builtins[end].name, builtins[i].name)) end++;
+        unsigned h = Hash(builtins[i].name);
+        while (table.first[h] != -1) h = (h + 1) & (TableSize - 1);
+        table.first[h] = i;
+        table.end[h] = end;
+        i = end;
+    }
+    return table;
+}
+
+static constexpr HashTable table = BuildTable();
+
+// Every name's rows are consecutive, and every row fits its slots
+static constexpr bool TableIsWellFormed() {
+    for (int i = 0; i < NumBuiltins; i++) {
+        if (builtins[i].count < 1 || builtins[i].count > MaxParams) return false;
+        for (int j = i + 2; j < NumBuiltins; j++)
+            if (SameName(builtins[i].name, builtins[j].name)
+                && !SameName(builtins[i].name, builtins[j - 1].name))
+                return false;
+    }
+    return true;
+}
+static_assert(TableIsWellFormed(), "builtin table rows are out of order or malformed");
+
+
+// The kind and size of each type a built-in takes or returns
+static const struct { Type **type; Slot slot; } types[] = {
+    {&Type::voidType, {K_Void, 1}},
+    {&Type::floatType, {K_Float, 1}}, {&Type::vec2Type, {K_Float, 2}},
+    {&Type::vec3Type, {K_Float, 3}}, {&Type::vec4Type, {K_Float, 4}},
+    {&Type::intType, {K_Int, 1}}, {&Type::ivec2Type, {K_Int, 2}},
+    {&Type::ivec3Type, {K_Int, 3}}, {&Type::ivec4Type, {K_Int, 4}},
+    {&Type::uintType, {K_Uint, 1}}, {&Type::uvec2Type, {K_Uint, 2}},
+    {&Type::uvec3Type, {K_Uint, 3}}, {&Type::uvec4Type, {K_Uint, 4}},
+    {&Type::boolType, {K_Bool, 1}}, {&Type::bvec2Type, {K_Bool, 2}},
+    {&Type::bvec3Type, {K_Bool, 3}}, {&Type::bvec4Type, {K_Bool, 4}},
+    {&Type::mat2Type, {K_Mat, 2}}, {&Type::mat3Type, {K_Mat, 3}},
+    {&Type::mat4Type, {K_Mat, 4}},
+};
+
+static bool SlotOf(Type *type, Slot *slot) {
+    for (const auto &t : types)
+        if (*t.type == type) {
+            *slot = t.slot;
+            return true;
+        }
+    return false;
+}
+
+static Type *TypeOf(Slot slot) {
+    for (const auto &t : types)
+        if (t.slot.kind == slot.kind && t.slot.size == slot.size) return *t.type;
+    return NULL;
+}
+
+static bool IsGeneric(Slot s) { return s.size == GenSize || s.size == VecSize; }
+
+// The type a slot stands for once its generic size is n
+static Type *Instance(Slot slot, uint8_t n) {
+    if (slot.size == VecSize && n == 1) return NULL;
+    if (IsGeneric(slot)) slot.size = n;
+    return TypeOf(slot);
+}
+
+// The result type of b with its generic sizes bound by args, whose
+// parameter types are appended to params, or NULL if args cannot bind them
+static Type *Instantiate(const Builtin &b, const vector<Type *> &args, vector<Type *> &params) {
+    if ((int)args.size() != b.count) return NULL;
+    uint8_t n = 0;    // the size every generic slot stands for, once known
+    for (int i = 0; i < b.count; i++) {
+        Slot given;
+        if (!SlotOf(args[i], &given)) return NULL;
+        if (!IsGeneric(b.params[i])) continue;
+        if (n && given.size != n) return NULL;
+        n = given.size;
+    }
+    for (int i = 0; i < b.count; i++) {
+        Type *param = Instance(b.params[i], n);
+        if (param == NULL) return NULL;
+        params.push_back(param);
+    }
+    return Instance(b.result, n);
+}
+
+// The slot of name's rows, or -1
+static int Find(const char *name) {
+    for (unsigned h = Hash(name); table.first[h] != -1; h = (h + 1) & (TableSize - 1))
+        if (strcmp(builtins[table.first[h]].name, name) == 0) return h;
+    return -1;
+}
+
+bool IsBuiltinFunction(const char *name, int *fewest, int *most) {
+    int h = Find(name);
+    if (h < 0) return false;
+    *fewest = MaxParams;
+    *most = 0;
+    for (int i = table.first[h]; i < table.end[h]; i++) {
+        if (builtins[i].count < *fewest) *fewest = builtins[i].count;
+        if (builtins[i].count > *most) *most = builtins[i].count;
+    }
+    return true;
+}
+
+/* Function: BuiltinResult
+ * -----------------------
+ * Each overload is bound to the sizes of the arguments, and the best of
+ * those that take them is picked as for declared functions. Two rows can
+ * come to the same parameters (max of two floats, for one), which are
+ * one function.
+ */
+Type *BuiltinResult(const char *name, const vector<Type *> &args, bool *ambiguous) {
+    *ambiguous = false;
+    int h = Find(name);
+    if (h < 0) return NULL;
+    vector< vector<Type *> > params(table.end[h] - table.first[h]);
+    vector<const vector<Type *> *> candidates;
+    vector<Type *> results;
+    for (int i = table.first[h]; i < table.end[h]; i++) {
+        vector<Type *> &p = params[i - table.first[h]];
+        Type *result = Instantiate(builtins[i], args, p);
+        if (result == NULL) continue;
+        bool seen = false;
+        for (const vector<Type *> *c : candidates)
+            seen = seen || *c == p;
+        if (seen) continue;
+        candidates.push_back(&p);
+        results.push_back(result);
+    }
+    int best = PickOverload(args, candidates);
+    *ambiguous = best == -2;
+    return best >= 0 ? results[best] : NULL;
+}
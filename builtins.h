@@ -0,0 +1,43 @@
+/* File: builtins.h
+ * ----------------
+ * The built-in functions of GLSL: the trigonometric, exponential and
+ * common functions, the geometric and matrix functions, the vector
+ * relational functions, derivatives, and the integer and packing
+ * functions. Their signatures are rows of a table in builtins.cc, and
+ * the table and the hash that finds a name's rows are built at compile
+ * time, as the keyword table is (keywords.h): nothing is declared at
+ * startup, and a program that calls none of them pays nothing.
+ *
+ * Call::Check consults the table only after a name's lookup in scope
+ * fails, so a declaration of the same name hides the built-in, and a
+ * call to one creates no declaration or symbol. A call resolves among
+ * the overloads as one to a declared function does (see OverloadSet in
+ * symtable.h), with the same implicit conversions.
+ * Texture lookups are not here, since there are no sampler types.
+ */
+
+#ifndef _H_builtins
+#define _H_builtins
+
+#include <vector>
+
+using namespace std;
+
+class Type;
+
+/* Function: IsBuiltinFunction
+ * ---------------------------
+ * Returns whether name is a built-in function, and if so sets *fewest
+ * and *most to the fewest and most arguments its overloads take.
+ */
+bool IsBuiltinFunction(const char *name, int *fewest, int *most);
+
+/* Function: BuiltinResult
+ * -----------------------
+ * Returns the type returned by the overload of the built-in function
+ * name that a call with arguments of types args resolves to, or NULL if
+ * none takes them or, setting *ambiguous, no one of them is the best.
+ */
+Type *BuiltinResult(const char *name, const vector<Type *> &args, bool *ambiguous);
+
+#endif
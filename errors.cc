@@ -8,16 +8,55 @@
 #include <sstream>
 #include <stdarg.h>
 #include <stdio.h>
+#include <string.h>
 
 using namespace std;
 
-#include "scanner.h" // for GetLineNumbered
+#include "scanner.h" // for SourceLine
 #include "ast_type.h"
 #include "ast_expr.h"
 #include "ast_stmt.h"
 #include "ast_decl.h"
 
 int ReportError::numErrors = 0;
+static thread_local ReportError::Deferral deferral;
+
+void ReportError::DeferOnThisThread(Deferral hook) {
+    deferral = hook;
+}
+
+static thread_local vector<Diagnostic> *collected;
+
+static void Collect(yyltype *loc, const string &msg) {
+    Diagnostic d;
+    d.hasLoc = (loc != NULL);
+    if (loc) d.loc = *loc;
+    d.msg = msg;
+    d.echo = -1;
+    collected->push_back(d);
+}
+
+void ReportError::CollectOnThisThread(vector<Diagnostic> *found) {
+    collected = found;
+    deferral = found ? Collect : NULL;
+}
+
+void ReportError::Replay(const Diagnostic &d) {
+    if (d.echo >= 0) putchar(d.echo);
+    else OutputError(d.hasLoc ? (yyltype *)&d.loc : NULL, d.msg);
+}
+
+void ReportError::Echo(char c) {
+    if (!collected) {
+        putchar(c);
+        return;
+    }
+    Diagnostic d;
+    d.hasLoc = false;
+    d.loc = yyltype();
+    d.echo = (unsigned char)c;
+    collected->push_back(d);
+}
 
 void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
     if (!line) return;
@@ -30,11 +69,18 @@ void ReportError::UnderlineErrorInLine(const char *line, yyltype *pos) {
  
  
 void ReportError::OutputError(yyltype *loc, string msg) {
+    if (deferral) {
+        deferral(loc, msg);
+        return;
+    }
     numErrors++;
     fflush(stdout); // make sure any buffered text has been output
     if (loc) {
-        cerr << endl << "*** Error line " << loc->first_line << "." << endl;
-        UnderlineErrorInLine(GetLineNumbered(loc->first_line), loc);
+        cerr << endl << "*** Error line " << loc->first_line;
+        if (const char *file = SourceName(loc->file))
+            cerr << " of " << file;
+        cerr << "." << endl;
+        UnderlineErrorInLine(SourceLine(loc->file, loc->first_line), loc);
     } else
         cerr << endl << "*** Error." << endl;
     cerr << "*** " << msg << endl << endl;
@@ -74,6 +120,16 @@ void ReportError::UnrecogChar(yyltype *loc, char ch) {
     OutputError(loc, s.str());
 }
 
+void ReportError::ConstantOutOfRange(yyltype *loc, const char *literal) {
+    ostringstream s;
+    s << "Constant out of range: \"" << literal << "\"";
+    OutputError(loc, s.str());
+}
+
+void ReportError::NestingTooDeep(yyltype *loc) {
+    OutputError(loc, "Nested too deeply (see --max-depth)");
+}
+
 void ReportError::DeclConflict(Decl *decl, Decl *prevDecl) {
     ostringstream s;
     s << "Declaration of '" << decl << "' here conflicts with declaration on line " 
@@ -118,6 +174,24 @@ void ReportError::FormalsTypeMismatch(Identifier *id, int pos, Type *expType, Ty
     OutputError(id->GetLocation(), s.str());
 }
 
+void ReportError::NoMatchingOverload(Identifier *id, const vector<Type*> &actualTypes) {
+    ostringstream s;
+    s << "No overload of function '" << id << "' takes (";
+    for (size_t i = 0; i < actualTypes.size(); i++)
+        s << (i ? ", " : "") << actualTypes[i];
+    s << ")";
+    OutputError(id->GetLocation(), s.str());
+}
+
+void ReportError::AmbiguousCall(Identifier *id, const vector<Type*> &actualTypes) {
+    ostringstream s;
+    s << "Call to function '" << id << "' with (";
+    for (size_t i = 0; i < actualTypes.size(); i++)
+        s << (i ? ", " : "") << actualTypes[i];
+    s << ") is ambiguous";
+    OutputError(id->GetLocation(), s.str());
+}
+
 void ReportError::NotAFunction(Identifier *id) {
     ostringstream s;
     s << "'" << id << "' is not a function.";
@@ -180,6 +254,22 @@ void ReportError::OversizedVector(Identifier *field, Expr *base) {
     OutputError(field->GetLocation(), s.str());
 }
 
+void ReportError::InvalidArraySize(Identifier *id, int size) {
+    ostringstream s;
+    s << "Array '" << id << "' has size " << size << ", which is not positive";
+    OutputError(id->GetLocation(), s.str());
+}
+
+void ReportError::CaseNotConstant(Expr *label) {
+    OutputError(label->GetLocation(), "Case label must be a constant integer expression");
+}
+
+void ReportError::DuplicateCase(Expr *label, int value) {
+    ostringstream s;
+    s << "Duplicate case label " << value;
+    OutputError(label->GetLocation(), s.str());
+}
+
 void ReportError::TestNotBoolean(Expr *expr) {
     OutputError(expr->GetLocation(), "Test expression must have boolean type");
 }
@@ -204,5 +294,9 @@ void ReportError::ContinueOutsideLoop(ContinueStmt *cStmt) {
  */
 
 void yyerror(const char *msg) {
-    ReportError::Formatted(&yylloc, "%s", msg);
+    // The parser's stacks only run out when constructs nest too deeply
+    if (!strcmp(msg, "memory exhausted"))
+        ReportError::NestingTooDeep(&yylloc);
+    else
+        ReportError::Formatted(&yylloc, "%s", msg);
 }
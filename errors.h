@@ -14,6 +14,7 @@
 #define _errors_h_
 
 #include <string>
+#include <vector>
 #include "location.h"
 #include "ast_decl.h"
 
@@ -50,6 +51,15 @@ class ReturnStmt;
 class Decl;
 class Operator;
 
+// An error captured instead of printed (see ReportError::CollectOnThisThread),
+// or a character the scanner echoed (see ReportError::Echo)
+struct Diagnostic {
+    bool hasLoc;
+    yyltype loc;
+    string msg;
+    int echo;      // the character echoed, or -1 for an error
+};
+
 typedef enum {
       LookingForType,
       LookingForVariable,
@@ -64,6 +74,8 @@ class ReportError {
   static void LongIdentifier(yyltype *loc, const char *ident);
   static void UntermString(yyltype *loc, const char *str);
   static void UnrecogChar(yyltype *loc, char ch);
+  static void ConstantOutOfRange(yyltype *loc, const char *literal);
+  static void NestingTooDeep(yyltype *loc);
 
   // Errors used by semantic analyzer for declarations
   static void DeclConflict(Decl *newDecl, Decl *prevDecl);
@@ -75,6 +87,7 @@ class ReportError {
 
   // Errors used by semantic analyzer for arrays
   static void NotAnArray(Identifier *id);
+  static void InvalidArraySize(Identifier *id, int size);
               
   // Errors used by semantic analyzer for expressions
   static void IncompatibleOperand(Operator *op, Type *rhs); // unary
@@ -85,6 +98,8 @@ class ReportError {
   static void LessFormals(Identifier *id, int expCount, int actualCount); 
   static void FormalsTypeMismatch(Identifier *id, int pos, Type *expType, Type *actualType); 
   static void NotAFunction(Identifier *id); 
+  static void NoMatchingOverload(Identifier *id, const vector<Type*> &actualTypes);
+  static void AmbiguousCall(Identifier *id, const vector<Type*> &actualTypes);
   
   // Errors used by semantic analyzer for vector access
   static void InaccessibleSwizzle(Identifier *swizzle, Expr *base);
@@ -98,6 +113,8 @@ class ReportError {
   static void ReturnMissing(FnDecl *fnDecl);
   static void BreakOutsideLoop(BreakStmt *bStmt); 
   static void ContinueOutsideLoop(ContinueStmt *cStmt); 
+  static void CaseNotConstant(Expr *label);
+  static void DuplicateCase(Expr *label, int value);
 
   // Generic method to report a printf-style error message
   static void Formatted(yyltype *loc, const char *format, ...);
@@ -105,6 +122,26 @@ class ReportError {
 
   // Returns number of error messages printed
   static int NumErrors() { return numErrors; }
+  // Starts counting again, for the next file of a --batch run
+  static void ResetNumErrors() { numErrors = 0; }
+
+  // A thread scanning ahead of the parser (see --pipeline in fastscan.cc)
+  // installs a hook with DeferOnThisThread(). Errors reported on that
+  // thread are handed to the hook instead of printed, and the parser
+  // thread prints them with Replay() when it reaches that point.
+  typedef void (*Deferral)(yyltype *loc, const string &msg);
+  static void DeferOnThisThread(Deferral hook);
+  static void Replay(yyltype *loc, const string &msg) { OutputError(loc, msg); }
+
+  // Collects the errors reported on this thread into found (a hook
+  // like the one above), or prints them again if found is NULL. The
+  // characters the scanner echoes are collected with them, in order.
+  static void CollectOnThisThread(vector<Diagnostic> *found);
+  static void Replay(const Diagnostic &d);
+
+  // Prints a character that no scanner rule matched, as flex's default
+  // rule does
+  static void Echo(char c);
   
  private:
   static void UnderlineErrorInLine(const char *line, yyltype *pos);
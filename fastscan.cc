@@ -0,0 +1,942 @@
+/* File: fastscan.cc
+ * -----------------
+ * A hand-written scanner that produces exactly the same tokens, yylval
+ * and yylloc values as the flex scanner generated from scanner.l, and
+ * the yylex() entry point that selects between the two.
+ *
+ * Flex's table-driven DFA consumes one byte per transition and runs
+ * DoBeforeEachAction on every match, including each character inside a
+ * comment. This scanner reads the whole input into memory and uses
+ * SSE2/AVX2 to skip runs of spaces, find the end of comment text and
+ * measure identifier runs 16 or 32 bytes at a time. The vector width is
+ * chosen at run time from the CPU features, with a scalar fallback.
+ *
+ * The scanner is selected with --scanner=flex|simd|scalar ("scalar"
+ * runs the hand-written scanner without vector instructions). A build
+ * without flex (make SCANNER=simd) always uses the hand-written one.
+ * The "tokens" debug key prints every token, which lets the two
+ * scanners be compared token for token.
+ *
+ * Normally the whole of standard input is read on the first call.
+ * Alternatively the caller hands input over in chunks with FeedInput()
+ * (this is how the push parser is driven); tokens are then only scanned
+ * up to the last complete line received, since no token spans a
+ * newline, and yylex() returns MoreInputNeeded when it gets there.
+ *
+ * With --pipeline[=records] the hand-written scanner runs on a thread of
+ * its own, a stage ahead of the parser. It writes each token, with its
+ * value and location, into a bounded ring (ring.h) that yylex() drains
+ * on the parser thread. Anything the scanner would have printed (errors,
+ * echoed characters) travels in the ring with the next token and is
+ * printed when the parser gets to it, so the output is unchanged.
+ *
+ * With --preprocess, a '#' that begins a line (after any blanks) starts
+ * a directive, which ScanDirective() hands over whole, and yylex()
+ * returns the tokens of the preprocessor (preprocess.h) instead of the
+ * scanner's own. The preprocessor also has whole files and macro bodies
+ * scanned at once with ScanWhole().
+ *
+ * Every rule of scanner.l is mirrored below, including its quirks
+ * (where yylloc points after a newline, how tabs advance the column,
+ * which characters the FIELDS state echoes), because error messages
+ * and parser actions read yylloc directly.
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <vector>
+#include <string>
+#include <mutex>
+#include <thread>
+#include "scanner.h"
+#include "utility.h" // for PrintDebug()
+#include "errors.h"
+#include "parser.h" // for token codes, yylval
+#include "keywords.h"
+#include "intern.h"
+#include "literals.h"
+#include "ring.h"
+#include "preprocess.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define HAVE_X86_SIMD 1
+#endif
+
+using namespace std;
+
+#define TAB_SIZE 8
+#define MaxLongIdentLen 1023   // scanner.l reports identifiers longer than this
+
+/* Scanner states, matching the start conditions in scanner.l. The COPY
+ * state is only ever pushed on top of one of the others, so it is kept
+ * as a flag rather than on a general state stack.
+ */
+enum ScanState { S_Normal, S_Comment, S_Fields };
+
+static const char *input, *inputEnd, *cur;
+static const char *scanLimit;   // end of the last complete line
+static bool inputComplete;      // no more input will arrive
+static char *buffer;            // input handed over by FeedInput
+static size_t bufferSize;
+static ScanState state;
+static bool copyPending;
+static int curLineNum, curColNum;
+static vector<const char*> savedLines;
+static bool saveLines = true;   // false once ScanText() is used
+static LineSource *sourceLines;  // see UseSourceLines
+static bool useFlex;
+static bool preprocessing;      // --preprocess
+static bool directives;         // '#' starts a directive, see ScanDirective
+static string inputName;        // named in errors, see ScanInput
+
+// Where the hand-written scanner leaves each token's value and location:
+// yylval and yylloc, unless it is running on the pipeline thread
+static YYSTYPE *lval = &yylval;
+static yyltype *lloc = &yylloc;
+
+/* Pipeline state. An Event is output the scanner produced while
+ * matching a token (an error or an echoed character); the events are
+ * chained to the token's Record and replayed in order by the parser.
+ */
+struct Event {
+    Event *next;
+    int echo;            // character echoed, or -1 for an error
+    bool hasLoc;
+    yyltype loc;
+    string msg;
+};
+
+struct Record {
+    int token;
+    YYSTYPE value;
+    yyltype loc;
+    Event *events;
+};
+
+static bool pipelined;
+static Ring<Record> *tokenRing;
+static thread scanThread;      // runs ScanAhead while pipelined
+static Event *eventsHead, **eventsTail = &eventsHead;  // scanner thread only
+static mutex savedLinesLock;   // savedLines is shared once pipelined
+
+
+/* Character-run kernels
+ * ---------------------
+ * Each returns the number of bytes from p (not past end) before the
+ * first byte that stops the run. They are selected once in InitScanner.
+ */
+typedef size_t (*RunFn)(const char *p, const char *end);
+
+// Plain ASCII tests; the <ctype.h> ones depend on the locale
+static inline bool IsAlpha(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z');
+}
+
+static inline bool IsDigit(char c) {
+    return c >= '0' && c <= '9';
+}
+
+static inline bool IsHexDigit(char c) {
+    return IsDigit(c) || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F');
+}
+
+static inline bool IsIdentChar(char c) {
+    return IsAlpha(c) || IsDigit(c) || c == '_';
+}
+
+// Inside a comment only newline, tab and '*' need a closer look
+static inline bool IsCommentStop(char c) {
+    return c == '\n' || c == '\t' || c == '*';
+}
+
+static size_t ScalarSpaceRun(const char *p, const char *end) {
+    const char *s = p;
+    while (s < end && *s == ' ') s++;
+    return s - p;
+}
+
+static size_t ScalarIdentRun(const char *p, const char *end) {
+    const char *s = p;
+    while (s < end && IsIdentChar(*s)) s++;
+    return s - p;
+}
+
+static size_t ScalarCommentRun(const char *p, const char *end) {
+    const char *s = p;
+    while (s < end && !IsCommentStop(*s)) s++;
+    return s - p;
+}
+
+#ifdef HAVE_X86_SIMD
+
+/* The SSE2 kernels build a 16-bit mask of the bytes that stop the run;
+ * the index of its lowest set bit is the run length within the block.
+ */
+static inline unsigned IdentStopMask16(__m128i v) {
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i alpha = _mm_and_si128(_mm_cmpgt_epi8(lower, _mm_set1_epi8('a' - 1)),
+                                  _mm_cmplt_epi8(lower, _mm_set1_epi8('z' + 1)));
+    __m128i digit = _mm_and_si128(_mm_cmpgt_epi8(v, _mm_set1_epi8('0' - 1)),
+                                  _mm_cmplt_epi8(v, _mm_set1_epi8('9' + 1)));
+    __m128i under = _mm_cmpeq_epi8(v, _mm_set1_epi8('_'));
+    __m128i ok = _mm_or_si128(_mm_or_si128(alpha, digit), under);
+    return ~_mm_movemask_epi8(ok) & 0xFFFF;
+}
+
+static size_t Sse2SpaceRun(const char *p, const char *end) {
+    const char *s = p;
+    for (; end - s >= 16; s += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)s);
+        unsigned stop = ~_mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8(' '))) & 0xFFFF;
+        if (stop) return s - p + __builtin_ctz(stop);
+    }
+    return s - p + ScalarSpaceRun(s, end);
+}
+
+static size_t Sse2IdentRun(const char *p, const char *end) {
+    const char *s = p;
+    for (; end - s >= 16; s += 16) {
+        unsigned stop = IdentStopMask16(_mm_loadu_si128((const __m128i *)s));
+        if (stop) return s - p + __builtin_ctz(stop);
+    }
+    return s - p + ScalarIdentRun(s, end);
+}
+
+static size_t Sse2CommentRun(const char *p, const char *end) {
+    const char *s = p;
+    for (; end - s >= 16; s += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)s);
+        __m128i hit = _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')),
+                                                _mm_cmpeq_epi8(v, _mm_set1_epi8('\t'))),
+                                   _mm_cmpeq_epi8(v, _mm_set1_epi8('*')));
+        unsigned stop = _mm_movemask_epi8(hit);
+        if (stop) return s - p + __builtin_ctz(stop);
+    }
+    return s - p + ScalarCommentRun(s, end);
+}
+
+#define AVX2 __attribute__((target("avx2")))
+
+AVX2 static size_t Avx2SpaceRun(const char *p, const char *end) {
+    const char *s = p;
+    for (; end - s >= 32; s += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)s);
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')));
+        if (stop) return s - p + __builtin_ctz(stop);
+    }
+    return s - p + Sse2SpaceRun(s, end);
+}
+
+AVX2 static size_t Avx2IdentRun(const char *p, const char *end) {
+    const char *s = p;
+    for (; end - s >= 32; s += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)s);
+        __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+        __m256i alpha = _mm256_and_si256(_mm256_cmpgt_epi8(lower, _mm256_set1_epi8('a' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('z' + 1), lower));
+        __m256i digit = _mm256_and_si256(_mm256_cmpgt_epi8(v, _mm256_set1_epi8('0' - 1)),
+                                         _mm256_cmpgt_epi8(_mm256_set1_epi8('9' + 1), v));
+        __m256i under = _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_'));
+        __m256i ok = _mm256_or_si256(_mm256_or_si256(alpha, digit), under);
+        unsigned stop = ~(unsigned)_mm256_movemask_epi8(ok);
+        if (stop) return s - p + __builtin_ctz(stop);
+    }
+    return s - p + Sse2IdentRun(s, end);
+}
+
+AVX2 static size_t Avx2CommentRun(const char *p, const char *end) {
+    const char *s = p;
+    for (; end - s >= 32; s += 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)s);
+        __m256i hit = _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')),
+                                                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('\t'))),
+                                      _mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')));
+        unsigned stop = _mm256_movemask_epi8(hit);
+        if (stop) return s - p + __builtin_ctz(stop);
+    }
+    return s - p + Sse2CommentRun(s, end);
+}
+
+#endif
+
+static RunFn SpaceRun = ScalarSpaceRun;
+static RunFn IdentRun = ScalarIdentRun;
+static RunFn CommentRun = ScalarCommentRun;
+
+/* Function: SelectKernels
+ * -----------------------
+ * Picks the widest kernels the CPU supports, unless the scalar ones
+ * were requested.
+ */
+static void SelectKernels(bool scalarOnly) {
+    SpaceRun = ScalarSpaceRun;
+    IdentRun = ScalarIdentRun;
+    CommentRun = ScalarCommentRun;
+    if (scalarOnly) return;
+#ifdef HAVE_X86_SIMD
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        SpaceRun = Avx2SpaceRun;
+        IdentRun = Avx2IdentRun;
+        CommentRun = Avx2CommentRun;
+        PrintDebug("lex", "Using AVX2 scanner kernels");
+    } else {
+        SpaceRun = Sse2SpaceRun;
+        IdentRun = Sse2IdentRun;
+        CommentRun = Sse2CommentRun;
+        PrintDebug("lex", "Using SSE2 scanner kernels");
+    }
+#endif
+}
+
+
+/* Function: ReadAllInput
+ * ----------------------
+ * Reads standard input into one buffer. Scanning from memory is what
+ * lets the kernels above look ahead a whole vector at a time.
+ */
+static void ReadAllInput() {
+    size_t cap = 1 << 16, len = 0, n;
+    char *buf = (char *)malloc(cap);
+    if (!buf) Failure("Out of memory reading input");
+    while ((n = fread(buf + len, 1, cap - len, stdin)) > 0) {
+        len += n;
+        if (len < cap) continue;
+        char *grown = (char *)realloc(buf, cap * 2);
+        if (!grown) Failure("Out of memory reading input");
+        buf = grown;
+        cap *= 2;
+    }
+    input = cur = buf;
+    scanLimit = inputEnd = buf + len;
+    inputComplete = true;
+}
+
+/* Function: FeedInput
+ * -------------------
+ * Appends a chunk of input. Text already scanned is discarded first:
+ * lexemes are copied out (interned, or saved as lines) as they are
+ * matched, so nothing points into it.
+ */
+void FeedInput(const char *chunk, size_t len) {
+    size_t left = input ? inputEnd - cur : 0;
+    if (left + len > bufferSize) {
+        size_t size = bufferSize ? bufferSize : 1 << 16;
+        while (size < left + len) size *= 2;
+        char *grown = (char *)malloc(size);
+        if (!grown) Failure("Out of memory reading input");
+        if (left) memcpy(grown, cur, left);
+        free(buffer);
+        buffer = grown;
+        bufferSize = size;
+    } else if (left) {
+        memmove(buffer, cur, left);
+    }
+    memcpy(buffer + left, chunk, len);
+    input = cur = buffer;
+    inputEnd = buffer + left + len;
+    const char *nl = (const char *)memrchr(cur, '\n', inputEnd - cur);
+    scanLimit = nl ? nl + 1 : cur;
+}
+
+void FinishInput() {
+    if (!input) FeedInput("", 0);
+    scanLimit = inputEnd;
+    inputComplete = true;
+}
+
+// Queues output for the parser thread to replay with the next token
+static void AddEvent(Event *e) {
+    e->next = NULL;
+    *eventsTail = e;
+    eventsTail = &e->next;
+}
+
+// The ReportError hook installed on the pipeline thread
+static void DeferError(yyltype *loc, const string &msg) {
+    Event *e = new Event;
+    e->echo = -1;
+    e->hasLoc = (loc != NULL);
+    if (loc) e->loc = *loc;
+    e->msg = msg;
+    AddEvent(e);
+}
+
+// flex's ECHO, the default action for unmatched characters
+static void Echo(char c) {
+    if (!pipelined) {
+        ReportError::Echo(c);
+        return;
+    }
+    Event *e = new Event;
+    e->echo = (unsigned char)c;
+    AddEvent(e);
+}
+
+static void SaveLine(const char *line) {
+    if (!pipelined) {
+        savedLines.push_back(line);
+        return;
+    }
+    lock_guard<mutex> guard(savedLinesLock);
+    savedLines.push_back(line);
+}
+
+/* Function: Match
+ * ---------------
+ * The equivalent of DoBeforeEachAction in scanner.l: records the
+ * location of a len-byte lexeme and updates the column counter.
+ */
+static inline void Match(size_t len) {
+    lloc->first_line = curLineNum;
+    lloc->first_column = curColNum;
+    lloc->last_line = curLineNum;
+    lloc->last_column = curColNum + len - 1;
+    curColNum += len;
+    cur += len;
+}
+
+// The <*>\n rule: the following line is copied first
+static inline void MatchNewline() {
+    Match(1);
+    curLineNum++;
+    curColNum = 1;
+    if (copyPending) SaveLine("");
+    else copyPending = saveLines;
+}
+
+// The <*>[\t] rule
+static inline void MatchTab() {
+    Match(1);
+    curColNum += TAB_SIZE - curColNum%TAB_SIZE + 1;
+}
+
+// Passes a lexeme to the parser as an interned name
+static inline void SetIdentifier(const char *s, size_t len) {
+    lval->identifier = Intern(s, len);
+}
+
+static void CheckLongIdentifier(const char *s, size_t len) {
+    if (len > MaxLongIdentLen) {
+        char *text = strndup(s, len);
+        ReportError::LongIdentifier(lloc, text);
+        free(text);
+    }
+}
+
+/* Function: ScanOperator
+ * ----------------------
+ * Matches punctuation and operators at cur, longest first. Returns the
+ * token code, or 0 if no operator starts here.
+ */
+static int ScanOperator() {
+    static const struct { char text[3]; int token; } twoChar[] = {
+        {"<=", T_LessEqual}, {">=", T_GreaterEqual}, {"==", T_EQ}, {"!=", T_NE},
+        {"&&", T_And}, {"||", T_Or}, {"++", T_Inc}, {"--", T_Dec},
+        {"+=", T_AddAssign}, {"-=", T_SubAssign}, {"*=", T_MulAssign},
+        {"/=", T_DivAssign},
+    };
+    char c = cur[0], next = cur + 1 < inputEnd ? cur[1] : '\0';
+    for (size_t i = 0; i < sizeof(twoChar) / sizeof(twoChar[0]); i++) {
+        if (twoChar[i].text[0] == c && twoChar[i].text[1] == next) {
+            SetIdentifier(cur, 2);
+            Match(2);
+            return twoChar[i].token;
+        }
+    }
+
+    int token = 0;
+    bool hasText = true;  // operators pass their text in yylval
+    switch (c) {
+      case '(': token = T_LeftParen; hasText = false; break;
+      case ')': token = T_RightParen; hasText = false; break;
+      case ':': token = T_Colon; hasText = false; break;
+      case ';': token = T_Semicolon; hasText = false; break;
+      case '{': token = T_LeftBrace; hasText = false; break;
+      case '}': token = T_RightBrace; hasText = false; break;
+      case '[': token = T_LeftBracket; hasText = false; break;
+      case ']': token = T_RightBracket; hasText = false; break;
+      case ',': token = T_Comma; hasText = false; break;
+      case '.': token = T_Dot; hasText = false; state = S_Fields; break;
+      case '+': token = T_Plus; break;
+      case '-': token = T_Dash; break;
+      case '*': token = T_Star; break;
+      case '/': token = T_Slash; break;
+      case '=': token = T_Equal; break;
+      case '>': token = T_RightAngle; break;
+      case '<': token = T_LeftAngle; break;
+      case '?': token = T_Question; break;
+      default: return 0;
+    }
+    if (hasText) SetIdentifier(cur, 1);
+    Match(1);
+    return token;
+}
+
+/* Function: ScanNumber
+ * --------------------
+ * Matches {HEX_INTEGER}, {INTEGER} or {FLOAT} at cur, which is a digit.
+ */
+static int ScanNumber() {
+    const char *s = cur;
+    size_t len;
+
+    if (s[0] == '0' && s + 2 < inputEnd && (s[1] == 'x' || s[1] == 'X') && IsHexDigit(s[2])) {
+        for (len = 3; s + len < inputEnd && IsHexDigit(s[len]); len++) ;
+        Match(len);
+        return ConvertIntConstant(s, len, lval, lloc);
+    }
+
+    for (len = 1; s + len < inputEnd && IsDigit(s[len]); len++) ;
+    if (s + len < inputEnd && s[len] == '.') {
+        for (len++; s + len < inputEnd && IsDigit(s[len]); len++) ;
+        if (s + len < inputEnd && (s[len] == 'f' || s[len] == 'F')) len++;
+        Match(len);
+        return ConvertFloatConstant(s, len, lval, lloc);
+    }
+    Match(len);
+    return ConvertIntConstant(s, len, lval, lloc);
+}
+
+/* Function: ScanCopyLine
+ * ----------------------
+ * The COPY state: save the line starting at cur for error reporting,
+ * then rescan it in the state underneath.
+ */
+static void ScanCopyLine() {
+    if (*cur == '\n') {      // empty line, the <*>\n rule matches in COPY
+        MatchNewline();
+        return;
+    }
+    const char *nl = (const char *)memchr(cur, '\n', inputEnd - cur);
+    size_t len = (nl ? nl : inputEnd) - cur;
+    SaveLine(strndup(cur, len));
+    Match(len);
+    cur -= len;              // yyless(0)
+    curColNum = 1;
+    copyPending = false;
+}
+
+/* Function: ScanComment
+ * ---------------------
+ * The COMM state. Text inside a comment is matched one character at a
+ * time by flex; we skip the whole run at once and leave yylloc where
+ * the last single-character match would have left it.
+ */
+static void ScanComment() {
+    size_t run = CommentRun(cur, inputEnd);
+    if (run > 0) {
+        Match(run);
+        lloc->first_column = lloc->last_column;
+        return;
+    }
+    switch (*cur) {
+      case '\n': MatchNewline(); break;
+      case '\t': MatchTab(); break;
+      default:  // '*'
+        if (cur + 1 < inputEnd && cur[1] == '/') {
+            Match(2);
+            state = S_Normal;
+        } else {
+            Match(1);
+        }
+    }
+}
+
+/* Function: ScanFields
+ * --------------------
+ * The FIELDS state entered after a '.': the next identifier is a field
+ * selection. Anything unexpected is echoed, as flex's default rule does.
+ */
+static int ScanFields() {
+    char c = *cur;
+    if (c == '\n') { MatchNewline(); return 0; }
+    if (c == '\t') { MatchTab(); return 0; }
+    if (c == ' ' || c == '\r') { Match(1); return 0; }
+    if (IsAlpha(c)) {
+        size_t len = IdentRun(cur, inputEnd);
+        const char *s = cur;
+        state = S_Normal;
+        Match(len);
+        CheckLongIdentifier(s, len);
+        SetIdentifier(s, len);
+        return T_FieldSelection;
+    }
+    Match(1);
+    Echo(c);
+    return 0;
+}
+
+// No more than blanks come before p on its line
+static bool AtLineStart(const char *p) {
+    while (p > input && (p[-1] == ' ' || p[-1] == '\t' || p[-1] == '\r'))
+        p--;
+    return p == input || p[-1] == '\n';
+}
+
+/* Function: ScanDirective
+ * -----------------------
+ * Matches a preprocessor directive from its '#' to the end of the line,
+ * or of the last line joined to it with a backslash, and returns it as a
+ * PreprocessorDirective located at the '#' with the text after it,
+ * interned, in yylval. Comments in it become a space; a comment that
+ * continues past its line ends the directive, and is then scanned as usual.
+ */
+static int ScanDirective() {
+    Match(1);
+    yyltype loc = *lloc;
+    string text;
+    while (cur < inputEnd && *cur != '\n') {
+        const char *nl = (const char *)memchr(cur, '\n', inputEnd - cur);
+        const char *eol = nl ? nl : inputEnd;
+        char c = *cur, next = cur + 1 < inputEnd ? cur[1] : '\0';
+        if (c == '\\' && (next == '\n' || (next == '\r' && cur + 2 == eol))) {
+            Match(next == '\r' ? 2 : 1);
+            MatchNewline();
+            if (copyPending && cur < inputEnd && *cur != '\n') ScanCopyLine();
+        } else if (c == '/' && next == '/') {
+            Match(eol - cur);
+        } else if (c == '/' && next == '*') {
+            const char *end = cur + 2;
+            while (end + 1 < eol && !(end[0] == '*' && end[1] == '/'))
+                end++;
+            if (end + 1 >= eol) break;
+            Match(end + 2 - cur);
+            text += ' ';
+        } else if (c == '\t') {
+            MatchTab();
+            text += ' ';
+        } else {
+            Match(1);
+            text += c;
+        }
+    }
+    *lloc = loc;
+    lval->identifier = Intern(text.data(), text.size());
+    return PreprocessorDirective;
+}
+
+/* Function: ScanNormal
+ * --------------------
+ * The INITIAL/N states. Returns a token code, or 0 if the lexeme was
+ * skipped (whitespace, comments, errors).
+ */
+static int ScanNormal() {
+    const char *s = cur;
+    char c = *s, next = s + 1 < inputEnd ? s[1] : '\0';
+
+    if (c == '\n') { MatchNewline(); return 0; }
+    if (c == '\t') { MatchTab(); return 0; }
+    if (c == ' ') { Match(SpaceRun(s, inputEnd)); return 0; }
+    if (c == '/' && next == '*') { Match(2); state = S_Comment; return 0; }
+    if (c == '/' && next == '/') {
+        const char *nl = (const char *)memchr(s, '\n', inputEnd - s);
+        Match((nl ? nl : inputEnd) - s);
+        return 0;
+    }
+    if (IsAlpha(c)) {
+        size_t len = IdentRun(s, inputEnd);
+        Match(len);
+        if (int keyword = ClassifyIdentifier(s, len, lval))
+            return keyword;
+        CheckLongIdentifier(s, len);
+        SetIdentifier(s, len);
+        return T_Identifier;
+    }
+    if (IsDigit(c))
+        return ScanNumber();
+    if (int token = ScanOperator())
+        return token;
+    if (c == '#' && directives && AtLineStart(s))
+        return ScanDirective();
+
+    Match(1);
+    ReportError::UnrecogChar(lloc, c);
+    return 0;
+}
+
+/* Function: FastLex
+ * -----------------
+ * Returns the next token, 0 at the end of input, or MoreInputNeeded if
+ * the input fed so far has been used up.
+ */
+static int FastLex() {
+    if (!input) ReadAllInput();
+    while (cur < scanLimit) {
+        int token = 0;
+        if (copyPending) ScanCopyLine();
+        else if (state == S_Comment) ScanComment();
+        else if (state == S_Fields) token = ScanFields();
+        else token = ScanNormal();
+        if (token) return token;
+    }
+    if (!inputComplete) return MoreInputNeeded;
+    copyPending = false;     // <COPY><<EOF>> pops back to the base state
+    if (state == S_Comment) {
+        ReportError::UntermComment();
+        state = S_Normal;
+    }
+    return 0;
+}
+
+
+/* Function: PrintToken
+ * --------------------
+ * Prints a token and its attributes under the "tokens" debug key.
+ */
+static void PrintToken(int token) {
+    char value[64] = "";
+    switch (token) {
+      case T_IntConstant: snprintf(value, sizeof(value), " %d", yylval.integerConstant); break;
+      case T_FloatConstant: snprintf(value, sizeof(value), " %g", yylval.floatConstant); break;
+      case T_BoolConstant: snprintf(value, sizeof(value), " %d", yylval.boolConstant); break;
+      case T_Identifier: case T_FieldSelection:
+      case T_LessEqual: case T_GreaterEqual: case T_EQ: case T_NE: case T_And:
+      case T_Or: case T_Inc: case T_Dec: case T_Plus: case T_Dash: case T_Star:
+      case T_Slash: case T_AddAssign: case T_SubAssign: case T_MulAssign:
+      case T_DivAssign: case T_Equal: case T_RightAngle: case T_LeftAngle:
+      case T_Question:
+        snprintf(value, sizeof(value), " %s", yylval.identifier); break;
+    }
+    PrintDebug("tokens", "%d %d.%d-%d%s", token, yylloc.first_line,
+               yylloc.first_column, yylloc.last_column, value);
+}
+
+/* Function: ScanAhead
+ * -------------------
+ * The body of the pipeline thread: scans the whole input into the ring,
+ * ending with the end-of-input token, or until FinishScanner() closes the
+ * ring on a parse that stopped early.
+ */
+static void ScanAhead() {
+    ReportError::DeferOnThisThread(DeferError);
+    Record r;
+    r.loc = yyltype();      // as InitParser() leaves yylloc, without reading it
+    lval = &r.value;
+    lloc = &r.loc;
+    do {
+        r.token = FastLex();
+        r.events = eventsHead;
+        eventsHead = NULL;
+        eventsTail = &eventsHead;
+        if (!tokenRing->Push(r)) {
+            while (Event *e = r.events) {
+                r.events = e->next;
+                delete e;
+            }
+            return;
+        }
+    } while (r.token != 0);
+}
+
+// Takes the next token from the pipeline thread
+static int PipelinedLex() {
+    Record r = tokenRing->Pop();
+    while (Event *e = r.events) {
+        if (e->echo >= 0) putchar(e->echo);
+        else ReportError::Replay(e->hasLoc ? &e->loc : NULL, e->msg);
+        r.events = e->next;
+        delete e;
+    }
+    yylval = r.value;
+    yylloc = r.loc;
+    return r.token;
+}
+
+int yylex() {
+    int token;
+#ifdef HAVE_FLEX_SCANNER
+    if (useFlex) token = FlexLex();
+    else
+#endif
+    token = pipelined ? PipelinedLex() : preprocessing ? PreprocessedLex() : FastLex();
+    if (token != MoreInputNeeded && IsDebugOn("tokens")) PrintToken(token);
+    return token;
+}
+
+/* Function: InitScanner
+ * ---------------------
+ * Selects the scanner from the --scanner option and initializes it.
+ * The flex scanner is the default when it is built in.
+ */
+void InitScanner() {
+    const char *which = GetOption("scanner");
+    const char *pipeline = GetOption("pipeline");
+    if (pipeline && GetOption("push"))
+        Failure("--pipeline and --push cannot be combined");
+    bool inMemory = GetOption("recheck") || GetOption("lsp") || GetOption("query-type") ||
+                    GetOption("query-scope");
+    if ((pipeline || GetOption("push")) && inMemory)
+        Failure("--push and --pipeline cannot be combined with --recheck, --lsp or a query");
+    bool batch = GetOption("batch");
+    preprocessing = GetOption("preprocess");
+    if ((preprocessing || batch) && (pipeline || GetOption("push") || inMemory))
+        Failure("--preprocess and --batch cannot be combined with --push, --pipeline, "
+                "--recheck, --lsp or a query");
+    yylloc.file = 0;         // bison starts yylloc at 1, 1, 1, 1 from the top
+#ifdef HAVE_FLEX_SCANNER
+    // flex reads yyin itself, and is not thread-safe
+    bool handWritten = GetOption("push") || pipeline || inMemory || preprocessing || batch;
+    useFlex = which ? !strcmp(which, "flex") : !handWritten;
+    if (useFlex && handWritten)
+        Failure("--push, --pipeline, --recheck, --lsp, --preprocess, --batch and queries "
+                "need the hand-written scanner");
+    if (useFlex) {
+        InitFlexScanner();
+        return;
+    }
+#endif
+    PrintDebug("lex", "Initializing hand-written scanner");
+    SelectKernels(which && !strcmp(which, "scalar"));
+    state = S_Normal;
+    copyPending = true;      // copy first line at start
+    curLineNum = 1;
+    curColNum = 1;
+    directives = preprocessing;
+    if (preprocessing)
+        StartPreprocessing(NULL);
+
+    if (pipeline) {
+        PrintDebug("lex", "Scanning on a separate thread");
+        tokenRing = new Ring<Record>(*pipeline ? atoi(pipeline) : 4096);
+        pipelined = true;
+        scanThread = thread(ScanAhead);
+    }
+}
+
+/* Function: FinishScanner
+ * -----------------------
+ * Stops the pipeline thread, if there is one, and waits for it, so that
+ * it is not still scanning while the program exits. The parse may have
+ * stopped before the end of the input, leaving the thread waiting on a
+ * full ring; closing the ring lets it return.
+ */
+void FinishScanner() {
+    if (!scanThread.joinable()) return;
+    tokenRing->Close();
+    scanThread.join();
+}
+
+/* Function: ScanText
+ * ------------------
+ * Restarts the scanner on a piece of the source held in memory (see
+ * incremental.h), starting at the first column of line firstLine. The
+ * text is scanned in place, and its lines are not saved: the caller
+ * supplies them with UseSourceLines().
+ */
+void ScanText(const char *text, size_t len, int firstLine) {
+    Assert(!pipelined);
+    input = cur = text;
+    scanLimit = inputEnd = text + len;
+    inputComplete = true;
+    state = S_Normal;
+    copyPending = saveLines = false;
+    curLineNum = firstLine;
+    curColNum = 1;
+}
+
+/* Function: ScanInput
+ * -------------------
+ * Restarts the scanner on a whole translation unit of a --batch run,
+ * scanned in place. Its lines are saved, replacing the last one's, and
+ * errors in it give its path.
+ */
+void ScanInput(const char *text, size_t len, const char *path) {
+    Assert(!pipelined);
+    input = cur = text;
+    scanLimit = inputEnd = text + len;
+    inputComplete = true;
+    state = S_Normal;
+    copyPending = saveLines = true;
+    curLineNum = 1;
+    curColNum = 1;
+    for (const char *line : savedLines)
+        if (*line) free((char *)line);
+    savedLines.clear();
+    inputName = path;
+    if (preprocessing)
+        StartPreprocessing(path);
+}
+
+// The input's next token before preprocessing
+int RawLex() {
+    return FastLex();
+}
+
+/* Function: ScanWhole
+ * -------------------
+ * Scans text from start to end without disturbing the scan in progress,
+ * keeping every token, the errors and echoed characters that go with
+ * each, and the text's lines. Directives are recognized only if asked
+ * for (not in a macro's replacement).
+ */
+void ScanWhole(const char *text, size_t len, bool withDirectives, ScannedFile *into) {
+    const char *oldInput = input, *oldEnd = inputEnd, *oldCur = cur, *oldLimit = scanLimit;
+    bool oldComplete = inputComplete, oldCopy = copyPending, oldSave = saveLines;
+    bool oldDirectives = directives;
+    ScanState oldState = state;
+    int oldLine = curLineNum, oldColumn = curColNum;
+    YYSTYPE *oldLval = lval;
+    yyltype *oldLloc = lloc;
+    vector<const char*> oldLines;
+    oldLines.swap(savedLines);
+
+    input = cur = text;
+    scanLimit = inputEnd = text + len;
+    inputComplete = true;
+    state = S_Normal;
+    copyPending = saveLines = true;
+    directives = withDirectives;
+    curLineNum = 1;
+    curColNum = 1;
+    PPToken t;
+    t.loc = yyltype();
+    lval = &t.value;
+    lloc = &t.loc;
+    ReportError::CollectOnThisThread(&into->diags);
+    do {
+        into->firstDiag.push_back(into->diags.size());
+        t.token = FastLex();
+        into->tokens.push_back(t);
+    } while (t.token != 0);
+    into->firstDiag.push_back(into->diags.size());
+    ReportError::CollectOnThisThread(NULL);
+    into->lines.swap(savedLines);
+
+    savedLines.swap(oldLines);
+    input = oldInput; inputEnd = oldEnd; cur = oldCur; scanLimit = oldLimit;
+    inputComplete = oldComplete; copyPending = oldCopy; saveLines = oldSave;
+    directives = oldDirectives;
+    state = oldState;
+    curLineNum = oldLine; curColNum = oldColumn;
+    lval = oldLval;
+    lloc = oldLloc;
+}
+
+void UseSourceLines(LineSource *lines) {
+    sourceLines = lines;
+}
+
+const char *GetLineNumbered(int num) {
+    if (sourceLines) return sourceLines->LineNumbered(num);
+#ifdef HAVE_FLEX_SCANNER
+    if (useFlex) return FlexLineNumbered(num);
+#endif
+    if (pipelined) {
+        lock_guard<mutex> guard(savedLinesLock);
+        if (num <= 0 || num > savedLines.size()) return NULL;
+        return savedLines[num-1];
+    }
+    if (num <= 0 || num > savedLines.size()) return NULL;
+    return savedLines[num-1];
+}
+
+const char *SourceLine(int file, int num) {
+    return file ? PreprocessedFileLine(file, num) : GetLineNumbered(num);
+}
+
+const char *SourceName(int file) {
+    if (file) return PreprocessedFileName(file);
+    return inputName.empty() ? NULL : inputName.c_str();
+}
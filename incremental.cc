@@ -0,0 +1,779 @@
+/* File: incremental.cc
+ * --------------------
+ * Implementation of IncrementalChecker (see incremental.h).
+ */
+
+#include <ctype.h>
+#include <string.h>
+#include <unordered_map>
+#include <unordered_set>
+#include <algorithm>
+#include "incremental.h"
+#include "ast_index.h"
+#include "ast_decl.h"
+#include "ast_stmt.h"
+#include "keywords.h"
+#include "parser.h"
+#include "scanner.h"
+#include "symtable.h"
+#include "utility.h"
+
+/* A piece of the source: whole lines, from the line after the previous
+ * piece ends to the end of the line on which a top-level declaration
+ * ends. Because a piece is whole lines, its columns do not change when
+ * it moves.
+ */
+struct Piece {
+    size_t offset, length;
+    int firstLine;
+    bool cut;               // it ends where a declaration does
+    bool tokens;            // it holds a token: all but a source without any
+};
+
+/* What the characters mean to CutIntoPieces. C_Blank is every character
+ * that gives the parser no token: blanks, and those the scanner reports
+ * as unrecognized. '&' and '|' are tokens only when doubled.
+ */
+enum CharClass { C_Blank, C_Token, C_Newline, C_Slash, C_Open, C_Close, C_Semicolon, C_Pair };
+
+static const struct CharClasses {
+    unsigned char of[256];
+    CharClasses() {
+        memset(of, C_Blank, sizeof(of));
+        for (int c = 'a'; c <= 'z'; c++) of[c] = of[c - 'a' + 'A'] = C_Token;
+        for (int c = '0'; c <= '9'; c++) of[c] = C_Token;
+        for (const char *p = "()[]:,.+-*=<>?"; *p; p++) of[(unsigned char)*p] = C_Token;
+        of[(unsigned char)'\n'] = C_Newline;
+        of[(unsigned char)'/'] = C_Slash;
+        of[(unsigned char)'{'] = C_Open;
+        of[(unsigned char)'}'] = C_Close;
+        of[(unsigned char)';'] = C_Semicolon;
+        of[(unsigned char)'&'] = of[(unsigned char)'|'] = C_Pair;
+    }
+} charClasses;
+
+// The bytes at text[i] that make a C_Pair token, or 0 if it is blank
+static inline int PairLength(const char *text, size_t i, size_t len)
+{
+    return i + 1 < len && text[i+1] == text[i] ? 2 : 0;
+}
+
+/* Function: WordEnd
+ * ------------------
+ * Where the identifier or number at text[i] ends, as the scanner reads
+ * it. The '.' of a float literal is part of it, not a T_Dot.
+ */
+static size_t WordEnd(const char *text, size_t i, size_t len)
+{
+    if (isalpha((unsigned char)text[i])) {
+        while (i < len && (isalnum((unsigned char)text[i]) || text[i] == '_')) i++;
+        return i;
+    }
+    if (text[i] == '0' && i + 2 < len && (text[i+1] == 'x' || text[i+1] == 'X')
+        && isxdigit((unsigned char)text[i+2])) {
+        for (i += 2; i < len && isxdigit((unsigned char)text[i]); i++)
+            ;
+        return i;
+    }
+    while (i < len && isdigit((unsigned char)text[i])) i++;
+    if (i < len && text[i] == '.') {
+        for (i++; i < len && isdigit((unsigned char)text[i]); i++)
+            ;
+        if (i < len && (text[i] == 'f' || text[i] == 'F')) i++;
+    }
+    return i;
+}
+
+/* Function: CutIntoPieces
+ * -----------------------
+ * Finds where the top-level declarations end without parsing: at a ';'
+ * outside any braces, or at the '}' that closes a function body. The
+ * piece is cut at the end of that line, unless another declaration
+ * starts on it. Comments are skipped, so braces inside them do not
+ * count. Text after the last cut that holds no tokens (blank lines, a
+ * comment) goes with the last piece, since a piece without a
+ * declaration would not parse. After a '.' the scanner only looks for a
+ * field name: until the next letter, any other character is echoed, not
+ * a token (see ScanFields in fastscan.cc), so it ends nothing here either.
+ *
+ * Cutting starts at from, which begins line, and is a cut (or 0): alone
+ * says no piece comes before it. It ends where stop(offset) says the
+ * pieces from there on are known, setting *stopLine to the line there,
+ * or at the end of text. Returns false if text after the last cut holds
+ * no tokens and there is no piece here to add it to; the caller then
+ * starts again at an earlier cut.
+ */
+template<class Stop>
+static bool CutIntoPieces(const char *text, size_t len, size_t from, int line, bool alone,
+                          Stop stop, vector<Piece> &pieces, int *stopLine)
+{
+    size_t start = from;
+    int startLine = line, depth = 0;
+    bool ended = false;     // a declaration has ended on this line
+    bool tokens = false;    // the piece so far holds a token
+    bool fields = false;    // after a '.', waiting for the field name
+    *stopLine = line;
+    if (stop(from)) return true;
+    for (size_t i = from; i < len; i++) {
+        int c = charClasses.of[(unsigned char)text[i]];
+        if (fields && c != C_Newline && !isalpha((unsigned char)text[i]))
+            continue;
+        switch (c) {
+          case C_Blank:
+            break;
+          case C_Newline:
+            line++;
+            if (ended) {
+                Piece p = { start, i + 1 - start, startLine, true, true };
+                pieces.push_back(p);
+                start = i + 1;
+                startLine = line;
+                ended = tokens = false;
+                if (stop(start)) {
+                    *stopLine = line;
+                    return true;
+                }
+            }
+            break;
+          case C_Slash:
+            if (i + 1 < len && text[i+1] == '/') {
+                const char *nl = (const char *)memchr(text + i, '\n', len - i);
+                i = (nl ? nl - text : len) - 1;
+                break;
+            }
+            if (i + 1 < len && text[i+1] == '*') {
+                size_t j = i + 2;
+                while (j + 1 < len && !(text[j] == '*' && text[j+1] == '/')) {
+                    if (text[j] == '\n') line++;
+                    j++;
+                }
+                i = j + 1 < len ? j + 1 : len;
+                break;
+            }
+            tokens = true;
+            ended = false;
+            break;
+          case C_Pair:
+            if (!PairLength(text, i, len)) break;
+            i++;
+            tokens = true;
+            ended = false;
+            break;
+          case C_Token:
+            tokens = true;
+            ended = false;
+            fields = (text[i] == '.');
+            if (isalnum((unsigned char)text[i])) i = WordEnd(text, i, len) - 1;
+            break;
+          case C_Open:
+            tokens = true;
+            ended = false;
+            depth++;
+            break;
+          case C_Close:
+            tokens = true;
+            ended = depth > 0 && --depth == 0;
+            break;
+          case C_Semicolon:
+            tokens = true;
+            ended = (depth == 0);
+            break;
+        }
+    }
+    bool none = alone && pieces.empty();
+    if (start < len || none) {
+        if (tokens || none) {
+            Piece p = { start, len - start, startLine, false, tokens };
+            pieces.push_back(p);
+        } else if (!pieces.empty()) {
+            pieces.back().length = len - pieces.back().offset;
+            pieces.back().cut = false;
+        } else {
+            return false;
+        }
+    }
+    return true;
+}
+
+/* Function: StartsDeclaration
+ * ----------------------------
+ * Whether the first token of text can start a declaration: a type, void
+ * or a type qualifier. If it cannot, a syntax error at that token comes
+ * where a declaration could start (see ParseDecls).
+ */
+static bool StartsDeclaration(const char *text, size_t len)
+{
+    const char *p = text, *end = text + len;
+    while (p < end) {
+        int c = charClasses.of[(unsigned char)*p];
+        if (c == C_Blank || c == C_Newline || (c == C_Pair && !PairLength(p, 0, end - p))) {
+            p++;
+        } else if (*p == '/' && p + 1 < end && p[1] == '/') {
+            const char *nl = (const char *)memchr(p, '\n', end - p);
+            p = nl ? nl : end;
+        } else if (*p == '/' && p + 1 < end && p[1] == '*') {
+            const char *close = p + 2;
+            while (close + 1 < end && !(close[0] == '*' && close[1] == '/')) close++;
+            p = close + 2;
+        } else {
+            break;
+        }
+    }
+    const char *word = p;
+    while (p < end && (isalnum((unsigned char)*p) || *p == '_')) p++;
+    const Keyword *k = word < p ? LookupKeyword(word, p - word) : NULL;
+    if (k == NULL) return false;
+    switch (k->token) {
+      case T_TypeName: case T_Void:
+      case T_In: case T_Out: case T_Const: case T_Uniform:
+        return true;
+    }
+    return false;
+}
+
+// FNV-1a, over the text of a piece
+static uint64_t HashText(const char *text, size_t len)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (size_t i = 0; i < len; i++)
+        h = (h ^ (unsigned char)text[i]) * 0x100000001b3ull;
+    return h;
+}
+
+static inline uint64_t Mix(uint64_t h, uint64_t v)
+{
+    return (h ^ v) * 0x9E3779B97F4A7C15ull + 0x632BE59BD9B4E019ull;
+}
+
+/* Function: Meaning
+ * -----------------
+ * A hash of what a body can learn about a global declaration: whether
+ * there is one, a function or a variable, the return and formal types
+ * of a function, the type and constant value of a variable. Types are
+ * compared by identity, as the checker compares them.
+ */
+static uint64_t Meaning(Decl *decl)
+{
+    if (decl == NULL) return 0;
+    uint64_t h;
+    if (FnDecl *fn = dynamic_cast<FnDecl*>(decl)) {
+        h = Mix(Mix(1, E_FunctionDecl), (uintptr_t)fn->GetType());
+        for (VarDecl *formal : *fn->GetFormals())
+            h = Mix(h, (uintptr_t)formal->GetType());
+    } else {
+        VarDecl *var = dynamic_cast<VarDecl*>(decl);
+        h = Mix(1, E_VarDecl);
+        if (var == NULL) return h;
+        h = Mix(h, (uintptr_t)var->GetType());
+        Constant c = var->GetConstant();
+        uint64_t bits = 0;
+        if (c.kind == Constant::Float) memcpy(&bits, &c.floatValue, sizeof(double));
+        else if (c.kind == Constant::Int) bits = (unsigned)c.intValue;
+        else if (c.kind == Constant::Bool) bits = c.boolValue;
+        h = Mix(Mix(h, c.kind), bits);
+    }
+    return h;
+}
+
+// Of a function, what all the overloads the symbol sees mean
+static uint64_t Meaning(Symbol *sym)
+{
+    if (sym == NULL || sym->overloads == NULL)
+        return sym ? Meaning(sym->decl) : 0;
+    vector<FnDecl *> fns;
+    sym->overloads->visible(sym->overloadCount, fns);
+    uint64_t h = fns.size();
+    for (FnDecl *fn : fns)
+        h = Mix(h, Meaning(fn));
+    return h;
+}
+
+// Moves the locations in a subtree by delta lines
+static void ShiftLines(Node *root, int delta)
+{
+    if (delta == 0) return;
+    for (TreeWalker walk(root); walk.Next(); ) {
+        if (yyltype *loc = walk.GetNode()->GetLocation()) {
+            loc->first_line += delta;
+            loc->last_line += delta;
+        }
+        if (StmtBlock *block = dynamic_cast<StmtBlock*>(walk.GetNode())) {
+            block->GetBraces()->first_line += delta;
+            block->GetBraces()->last_line += delta;
+        }
+    }
+}
+
+// Whether loc holds line:column
+static bool Holds(const yyltype *loc, int line, int column)
+{
+    return (loc->first_line < line || (loc->first_line == line && loc->first_column <= column)) &&
+           (line < loc->last_line || (line == loc->last_line && column <= loc->last_column));
+}
+
+// The length of the text a and b start with
+static size_t CommonPrefix(const char *a, const char *b, size_t len)
+{
+    const size_t block = 4096;
+    size_t n = 0;
+    while (n + block <= len && memcmp(a + n, b + n, block) == 0)
+        n += block;
+    while (n < len && a[n] == b[n])
+        n++;
+    return n;
+}
+
+// The length of the text that the len bytes before aEnd and bEnd end with
+static size_t CommonSuffix(const char *aEnd, const char *bEnd, size_t len)
+{
+    const size_t block = 4096;
+    size_t n = 0;
+    while (n + block <= len && memcmp(aEnd - n - block, bEnd - n - block, block) == 0)
+        n += block;
+    while (n < len && aEnd[-1 - (ptrdiff_t)n] == bEnd[-1 - (ptrdiff_t)n])
+        n++;
+    return n;
+}
+
+static void AddNames(List<Decl*> *decls, unordered_set<const char *> &names)
+{
+    if (decls == NULL) return;
+    for (Decl *d : *decls)
+        names.insert(d->GetIdentifier()->GetName());
+}
+
+IncrementalChecker::IncrementalChecker()
+    : all(NULL), program(NULL), global(NULL), checkedAll(false),
+      numParsed(0), numChecked(0), collected(NULL), reported(0), index(NULL) {}
+
+IncrementalChecker::~IncrementalChecker() {
+    delete index;
+    delete program;
+    delete all;
+    delete global;
+    for (Unit *u : units)
+        Delete(u);
+}
+
+void IncrementalChecker::Delete(Unit *unit) {
+    if (unit->decls) {
+        unit->decls->DeleteAll();
+        delete unit->decls;
+    }
+    delete unit;
+}
+
+// The lines printed under errors, found in the source as they are asked
+// for
+const char *IncrementalChecker::LineNumbered(int n) {
+    if (lineStarts.empty()) {
+        const char *text = source.data(), *end = text + source.size();
+        lineStarts.push_back(0);
+        for (const char *p = text; (p = (const char *)memchr(p, '\n', end - p)) != NULL; p++)
+            lineStarts.push_back(p + 1 - text);
+    }
+    if (n <= 0 || n > (int)lineStarts.size()) return NULL;
+    size_t start = lineStarts[n-1];
+    size_t end = n < (int)lineStarts.size() ? lineStarts[n] - 1 : source.size();
+    line.assign(source, start, end - start);
+    return line.c_str();
+}
+
+IncrementalChecker::Unit *IncrementalChecker::Parse(const char *text, const Piece &piece) {
+    Unit *unit = new Unit;
+    unit->offset = piece.offset;
+    unit->length = piece.length;
+    unit->firstLine = piece.firstLine;
+    unit->cut = piece.cut;
+    unit->tokens = piece.tokens;
+    const char *s = text + piece.offset;
+    ReportError::CollectOnThisThread(&unit->parseErrors);
+    unit->decls = ParseDecls(s, piece.length, piece.firstLine, &unit->complete);
+    ReportError::CollectOnThisThread(NULL);
+    // An error at the first token is where a declaration could start
+    if (!unit->complete && unit->decls == NULL && !StartsDeclaration(s, piece.length))
+        unit->decls = new List<Decl*>;
+    Declared d;
+    d.checked = false;
+    d.bodyLine = piece.firstLine;
+    d.meaning = 0;
+    if (unit->decls)
+        unit->declared.assign(unit->decls->NumElements(), d);
+    numParsed++;
+    return unit;
+}
+
+/* Function: Move
+ * --------------
+ * A unit kept from the last version now starts at firstLine. The global
+ * declarations are all checked again, so the locations they report
+ * errors at are moved now: all of a variable's, a function's own and
+ * its name's. A body's are moved when it is checked again; until then
+ * its errors, if it had any, are out of date.
+ */
+void IncrementalChecker::Move(Unit *unit, int firstLine) {
+    int delta = firstLine - unit->firstLine;
+    if (delta == 0) return;
+    unit->firstLine = firstLine;
+    for (Decl *d : *unit->decls) {
+        if (FnDecl *fn = dynamic_cast<FnDecl*>(d)) {
+            ShiftLines(fn->GetIdentifier(), delta);
+            yyltype *loc = fn->GetLocation();
+            loc->first_line += delta;
+            loc->last_line += delta;
+        } else {
+            ShiftLines(d, delta);
+        }
+    }
+}
+
+// The diagnostics that are errors, not echoed characters
+static int CountErrors(const vector<Diagnostic> &diags)
+{
+    int errors = 0;
+    for (const Diagnostic &d : diags)
+        if (d.echo < 0) errors++;
+    return errors;
+}
+
+/* Function: Update
+ * ----------------
+ * Keeps the units before the first byte the versions differ in where
+ * they are, and those within the text both versions end with, moved by
+ * the lines the edit added. The text between is cut again, from the end
+ * of the last unit kept before it until a cut falls where a unit kept
+ * after it starts. Its pieces are matched by their text with the units
+ * they replace, or parsed. A unit that moved and had errors from the
+ * scanner or parser is parsed again, since those errors carry its old
+ * lines. The units not matched belong to text that is gone.
+ */
+int IncrementalChecker::Update(const char *text, size_t len, vector<Diagnostic> *found,
+                               const atomic<bool> *cancel) {
+    delete index;
+    index = NULL;
+    const char *old = source.data();
+    size_t oldLen = source.size(), shorter = min(oldLen, len);
+    size_t prefix = CommonPrefix(old, text, shorter);
+    size_t suffix = CommonSuffix(old + oldLen, text + len, shorter - prefix);
+
+    size_t first = 0, last = units.size();
+    while (first < units.size() && units[first]->cut &&
+           units[first]->offset + units[first]->length <= prefix)
+        first++;
+    while (last > first && units[last-1]->offset >= oldLen - suffix)
+        last--;
+
+    // Where a unit kept after the edit starts now
+    size_t next;
+    bool stopped;
+    auto stop = [&](size_t at) {
+        while (next < units.size() && units[next]->offset + len < at + oldLen)
+            next++;
+        stopped = next < units.size() && units[next]->offset + len == at + oldLen &&
+                  units[next]->tokens;
+        return stopped;
+    };
+    vector<Piece> pieces;
+    int stopLine;
+    for (;; first--) {
+        size_t from = 0;
+        int fromLine = 1;
+        if (first > 0) {
+            Unit *u = units[first-1];
+            from = u->offset + u->length;
+            fromLine = u->firstLine + (int)count(text + u->offset, text + from, '\n');
+        }
+        pieces.clear();
+        next = last;
+        if (CutIntoPieces(text, len, from, fromLine, first == 0, stop, pieces, &stopLine))
+            break;
+    }
+    if (!stopped) next = units.size();
+
+    // The names declared in the text between may mean something else now
+    unordered_set<const char *> changed;
+    unordered_multimap<uint64_t, Unit*> replaced;
+    for (size_t k = first; k < next; k++) {
+        Unit *u = units[k];
+        replaced.insert(make_pair(HashText(old + u->offset, u->length), u));
+        AddNames(u->decls, changed);
+    }
+    vector<Unit*> updated(units.begin(), units.begin() + first), stale;
+    vector<bool> recut(first, false);
+    numParsed = 0;
+    for (const Piece &p : pieces) {
+        Unit *unit = NULL;
+        auto range = replaced.equal_range(HashText(text + p.offset, p.length));
+        for (auto it = range.first; it != range.second; ++it)
+            if (it->second->length == p.length &&
+                memcmp(old + it->second->offset, text + p.offset, p.length) == 0) {
+                unit = it->second;
+                replaced.erase(it);
+                break;
+            }
+        if (unit && unit->firstLine != p.firstLine && !unit->parseErrors.empty()) {
+            stale.push_back(unit);
+            unit = NULL;
+        }
+        if (unit) {
+            Move(unit, p.firstLine);
+            unit->offset = p.offset;
+            unit->cut = p.cut;
+            unit->tokens = p.tokens;
+        } else {
+            unit = Parse(text, p);
+        }
+        AddNames(unit->decls, changed);
+        updated.push_back(unit);
+        recut.push_back(true);
+    }
+    int lineDelta = next < units.size() ? stopLine - units[next]->firstLine : 0;
+    for (size_t k = next; k < units.size(); k++) {
+        Unit *unit = units[k];
+        unit->offset = unit->offset + len - oldLen;
+        bool again = lineDelta != 0 && !unit->parseErrors.empty();
+        if (again) {
+            Piece p = { unit->offset, unit->length, unit->firstLine + lineDelta,
+                         unit->cut, unit->tokens };
+            stale.push_back(unit);
+            unit = Parse(text, p);
+        } else {
+            Move(unit, unit->firstLine + lineDelta);
+        }
+        updated.push_back(unit);
+        recut.push_back(again);
+    }
+
+    // The last version's scope and program refer to the units replaced
+    delete global;
+    global = NULL;
+    for (auto &entry : replaced)
+        Delete(entry.second);
+    for (Unit *u : stale)
+        Delete(u);
+    units.swap(updated);
+    source.assign(text, len);
+    lineStarts.clear();
+    UseSourceLines(this);
+
+    // As with yyparse(), nothing after the first syntax error counts.
+    // The declarations before it are checked if there were no other
+    // errors and the parser reduced them to a Program (see ParseDecls),
+    // and then the syntax error is printed.
+    // Characters the scanner echoes are no errors: they come out as it
+    // reads them, ahead of what checking finds.
+    size_t numUnits = 0;
+    bool check = true;
+    while (numUnits < units.size()) {
+        Unit *u = units[numUnits++];
+        if (!u->complete) {
+            check = check && u->decls && CountErrors(u->parseErrors) == 1;
+            break;
+        }
+        check = check && CountErrors(u->parseErrors) == 0;
+    }
+    numChecked = 0;
+    collected = found;
+    reported = 0;
+    if (check)
+        for (size_t i = 0; i < numUnits; i++)
+            for (const Diagnostic &d : units[i]->parseErrors)
+                if (d.echo >= 0) Report(d);
+    bool cancelled = check && !Check(numUnits, recut, changed, cancel);
+    checkedAll = check && !cancelled && numUnits == units.size();
+    if (!cancelled)
+        for (size_t i = 0; i < numUnits; i++)
+            for (const Diagnostic &d : units[i]->parseErrors)
+                if (!check || d.echo < 0) Report(d);
+    collected = NULL;
+    UseSourceLines(NULL);
+    PrintDebug("incremental", "Parsed %d of %d pieces, checked %d function bodies%s",
+               numParsed, (int)units.size(), numChecked, cancelled ? " (cancelled)" : "");
+    return cancelled ? -1 : reported;
+}
+
+void IncrementalChecker::Report(const Diagnostic &d) {
+    if (d.echo < 0) reported++;
+    if (collected) collected->push_back(d);
+    else ReportError::Replay(d);
+}
+
+// Whether a global name the body at position looked up means something
+// else now, of those in only if it is given
+bool IncrementalChecker::UsesChanged(const Declared &d, int position,
+                                     const unordered_set<const char *> *only) {
+    for (const pair<const char *, uint64_t> &use : d.uses)
+        if ((only == NULL || only->count(use.first)) &&
+            Meaning(global->find(use.first, position)) != use.second)
+            return true;
+    return false;
+}
+
+/* Function: Check
+ * ---------------
+ * Checks the declarations of the first numUnits units: all the global
+ * declarations, then the bodies that were just parsed, that had errors
+ * and have moved, or whose global names changed meaning. A name can only
+ * have changed if it was declared in the text cut again (or was before)
+ * or its declaration now means something else, by a constant it uses;
+ * those are the names in changed, and only they are looked up again for
+ * the units not cut again, unless the last version went unchecked.
+ * Every declaration's errors are then reported in order, as
+ * Program::Check() prints them. Returns false if cancelled, leaving the
+ * bodies it was to check marked unchecked.
+ */
+bool IncrementalChecker::Check(size_t numUnits, const vector<bool> &recut,
+                               unordered_set<const char *> &changed,
+                               const atomic<bool> *cancel) {
+    delete program;
+    delete all;
+    all = new List<Decl*>;
+    vector<Declared*> declared;
+    vector<size_t> unitOf;
+    for (size_t j = 0; j < numUnits; j++) {
+        Unit *u = units[j];
+        for (int k = 0; k < u->decls->NumElements(); k++) {
+            all->Append(u->decls->Nth(k));
+            declared.push_back(&u->declared[k]);
+            unitOf.push_back(j);
+        }
+    }
+    program = new Program(all);
+
+    int n = all->NumElements();
+    vector< vector<Diagnostic> > found(n), bodyFound(n);
+    vector< vector<const char *> > lookups(n);
+    global = program->CheckGlobals(found);
+    for (int i = 0; i < n; i++) {
+        uint64_t meaning = Meaning(all->Nth(i));
+        if (meaning != declared[i]->meaning) {
+            declared[i]->meaning = meaning;
+            changed.insert(all->Nth(i)->GetIdentifier()->GetName());
+        }
+    }
+
+    vector<bool> which(n, false);
+    for (int i = 0; i < n; i++) {
+        FnDecl *fn = dynamic_cast<FnDecl*>(all->Nth(i));
+        if (fn == NULL || fn->GetBody() == NULL) continue;
+        Declared &d = *declared[i];
+        int line = units[unitOf[i]]->firstLine;
+        bool everyUse = !checkedAll || recut[unitOf[i]];
+        if (d.checked && (d.errors.empty() || d.bodyLine == line) &&
+            !UsesChanged(d, i, everyUse ? NULL : &changed))
+            continue;
+        for (VarDecl *formal : *fn->GetFormals())
+            ShiftLines(formal, line - d.bodyLine);
+        ShiftLines(fn->GetBody(), line - d.bodyLine);
+        d.bodyLine = line;
+        which[i] = true;
+        numChecked++;
+    }
+    if (!program->CheckBodies(global, which, Program::NumCheckThreads(), bodyFound,
+                              &lookups, cancel)) {
+        for (int i = 0; i < n; i++)
+            if (which[i]) declared[i]->checked = false;
+        return false;
+    }
+
+    for (int i = 0; i < n; i++) {
+        if (!which[i]) continue;
+        Declared &d = *declared[i];
+        d.checked = true;
+        d.errors.swap(bodyFound[i]);
+        vector<const char *> &names = lookups[i];
+        sort(names.begin(), names.end());
+        names.erase(unique(names.begin(), names.end()), names.end());
+        d.uses.clear();
+        for (const char *name : names)
+            d.uses.push_back(make_pair(name, Meaning(global->find(name, i))));
+    }
+
+    for (int i = 0; i < n; i++) {
+        for (const Diagnostic &d : found[i])
+            Report(d);
+        for (const Diagnostic &d : declared[i]->errors)
+            Report(d);
+    }
+    return true;
+}
+
+/* Function: MoveBodies
+ * --------------------
+ * Moves the bodies not checked again since their pieces moved to where
+ * they are now, as Check() would. One that had errors is then checked
+ * again by the next Update(), since its errors still carry its old lines.
+ */
+void IncrementalChecker::MoveBodies() {
+    for (Unit *u : units) {
+        if (u->decls == NULL) continue;
+        for (int k = 0; k < u->decls->NumElements(); k++) {
+            Declared &d = u->declared[k];
+            FnDecl *fn = dynamic_cast<FnDecl*>(u->decls->Nth(k));
+            if (fn == NULL || fn->GetBody() == NULL || d.bodyLine == u->firstLine)
+                continue;
+            for (VarDecl *formal : *fn->GetFormals())
+                ShiftLines(formal, u->firstLine - d.bodyLine);
+            ShiftLines(fn->GetBody(), u->firstLine - d.bodyLine);
+            d.bodyLine = u->firstLine;
+            if (!d.errors.empty()) d.checked = false;
+        }
+    }
+}
+
+// Builds the index of the last version the first time it is asked for
+const AstIndex *IncrementalChecker::Index() {
+    if (index) return index;
+    MoveBodies();
+    vector<Node *> roots;
+    for (Unit *u : units)
+        if (u->decls)
+            for (Decl *decl : *u->decls)
+                roots.push_back(decl);
+    index = new AstIndex(roots);
+    return index;
+}
+
+/* Function: VisibleAt
+ * -------------------
+ * Finds the declaration the position is in or after, and within a
+ * function body the innermost block around it, whose saved scope knows
+ * the locals; the global scope knows what the declarations before it
+ * declared.
+ */
+void IncrementalChecker::VisibleAt(int line, int column, vector<const Symbol *> &out) {
+    MoveBodies();
+    int position = -1, i = 0;
+    StmtBlock *body = NULL;
+    for (Unit *u : units) {
+        if (u->firstLine > line) break;
+        if (u->decls == NULL) continue;
+        for (Decl *decl : *u->decls) {
+            FnDecl *fn = dynamic_cast<FnDecl*>(decl);
+            StmtBlock *block = fn ? dynamic_cast<StmtBlock*>(fn->GetBody()) : NULL;
+            yyltype *loc = decl->GetLocation();
+            if (block && Holds(block->GetBraces(), line, column)) {
+                body = block;
+                position = i;
+            } else if (loc && (loc->first_line < line ||
+                               (loc->first_line == line && loc->first_column < column))) {
+                position = i;
+            }
+            i++;
+        }
+    }
+
+    unordered_set<const char *> seen;
+    if (body) {
+        StmtBlock *inner = NULL;
+        for (TreeWalker walk(body); walk.Next(); ) {
+            StmtBlock *block = dynamic_cast<StmtBlock*>(walk.GetNode());
+            if (block && block->GetScope() && Holds(block->GetBraces(), line, column))
+                inner = block;
+        }
+        if (inner)
+            inner->GetScope()->visible(line, column, out, seen);
+    }
+    if (global && position >= 0)
+        global->visible(position, out, seen);
+}
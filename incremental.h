@@ -0,0 +1,140 @@
+/* File: incremental.h
+ * -------------------
+ * IncrementalChecker checks one version of a source after another (the
+ * buffer of an editor, say), doing again only what an edit can have
+ * changed.
+ *
+ * The source is cut into pieces that end where a top-level declaration
+ * ends, and the declarations parsed from each piece are kept. When a new
+ * version comes, the text it shares with the last one at the start and
+ * at the end is found first; the pieces within those stay, those after
+ * the edit only moving to other lines. The text in between is cut
+ * again, and a piece there whose text was in the last version (a
+ * function moved elsewhere) is recognized by its text and kept too. Only
+ * the other pieces are parsed.
+ *
+ * The global declarations are then checked again, which is cheap, and a
+ * function body is checked again only if it was just parsed, or if a
+ * global name it looked up last time now means something else: a
+ * function whose return type or formals changed, a variable whose type
+ * or constant value changed, a name declared or removed. Every other
+ * body keeps the errors it had, so the work done follows the size of
+ * the edit rather than the size of the source.
+ *
+ * The errors printed for a version are the ones glc prints for the same
+ * text. They can be collected instead, and a check given up when the
+ * version it is for is out of date (see lsp.h):
+ *
+ *   IncrementalChecker checker;
+ *   checker.Update(text, len);        // checks everything
+ *   checker.Update(edited, len2);     // checks what the edit touched
+ *   checker.Index()->TypeAt(3, 14);   // the type of what is at 3:14
+ *   checker.VisibleAt(3, 14, names);  // the names in scope there
+ *
+ * InitScanner() and InitParser() must have been called first, and the
+ * scanner is the hand-written one.
+ */
+
+#ifndef _H_incremental
+#define _H_incremental
+
+#include <stddef.h>
+#include <stdint.h>
+#include <atomic>
+#include <string>
+#include <utility>
+#include <vector>
+#include <unordered_set>
+#include "errors.h"
+#include "list.h"
+#include "scanner.h"
+
+using namespace std;
+
+class AstIndex;
+class Decl;
+class Program;
+class GlobalScope;
+struct Piece;
+struct Symbol;
+
+class IncrementalChecker : public LineSource {
+    // What is kept for one top-level declaration
+    struct Declared {
+        bool checked;              // the body's errors below are current
+        int bodyLine;              // where the piece was when the body's
+                                   // locations were last set
+        uint64_t meaning;          // see Meaning() in incremental.cc
+        vector<Diagnostic> errors; // found in the body
+        // the global names the body looked up, and what each meant
+        vector< pair<const char *, uint64_t> > uses;
+    };
+    // A piece of the source and what was parsed from it
+    struct Unit {
+        size_t offset, length;     // in source
+        int firstLine, numLines;
+        bool cut;                  // it ends where a declaration does
+        bool tokens;               // it holds a token
+        bool complete;             // no syntax error stopped the parse
+        List<Decl*> *decls;        // see ParseDecls
+        vector<Diagnostic> parseErrors;
+        vector<Declared> declared; // one per element of decls
+    };
+
+    string source;                 // the last version
+    vector<size_t> lineStarts;     // found when a line is first asked for
+    string line;                   // the last line returned
+    vector<Unit*> units;
+    List<Decl*> *all;              // the declarations checked, in order
+    Program *program;
+    GlobalScope *global;
+    bool checkedAll;               // the last version was checked
+    int numParsed, numChecked;
+    vector<Diagnostic> *collected; // where errors go, or NULL to print them
+    int reported;
+    AstIndex *index;               // of the last version, once asked for
+
+    void Report(const Diagnostic &d);
+    void MoveBodies();
+    Unit *Parse(const char *text, const Piece &piece);
+    void Move(Unit *unit, int firstLine);
+    static void Delete(Unit *unit);
+    bool UsesChanged(const Declared &d, int position,
+                     const unordered_set<const char *> *only);
+    bool Check(size_t numUnits, const vector<bool> &recut,
+               unordered_set<const char *> &changed, const atomic<bool> *cancel);
+
+  public:
+    IncrementalChecker();
+    ~IncrementalChecker();
+
+    // Checks text as the new version of the source, printing its
+    // errors, and returns how many there were. If found is given, the
+    // errors are appended to it instead, the characters the scanner
+    // echoes as well. If *cancel is set while the function bodies are
+    // checked, the rest are left and -1 is returned, with nothing
+    // printed; the next Update() checks them.
+    int Update(const char *text, size_t len, vector<Diagnostic> *found = NULL,
+               const atomic<bool> *cancel = NULL);
+
+    // What the last Update() did again: the pieces it parsed and the
+    // function bodies it checked
+    int NumParsed() const   { return numParsed; }
+    int NumChecked() const  { return numChecked; }
+
+    // Where each node of the last version is, to find the node or the
+    // type of the expression at a position (see ast_index.h). It covers
+    // every declaration parsed, checked or not, and lasts until the next
+    // Update().
+    const AstIndex *Index();
+
+    // Appends the symbols in effect at line:column, innermost first and
+    // once per name: the locals in scope there, if it is in a function
+    // body that was checked with SymbolTable::keepScopes set, then the
+    // globals declared before it. Nothing is checked again.
+    void VisibleAt(int line, int column, vector<const Symbol *> &out);
+
+    const char *LineNumbered(int n);
+};
+
+#endif
@@ -0,0 +1,79 @@
+/* File: intern.cc
+ * ---------------
+ * Implementation of the name table: open addressing over a power-of-two
+ * array, with the text itself packed into large blocks that are never
+ * moved or freed.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include "intern.h"
+#include "utility.h"
+
+struct Atom {
+    const char *text;    // NULL if the slot is empty
+    unsigned hash;
+    int length;
+};
+
+static const int InitialSlots = 1024;        // power of two
+static const int BlockSize = 64 * 1024;
+
+static Atom *slots;
+static int numSlots, numAtoms;
+static char *block;       // current block of text storage
+static int blockLeft;     // bytes still free in it
+
+static unsigned HashName(const char *s, int len) {
+    unsigned h = 2166136261u;    // FNV-1a
+    for (int i = 0; i < len; i++)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return h;
+}
+
+// Copies len bytes plus a terminating NUL into the block storage
+static const char *Store(const char *s, int len) {
+    if (len + 1 > blockLeft) {
+        int size = len + 1 > BlockSize ? len + 1 : BlockSize;
+        block = (char *)malloc(size);
+        Assert(block != NULL);
+        blockLeft = size;
+    }
+    char *copy = block;
+    memcpy(copy, s, len);
+    copy[len] = '\0';
+    block += len + 1;
+    blockLeft -= len + 1;
+    return copy;
+}
+
+static void Grow() {
+    Atom *old = slots;
+    int oldSlots = numSlots;
+    numSlots = numSlots ? numSlots * 2 : InitialSlots;
+    slots = (Atom *)calloc(numSlots, sizeof(Atom));
+    Assert(slots != NULL);
+    for (int i = 0; i < oldSlots; i++) {
+        if (!old[i].text) continue;
+        unsigned j = old[i].hash & (numSlots - 1);
+        while (slots[j].text) j = (j + 1) & (numSlots - 1);
+        slots[j] = old[i];
+    }
+    free(old);
+}
+
+const char *Intern(const char *s, int len) {
+    if (2 * (numAtoms + 1) > numSlots) Grow();
+    unsigned h = HashName(s, len);
+    unsigned i = h & (numSlots - 1);
+    for (; slots[i].text; i = (i + 1) & (numSlots - 1)) {
+        if (slots[i].hash == h && slots[i].length == len &&
+            memcmp(slots[i].text, s, len) == 0)
+            return slots[i].text;
+    }
+    slots[i].text = Store(s, len);
+    slots[i].hash = h;
+    slots[i].length = len;
+    numAtoms++;
+    return slots[i].text;
+}
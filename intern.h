@@ -0,0 +1,21 @@
+/* File: intern.h
+ * --------------
+ * The name table. Both scanners intern every identifier and field
+ * selection they return, so yylval carries a pointer to a single shared,
+ * NUL-terminated copy of the name rather than a fixed-size buffer. The
+ * same spelling always yields the same pointer, and the text lives until
+ * the program exits, so the AST and the symbol table hold on to it
+ * without copying.
+ */
+
+#ifndef _H_intern
+#define _H_intern
+
+/* Function: Intern
+ * ----------------
+ * Returns the canonical copy of the len-byte string s, adding it to the
+ * table the first time it is seen. s need not be NUL-terminated.
+ */
+const char *Intern(const char *s, int len);
+
+#endif
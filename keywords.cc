@@ -0,0 +1,133 @@
+/* File: keywords.cc
+ * -----------------
+ * The keyword table and its compile-time perfect hash.
+ */
+
+#include <string.h>
+#include "keywords.h"
+#include "ast_type.h"
+#include "parser.h" // for token codes, YYSTYPE
+
+/* Keyword table
+ * -------------
+ * The types the grammar accepts wherever a type name may appear share the
+ * T_TypeName token; void and the integer/boolean vector types keep their
+ * own tokens because the grammar treats them specially.
+ */
+static constexpr Keyword keywords[] = {
+    {"void", 4, T_Void, &Type::voidType},
+    {"int", 3, T_TypeName, &Type::intType},
+    {"float", 5, T_TypeName, &Type::floatType},
+    {"bool", 4, T_TypeName, &Type::boolType},
+    {"vec2", 4, T_TypeName, &Type::vec2Type},
+    {"vec3", 4, T_TypeName, &Type::vec3Type},
+    {"vec4", 4, T_TypeName, &Type::vec4Type},
+    {"mat2", 4, T_TypeName, &Type::mat2Type},
+    {"mat3", 4, T_TypeName, &Type::mat3Type},
+    {"mat4", 4, T_TypeName, &Type::mat4Type},
+    {"ivec2", 5, T_Ivec2, &Type::ivec2Type},
+    {"ivec3", 5, T_Ivec3, &Type::ivec3Type},
+    {"ivec4", 5, T_Ivec4, &Type::ivec4Type},
+    {"bvec2", 5, T_Bvec2, &Type::bvec2Type},
+    {"bvec3", 5, T_Bvec3, &Type::bvec3Type},
+    {"bvec4", 5, T_Bvec4, &Type::bvec4Type},
+    {"uint", 4, T_Uint, &Type::uintType},
+    {"uvec2", 5, T_Uvec2, &Type::uvec2Type},
+    {"uvec3", 5, T_Uvec3, &Type::uvec3Type},
+    {"uvec4", 5, T_Uvec4, &Type::uvec4Type},
+    {"while", 5, T_While, NULL},
+    {"for", 3, T_For, NULL},
+    {"if", 2, T_If, NULL},
+    {"else", 4, T_Else, NULL},
+    {"return", 6, T_Return, NULL},
+    {"break", 5, T_Break, NULL},
+    {"switch", 6, T_Switch, NULL},
+    {"case", 4, T_Case, NULL},
+    {"default", 7, T_Default, NULL},
+    {"const", 5, T_Const, NULL},
+    {"uniform", 7, T_Uniform, NULL},
+    {"continue", 8, T_Continue, NULL},
+    {"do", 2, T_Do, NULL},
+    {"in", 2, T_In, NULL},
+    {"out", 3, T_Out, NULL},
+    {"true", 4, T_BoolConstant, NULL},
+    {"false", 5, T_BoolConstant, NULL},
+};
+
+static constexpr int NumKeywords = sizeof(keywords) / sizeof(keywords[0]);
+static constexpr int TableSize = 128;    // power of two, > 2 * NumKeywords
+
+static constexpr int MaxKeywordLength() {
+    int max = 0;
+    for (int i = 0; i < NumKeywords; i++)
+        if (keywords[i].length > max) max = keywords[i].length;
+    return max;
+}
+
+// FNV-1a, perturbed by the seed the table search settles on
+static constexpr unsigned Hash(const char *s, int len, unsigned seed) {
+    unsigned h = 2166136261u ^ seed;
+    for (int i = 0; i < len; i++)
+        h = (h ^ (unsigned char)s[i]) * 16777619u;
+    return (h ^ (h >> 15)) & (TableSize - 1);
+}
+
+struct HashTable {
+    unsigned seed;
+    signed char slots[TableSize];    // index into keywords, or -1
+};
+
+/* Function: BuildTable
+ * --------------------
+ * Runs at compile time: tries seeds until every keyword hashes to its
+ * own slot.
+ */
+static constexpr HashTable BuildTable() {
+    HashTable table = {0, {}};
+    for (unsigned seed = 1; seed < 100000; seed++) {
+        for (int i = 0; i < TableSize; i++) table.slots[i] = -1;
+        bool perfect = true;
+        for (int i = 0; i < NumKeywords && perfect; i++) {
+            unsigned h = Hash(keywords[i].name, keywords[i].length, seed);
+            if (table.slots[h] != -1) perfect = false;
+            else table.slots[h] = i;
+        }
+        if (perfect) {
+            table.seed = seed;
+            return table;
+        }
+    }
+    return table;
+}
+
+static constexpr HashTable table = BuildTable();
+static constexpr int maxLength = MaxKeywordLength();
+
+static_assert(table.seed != 0, "no perfect hash seed for the keyword table");
+
+static constexpr bool LengthsMatch() {
+    for (int i = 0; i < NumKeywords; i++) {
+        int len = 0;
+        while (keywords[i].name[len]) len++;
+        if (len != keywords[i].length) return false;
+    }
+    return true;
+}
+static_assert(LengthsMatch(), "keyword table length column is wrong");
+
+
+const Keyword *LookupKeyword(const char *s, int len) {
+    if (len > maxLength) return NULL;
+    int i = table.slots[Hash(s, len, table.seed)];
+    if (i < 0 || keywords[i].length != len || memcmp(keywords[i].name, s, len) != 0)
+        return NULL;
+    return &keywords[i];
+}
+
+int ClassifyIdentifier(const char *s, int len, YYSTYPE *value) {
+    const Keyword *kw = LookupKeyword(s, len);
+    if (!kw) return 0;
+    if (kw->type) value->typeDecl = *kw->type;
+    else if (kw->token == T_BoolConstant) value->boolConstant = (s[0] == 't');
+    return kw->token;
+}
@@ -0,0 +1,43 @@
+/* File: keywords.h
+ * ----------------
+ * Recognition of reserved words for both scanners. Identifiers are
+ * matched by a single generic rule and then classified here, which keeps
+ * the keywords out of the flex DFA. The table is indexed by a perfect
+ * hash computed at compile time, so a lookup costs one hash of the
+ * lexeme and at most one comparison.
+ *
+ * Type keywords carry their canonical Type object, which the scanner
+ * hands to the parser in the typeDecl field of the token's value. Adding a keyword or a type
+ * accepted wherever a type name is (T_TypeName) only takes a new row in
+ * the table in keywords.cc.
+ */
+
+#ifndef _H_keywords
+#define _H_keywords
+
+class Type;
+union YYSTYPE;
+
+struct Keyword {
+    const char *name;
+    int length;
+    int token;
+    Type **type;     // NULL unless this is a type keyword
+};
+
+/* Function: LookupKeyword
+ * -----------------------
+ * Returns the keyword entry for the len-byte lexeme s, or NULL if the
+ * lexeme is an ordinary identifier.
+ */
+const Keyword *LookupKeyword(const char *s, int len);
+
+/* Function: ClassifyIdentifier
+ * ----------------------------
+ * Returns the token code for a keyword lexeme and sets *value for it
+ * (the Type for type keywords, the value for true/false), or 0 if s is
+ * an ordinary identifier.
+ */
+int ClassifyIdentifier(const char *s, int len, YYSTYPE *value);
+
+#endif
@@ -3,10 +3,8 @@
  * ------------
  * Simple list class for storing a linear collection of elements. It
  * supports operations similar in name to the CS107 CVector -- nth, insert,
- * append, remove, etc.  This class is nothing more than a very thin
- * cover of a STL deque, with some added range-checking. Given not everyone
- * is familiar with the C++ templates, this class provides a more familiar
- * interface.
+ * append, remove, etc.  Given not everyone is familiar with the C++
+ * templates, this class provides a more familiar interface.
  *
  * It can handle elements of any type, the typename for a List includes the
  * element type in angle brackets, e.g.  to store elements of type double,
@@ -17,72 +15,139 @@
  *
  *   int Sum(List<int> *list) {
  *       int sum = 0;
- *       for (int i = 0; i < list->NumElements(); i++) {
- *          int val = list->Nth(i);
+ *       for (int val : *list)
  *          sum += val;
- *       }
  *       return sum;
  *    }
+ *
+ * Storage: almost every list in a parse (arguments, formals, the
+ * statements of a block) has between zero and three elements, so the
+ * first InlineCapacity elements are kept inside the List object itself
+ * and only longer lists allocate. The elements sit in one array with
+ * free room at both ends, which keeps InsertAt(elem, 0) as cheap as
+ * Append. Elements are moved with memmove, so they must be trivially
+ * copyable (pointers, ints and the like). Indexes are only range-checked
+ * in debug builds (see DebugAssert).
  */
 
 #ifndef _H_list
 #define _H_list
 
-#include <deque>
+#include <string.h>
+#include <new>
+#include <type_traits>
+#include <vector>
 #include "utility.h"  // for Assert()
 using namespace std;
 
 class Node;
+struct Child;
 
 template<class Element> class List {
 
  private:
-    deque<Element> elems;
+    static const int InlineCapacity = 4;
+
+    Element *elems;       // inlineElems, or an array from operator new
+    int first;            // the index in elems of element 0
+    int count, capacity;
+    Element inlineElems[InlineCapacity];
+
+    static_assert(is_trivially_copyable<Element>::value,
+                  "List elements are moved with memmove");
+
+          // Makes room for one more element at the front or the back,
+          // moving the elements to the middle of the array (growing it
+          // if it is three quarters full) when that end is full
+    void MakeRoom(bool atFront)
+	{ if (atFront ? first > 0 : first + count < capacity) return;
+	  Element *to = elems;
+	  int newCapacity = capacity;
+	  if (4 * count >= 3 * capacity) {
+	      newCapacity = 2 * capacity;
+	      to = (Element *)::operator new(newCapacity * sizeof(Element));
+	  }
+	  int room = newCapacity - count;
+	  int newFirst = atFront ? room - room / 2 : room / 2;
+	  memmove(to + newFirst, elems + first, count * sizeof(Element));
+	  if (to != elems && elems != inlineElems) ::operator delete(elems);
+	  elems = to;
+	  first = newFirst;
+	  capacity = newCapacity; }
 
  public:
            // Create a new empty list
-    List() {}
+    List() : elems(inlineElems), first(0), count(0), capacity(InlineCapacity) {}
+    ~List()
+	{ if (elems != inlineElems) ::operator delete(elems); }
+
+           // Lists are shared by pointer, never copied
+    List(const List &) = delete;
+    List &operator=(const List &) = delete;
 
            // Returns count of elements currently in list
     int NumElements() const
-	{ return elems.size(); }
+	{ return count; }
 
           // Returns element at index in list. Indexing is 0-based.
-          // Raises an assert if index is out of range.
+          // Raises an assert in debug builds if index is out of range.
     Element Nth(int index) const
-	{ Assert(index >= 0 && index < NumElements());
-	  return elems[index]; }
+	{ DebugAssert(index >= 0 && index < count);
+	  return elems[first + index]; }
 
-          // Inserts element at index, shuffling over others
-          // Raises assert if index out of range
+          // Inserts element at index, shuffling over the elements on
+          // whichever side of it is shorter
+          // Raises an assert in debug builds if index out of range
     void InsertAt(const Element &elem, int index)
-	{ Assert(index >= 0 && index <= NumElements());
-	  elems.insert(elems.begin() + index, elem); }
+	{ DebugAssert(index >= 0 && index <= count);
+	  if (index < count / 2) {
+	      MakeRoom(true);
+	      first--;
+	      memmove(elems + first, elems + first + 1, index * sizeof(Element));
+	  } else {
+	      MakeRoom(false);
+	      memmove(elems + first + index + 1, elems + first + index,
+	              (count - index) * sizeof(Element));
+	  }
+	  elems[first + index] = elem;
+	  count++; }
 
           // Adds element to list end
     void Append(const Element &elem)
-	{ elems.push_back(elem); }
+	{ MakeRoom(false);
+	  elems[first + count++] = elem; }
 
          // Removes element at index, shuffling down others
-         // Raises assert if index out of range
+         // Raises an assert in debug builds if index out of range
     void RemoveAt(int index)
-	{ Assert(index >= 0 && index < NumElements());
-	  elems.erase(elems.begin() + index); }
-          
+	{ DebugAssert(index >= 0 && index < count);
+	  memmove(elems + first + index, elems + first + index + 1,
+	          (count - index - 1) * sizeof(Element));
+	  count--; }
+
+          // Range-for support: for (Decl *d : *decls) ...
+    Element *begin()             { return elems + first; }
+    Element *end()               { return elems + first + count; }
+    const Element *begin() const { return elems + first; }
+    const Element *end() const   { return elems + first + count; }
+
        // These are some specific methods useful for lists of ast nodes
        // They will only work on lists of elements that respond to the
        // messages, but since C++ only instantiates the template if you use
-       // you can still have Lists of ints, chars*, as long as you 
+       // you can still have Lists of ints, chars*, as long as you
        // don't try to SetParentAll on that list.
     void SetParentAll(Node *p)
-        { for (int i = 0; i < NumElements(); i++)
-             Nth(i)->SetParent(p); }
-    void PrintAll(int indentLevel, const char *label = NULL)
-        { for (int i = 0; i < NumElements(); i++)
-             Nth(i)->Print(indentLevel, label); }
-             
+        { for (Element e : *this)
+             e->SetParent(p); }
+    void AddChildren(vector<Child> &children, const char *label = NULL)
+        { for (Element e : *this)
+             children.push_back(Child(e, label)); }
+    void DeleteAll()
+        { for (Element e : *this)
+             e->DeleteChild(e);    // see Node::DeleteChild
+          count = 0; }
+
 
 };
 
 #endif
-
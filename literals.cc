@@ -0,0 +1,54 @@
+/* File: literals.cc
+ * -----------------
+ * Implementation of the numeric literal conversions.
+ */
+
+#include <charconv>
+#include <float.h>
+#include <stdint.h>
+#include <string>
+#include "literals.h"
+#include "errors.h"
+#include "parser.h" // for token codes, YYSTYPE
+
+using namespace std;
+
+int ConvertIntConstant(const char *s, int len, YYSTYPE *value, yyltype *loc) {
+    const char *end = s + len;
+    int base = 10;
+    if (len > 2 && s[0] == '0' && (s[1] == 'x' || s[1] == 'X')) {
+        base = 16;
+        s += 2;
+    }
+    uint32_t bits = 0;
+    from_chars_result r = from_chars(s, end, bits, base);
+    if (r.ec != errc()) {
+        ReportError::ConstantOutOfRange(loc, string(end - len, end).c_str());
+        bits = 0;
+    }
+    value->integerConstant = (int)bits;
+    return T_IntConstant;
+}
+
+int ConvertFloatConstant(const char *s, int len, YYSTYPE *value, yyltype *loc) {
+    const char *end = s + len;
+    if (end[-1] == 'f' || end[-1] == 'F') end--;
+    double d = 0;
+    from_chars_result r = from_chars(s, end, d, chars_format::fixed);
+    if (r.ec == errc::result_out_of_range) {
+        // There is no exponent, so only a nonzero integer part can overflow;
+        // anything else is too small to represent and rounds to zero
+        bool overflow = false;
+        for (const char *p = s; p < end && *p != '.'; p++)
+            if (*p != '0') overflow = true;
+        if (overflow)
+            ReportError::ConstantOutOfRange(loc, string(s, len).c_str());
+        d = 0;
+    } else if (d > FLT_MAX) {
+        // A float is 32 bits, whatever the double holding it can take
+        ReportError::ConstantOutOfRange(loc, string(s, len).c_str());
+        d = 0;
+    }
+    value->floatConstant = d;
+    return T_FloatConstant;
+}
@@ -0,0 +1,34 @@
+/* File: literals.h
+ * ----------------
+ * Conversion of numeric literals for both scanners. The conversions use
+ * std::from_chars, so they do not depend on the C locale and never copy
+ * the lexeme. A literal that does not fit its type is reported and the
+ * token carries 0.
+ *
+ * Following the GLSL rules, an integer literal only needs its bit
+ * pattern to fit in 32 bits: 4294967295 and 0xFFFFFFFF are both -1.
+ * A float literal must not be larger than FLT_MAX.
+ */
+
+#ifndef _H_literals
+#define _H_literals
+
+#include "location.h"
+
+union YYSTYPE;
+
+/* Function: ConvertIntConstant
+ * ----------------------------
+ * Sets value->integerConstant from the len-byte {INTEGER} or
+ * {HEX_INTEGER} lexeme s, matched at loc, and returns T_IntConstant.
+ */
+int ConvertIntConstant(const char *s, int len, YYSTYPE *value, yyltype *loc);
+
+/* Function: ConvertFloatConstant
+ * ------------------------------
+ * Sets value->floatConstant from the len-byte {FLOAT} lexeme s, which
+ * may end in an f suffix, and returns T_FloatConstant.
+ */
+int ConvertFloatConstant(const char *s, int len, YYSTYPE *value, yyltype *loc);
+
+#endif
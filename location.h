@@ -16,13 +16,15 @@
  */
 typedef struct yyltype
 {
-    int timestamp;                 // you can ignore this field
+    int file;                      // 0 for the input, or a file it
+                                   // included (see preprocess.h)
     int first_line, first_column;
     int last_line, last_column;      
     char *text;                    // you can also ignore this field
 } yyltype;
 
 #define YYLTYPE yyltype
+#define YYLTYPE_IS_TRIVIAL 1    // lets the parser grow its stacks
 
 
 /* Global variable: yylloc
@@ -41,6 +43,7 @@ extern struct yyltype yylloc;
 inline yyltype Join(yyltype first, yyltype last)
 {
   yyltype combined;
+  combined.file = first.file;
   combined.first_column = first.first_column;
   combined.first_line = first.first_line;
   combined.last_column = last.last_column;
@@ -0,0 +1,763 @@
+/* File: lsp.cc
+ * ------------
+ * Implementation of glc --lsp (see lsp.h): a small JSON reader and
+ * writer, the base protocol's framing, the open documents and the loop
+ * that checks them.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <sstream>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include "lsp.h"
+#include "errors.h"
+#include "incremental.h"
+#include "ast_index.h"
+#include "ast_expr.h"
+#include "ast_decl.h"
+#include "symtable.h"
+#include "utility.h"
+
+using namespace std;
+
+typedef chrono::steady_clock Clock;
+
+/* A JSON value, as parsed from a message. Objects keep their members in
+ * order; Get() finds one by key.
+ */
+struct Json {
+    enum Kind { Null, Bool, Number, String, Array, Object };
+    Kind kind;
+    bool boolean;
+    double number;
+    string text;                              // a String
+    vector<Json*> elems;                      // an Array
+    vector< pair<string, Json*> > members;    // an Object
+
+    Json(Kind k) : kind(k), boolean(false), number(0) {}
+    ~Json() {
+        for (Json *e : elems) delete e;
+        for (auto &m : members) delete m.second;
+    }
+    Json(const Json &) = delete;
+    Json &operator=(const Json &) = delete;
+
+    // The member named key, or NULL if this is not an object or has none
+    const Json *Get(const char *key) const {
+        if (kind == Object)
+            for (const auto &m : members)
+                if (m.first == key) return m.second;
+        return NULL;
+    }
+};
+
+// The string or number at key in value, or def if there is none
+static const char *GetString(const Json *value, const char *key, const char *def = NULL)
+{
+    const Json *v = value ? value->Get(key) : NULL;
+    return v && v->kind == Json::String ? v->text.c_str() : def;
+}
+
+static double GetNumber(const Json *value, const char *key, double def = 0)
+{
+    const Json *v = value ? value->Get(key) : NULL;
+    return v && v->kind == Json::Number ? v->number : def;
+}
+
+/* Class: JsonReader
+ * -----------------
+ * Parses one JSON text. Parse() returns NULL if it is malformed, or
+ * nested deeper than MaxDepth.
+ */
+class JsonReader {
+    static const int MaxDepth = 64;
+    const char *p, *end;
+    int depth;
+
+    void SkipSpace() {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r')) p++;
+    }
+    bool Literal(const char *word) {
+        size_t len = strlen(word);
+        if ((size_t)(end - p) < len || memcmp(p, word, len) != 0) return false;
+        p += len;
+        return true;
+    }
+    static void AppendUtf8(string &s, unsigned c) {
+        if (c < 0x80) {
+            s += (char)c;
+        } else if (c < 0x800) {
+            s += (char)(0xC0 | c >> 6);
+            s += (char)(0x80 | (c & 0x3F));
+        } else if (c < 0x10000) {
+            s += (char)(0xE0 | c >> 12);
+            s += (char)(0x80 | (c >> 6 & 0x3F));
+            s += (char)(0x80 | (c & 0x3F));
+        } else {
+            s += (char)(0xF0 | c >> 18);
+            s += (char)(0x80 | (c >> 12 & 0x3F));
+            s += (char)(0x80 | (c >> 6 & 0x3F));
+            s += (char)(0x80 | (c & 0x3F));
+        }
+    }
+    bool Hex4(unsigned *c) {
+        if (end - p < 4) return false;
+        *c = 0;
+        for (int i = 0; i < 4; i++, p++) {
+            char h = *p;
+            int digit = h >= '0' && h <= '9' ? h - '0' :
+                        h >= 'a' && h <= 'f' ? h - 'a' + 10 :
+                        h >= 'A' && h <= 'F' ? h - 'A' + 10 : -1;
+            if (digit < 0) return false;
+            *c = *c << 4 | digit;
+        }
+        return true;
+    }
+    bool StringBody(string &s) {       // after the opening quote
+        while (p < end && *p != '"') {
+            if ((unsigned char)*p < 0x20) return false;
+            if (*p != '\\') {
+                const char *run = p;
+                while (p < end && *p != '"' && *p != '\\' && (unsigned char)*p >= 0x20) p++;
+                s.append(run, p - run);
+                continue;
+            }
+            if (++p == end) return false;
+            switch (*p++) {
+              case '"': s += '"'; break;
+              case '\\': s += '\\'; break;
+              case '/': s += '/'; break;
+              case 'b': s += '\b'; break;
+              case 'f': s += '\f'; break;
+              case 'n': s += '\n'; break;
+              case 'r': s += '\r'; break;
+              case 't': s += '\t'; break;
+              case 'u': {
+                unsigned c, low;
+                if (!Hex4(&c)) return false;
+                if (c >= 0xD800 && c < 0xDC00 && end - p >= 6 && p[0] == '\\' && p[1] == 'u') {
+                    const char *back = p;
+                    p += 2;
+                    if (Hex4(&low) && low >= 0xDC00 && low < 0xE000)
+                        c = 0x10000 + ((c - 0xD800) << 10) + (low - 0xDC00);
+                    else
+                        p = back;
+                }
+                AppendUtf8(s, c);
+                break;
+              }
+              default:
+                return false;
+            }
+        }
+        if (p == end) return false;
+        p++;
+        return true;
+    }
+    Json *Value() {
+        SkipSpace();
+        if (p == end || depth > MaxDepth) return NULL;
+        Json *v = NULL;
+        switch (*p) {
+          case 'n':
+            if (Literal("null")) v = new Json(Json::Null);
+            break;
+          case 't':
+          case 'f': {
+            bool isTrue = Literal("true");
+            if (isTrue || Literal("false")) {
+                v = new Json(Json::Bool);
+                v->boolean = isTrue;
+            }
+            break;
+          }
+          case '"':
+            p++;
+            v = new Json(Json::String);
+            if (!StringBody(v->text)) {
+                delete v;
+                v = NULL;
+            }
+            break;
+          case '[':
+          case '{': {
+            bool object = (*p++ == '{');
+            depth++;
+            v = new Json(object ? Json::Object : Json::Array);
+            SkipSpace();
+            if (p < end && *p == (object ? '}' : ']')) {
+                p++;
+            } else {
+                for (;;) {
+                    string key;
+                    if (object) {
+                        SkipSpace();
+                        if (p == end || *p++ != '"' || !StringBody(key)) break;
+                        SkipSpace();
+                        if (p == end || *p++ != ':') break;
+                    }
+                    Json *elem = Value();
+                    if (!elem) break;
+                    if (object) v->members.push_back(make_pair(key, elem));
+                    else v->elems.push_back(elem);
+                    SkipSpace();
+                    if (p < end && *p == ',') {
+                        p++;
+                        continue;
+                    }
+                    if (p < end && *p == (object ? '}' : ']')) {
+                        p++;
+                        depth--;
+                        return v;
+                    }
+                    break;
+                }
+                delete v;
+                v = NULL;
+            }
+            depth--;
+            break;
+          }
+          default: {
+            char *after;
+            string digits(p, min<size_t>(end - p, 64));
+            double number = strtod(digits.c_str(), &after);
+            if (after != digits.c_str() && (*p == '-' || (*p >= '0' && *p <= '9'))) {
+                v = new Json(Json::Number);
+                v->number = number;
+                p += after - digits.c_str();
+            }
+          }
+        }
+        return v;
+    }
+
+  public:
+    Json *Parse(const char *text, size_t len) {
+        p = text;
+        end = text + len;
+        depth = 0;
+        Json *v = Value();
+        SkipSpace();
+        if (v && p != end) {
+            delete v;
+            v = NULL;
+        }
+        return v;
+    }
+};
+
+// The bytes in a UTF-8 sequence that starts with lead
+static int SequenceLength(unsigned char lead)
+{
+    return lead < 0xC0 ? 1 : lead < 0xE0 ? 2 : lead < 0xF0 ? 3 : 4;
+}
+
+// Appends s to out as a JSON string literal. A byte that is not part of
+// valid UTF-8 (an error can quote one character of a longer sequence)
+// becomes U+FFFD.
+static void AppendQuoted(string &out, const string &s)
+{
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (size_t i = 0; i < s.size(); i++) {
+        unsigned char c = s[i];
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c < 0x20) {
+            out += "\\u00";
+            out += hex[c >> 4];
+            out += hex[c & 15];
+        } else if (c < 0x80) {
+            out += c;
+        } else {
+            size_t len = SequenceLength(c), n = 1;
+            while (n < len && i + n < s.size() && (s[i+n] & 0xC0) == 0x80) n++;
+            if (c >= 0xC2 && c <= 0xF4 && n == len) {
+                out.append(s, i, len);
+                i += len - 1;
+            } else {
+                out += "\\ufffd";
+            }
+        }
+    }
+    out += '"';
+}
+
+// Appends a request id, a number or a string, as it came
+static void AppendId(string &out, const Json *id)
+{
+    char text[32];
+    if (id && id->kind == Json::String)
+        AppendQuoted(out, id->text);
+    else if (id && id->kind == Json::Number)
+        out.append(text, snprintf(text, sizeof(text), "%.17g", id->number));
+    else
+        out += "null";
+}
+
+
+/* The base protocol: a message is a header of "Name: value" lines, of
+ * which only Content-Length matters here, an empty line, and a JSON body
+ * of that many bytes. Messages are written to out, which is what
+ * standard output was when the server started; standard output itself
+ * is sent to standard error then, so that nothing else (-d messages, a
+ * character the scanner echoes) can get in between.
+ */
+static FILE *out;
+
+static void Send(const string &body)
+{
+    fprintf(out, "Content-Length: %zu\r\n\r\n", body.size());
+    fwrite(body.data(), 1, body.size(), out);
+    fflush(out);
+}
+
+// Reads the body of the next message, returning false at the end of the input
+static bool ReadMessage(FILE *in, string &body)
+{
+    char line[1024];
+    long length = -1;
+    for (;;) {
+        if (!fgets(line, sizeof(line), in)) return false;
+        if (!strcmp(line, "\r\n") || !strcmp(line, "\n")) {
+            if (length >= 0) break;
+            continue;      // no Content-Length: skip to the next header
+        }
+        if (!strncasecmp(line, "Content-Length:", 15))
+            length = strtol(line + 15, NULL, 10);
+    }
+    body.resize(length);
+    return fread(&body[0], 1, length, in) == (size_t)length;
+}
+
+static void Respond(const Json *id, const string &result)
+{
+    string body = "{\"jsonrpc\":\"2.0\",\"id\":";
+    AppendId(body, id);
+    body += ",\"result\":" + result + "}";
+    Send(body);
+}
+
+static void RespondError(const Json *id, int code, const char *message)
+{
+    string body = "{\"jsonrpc\":\"2.0\",\"id\":";
+    AppendId(body, id);
+    body += ",\"error\":{\"code\":" + to_string(code) + ",\"message\":";
+    AppendQuoted(body, message);
+    body += "}}";
+    Send(body);
+}
+
+// JSON-RPC and LSP error codes
+enum { ParseError = -32700, InvalidRequest = -32600, MethodNotFound = -32601,
+       ServerNotInitialized = -32002 };
+
+
+/* Positions: the protocol counts lines from 0 and characters in UTF-16
+ * code units, where glc counts both from 1, and columns in bytes.
+ */
+
+// The offset in text of the start of line (from 0), or of its end if
+// the text has fewer lines
+static size_t LineStart(const string &text, int line)
+{
+    size_t at = 0;
+    for (; line > 0; line--) {
+        const char *nl = (const char *)memchr(text.data() + at, '\n', text.size() - at);
+        if (!nl) return text.size();
+        at = nl + 1 - text.data();
+    }
+    return at;
+}
+
+// The offset in text of a protocol position; one past the end of its
+// line is as far as it goes
+static size_t OffsetOf(const string &text, const Json *position)
+{
+    size_t at = LineStart(text, (int)GetNumber(position, "line"));
+    for (int units = (int)GetNumber(position, "character"); units > 0; ) {
+        if (at >= text.size() || text[at] == '\n') break;
+        int len = SequenceLength(text[at]);
+        units -= (len == 4 ? 2 : 1);
+        at = min(text.size(), at + len);
+    }
+    return at;
+}
+
+// The UTF-16 code units in the first bytes of a line
+static int Utf16Units(const char *line, const char *end, int bytes)
+{
+    int units = 0;
+    for (const char *p = line; p < line + bytes && p < end && *p != '\n'; ) {
+        int len = SequenceLength(*p);
+        units += (len == 4 ? 2 : 1);
+        p += len;
+    }
+    return units;
+}
+
+
+/* An open document: its text as the client last sent it, and the
+ * checker that has checked earlier versions of it.
+ */
+struct Document {
+    string uri;
+    string text;
+    int version;
+    IncrementalChecker checker;
+    bool dirty;                  // changed since it was last checked
+    Clock::time_point due;       // when to check it, if dirty
+};
+
+static map<string, Document*> documents;
+
+// Appends a protocol position for a line and column as glc counts them
+static void AppendPosition(string &json, const string &text, vector<size_t> &lineStarts,
+                           int line, int column)
+{
+    int character = 0;
+    line = max(line, 1);
+    if (lineStarts.empty()) {
+        lineStarts.push_back(0);
+        for (size_t i = 0; i < text.size(); i++)
+            if (text[i] == '\n') lineStarts.push_back(i + 1);
+    }
+    if (line <= (int)lineStarts.size()) {
+        const char *start = text.data() + lineStarts[line-1];
+        character = Utf16Units(start, text.data() + text.size(), max(column, 0));
+    }
+    json += "{\"line\":" + to_string(line - 1) + ",\"character\":" + to_string(character) + "}";
+}
+
+/* Function: Publish
+ * -----------------
+ * Sends the errors found in a document. One with no location (the input
+ * ending inside a comment) is put at the start of the document.
+ */
+static void Publish(Document *doc, const vector<Diagnostic> &found)
+{
+    string body = "{\"jsonrpc\":\"2.0\",\"method\":\"textDocument/publishDiagnostics\","
+                  "\"params\":{\"uri\":";
+    AppendQuoted(body, doc->uri);
+    body += ",\"version\":" + to_string(doc->version) + ",\"diagnostics\":[";
+    vector<size_t> lineStarts;
+    bool first = true;
+    for (const Diagnostic &d : found) {
+        if (d.echo >= 0) continue;
+        if (!first) body += ',';
+        first = false;
+        body += "{\"range\":{\"start\":";
+        if (d.hasLoc && d.loc.first_line > 0) {
+            AppendPosition(body, doc->text, lineStarts, d.loc.first_line, d.loc.first_column - 1);
+            body += ",\"end\":";
+            AppendPosition(body, doc->text, lineStarts, d.loc.last_line, d.loc.last_column);
+        } else {
+            body += "{\"line\":0,\"character\":0},\"end\":{\"line\":0,\"character\":0}";
+        }
+        body += "},\"severity\":1,\"source\":\"glc\",\"message\":";
+        AppendQuoted(body, d.msg);
+        body += '}';
+    }
+    body += "]}}";
+    Send(body);
+}
+
+
+/* Messages are read on their own thread into inbox (NULL for one that
+ * is not valid JSON), so that a change can cancel the check of the
+ * document it is for while the check runs.
+ */
+static mutex inboxLock;
+static condition_variable arrived;
+static deque<Json*> inbox;
+static bool inputEnded;
+static string checking;              // the uri of the document being checked
+static atomic<bool> cancelCheck;
+
+static void ReadMessages()
+{
+    JsonReader reader;
+    string body;
+    while (ReadMessage(stdin, body)) {
+        Json *message = reader.Parse(body.data(), body.size());
+        const char *method = GetString(message, "method", "");
+        const Json *params = message ? message->Get("params") : NULL;
+        const char *uri = GetString(params ? params->Get("textDocument") : NULL, "uri", "");
+        lock_guard<mutex> guard(inboxLock);
+        if ((!strcmp(method, "textDocument/didChange") || !strcmp(method, "textDocument/didClose"))
+            && checking == uri)
+            cancelCheck = true;
+        inbox.push_back(message);
+        arrived.notify_one();
+    }
+    lock_guard<mutex> guard(inboxLock);
+    inputEnded = true;
+    arrived.notify_one();
+}
+
+// Applies the contentChanges of a didChange in order
+static void ApplyChanges(Document *doc, const Json *changes)
+{
+    if (!changes || changes->kind != Json::Array) return;
+    for (const Json *change : changes->elems) {
+        const char *text = GetString(change, "text", "");
+        const Json *range = change->Get("range");
+        if (range == NULL) {
+            doc->text = text;
+            continue;
+        }
+        size_t start = OffsetOf(doc->text, range->Get("start"));
+        size_t end = max(start, OffsetOf(doc->text, range->Get("end")));
+        doc->text.replace(start, end - start, text);
+    }
+}
+
+// The dirty document due first, or NULL if none is
+static Document *NextDue()
+{
+    Document *next = NULL;
+    for (auto &entry : documents)
+        if (entry.second->dirty && (!next || entry.second->due < next->due))
+            next = entry.second;
+    return next;
+}
+
+/* Function: Check
+ * ---------------
+ * Checks a document and publishes its errors, unless a change to it
+ * came in the meantime; then it stays dirty, and the change puts off
+ * the next check.
+ */
+static void Check(Document *doc)
+{
+    vector<Diagnostic> found;
+    int errors = doc->checker.Update(doc->text.data(), doc->text.size(), &found, &cancelCheck);
+    {
+        lock_guard<mutex> guard(inboxLock);
+        checking.clear();
+    }
+    if (errors < 0) return;
+    doc->dirty = false;
+    Publish(doc, found);
+}
+
+/* Function: CheckedAt
+ * -------------------
+ * Finds the line and column glc counts for a protocol position in a
+ * document, checking the document first if it changed since it was last
+ * checked, so that an answer about the position is about the text the
+ * client has.
+ */
+static void CheckedAt(Document *doc, const Json *position, int &line, int &column)
+{
+    if (doc->dirty) {
+        {
+            lock_guard<mutex> guard(inboxLock);
+            checking = doc->uri;
+            cancelCheck = false;
+        }
+        Check(doc);
+    }
+    size_t at = OffsetOf(doc->text, position);
+    int fromZero = (int)GetNumber(position, "line");
+    line = fromZero + 1;
+    column = at - LineStart(doc->text, fromZero) + 1;
+}
+
+/* Function: Hover
+ * ---------------
+ * Answers a hover request with the type of the innermost checked
+ * expression at the position, and its range, or null if there is none.
+ */
+static void Hover(Document *doc, const Json *id, const Json *position)
+{
+    int line, column;
+    CheckedAt(doc, position, line, column);
+    Expr *expr = doc->checker.Index()->ExprAt(line, column);
+    if (!expr) {
+        Respond(id, "null");
+        return;
+    }
+    ostringstream type;
+    type << expr->type;
+    string result = "{\"contents\":{\"kind\":\"plaintext\",\"value\":";
+    AppendQuoted(result, type.str());
+    result += "},\"range\":{\"start\":";
+    vector<size_t> lineStarts;
+    yyltype *loc = expr->GetLocation();
+    AppendPosition(result, doc->text, lineStarts, loc->first_line, loc->first_column - 1);
+    result += ",\"end\":";
+    AppendPosition(result, doc->text, lineStarts, loc->last_line, loc->last_column);
+    result += "}}";
+    Respond(id, result);
+}
+
+// CompletionItemKind
+enum { FunctionItem = 3, VariableItem = 6 };
+
+/* Function: Complete
+ * ------------------
+ * Answers a completion request with every name in scope at the
+ * position, innermost first, each with its type as the detail; the
+ * client narrows the list down to what has been typed.
+ */
+static void Complete(Document *doc, const Json *id, const Json *position)
+{
+    int line, column;
+    CheckedAt(doc, position, line, column);
+    vector<const Symbol *> visible;
+    doc->checker.VisibleAt(line, column, visible);
+    string result = "{\"isIncomplete\":false,\"items\":[";
+    for (size_t i = 0; i < visible.size(); i++) {
+        FnDecl *fn = dynamic_cast<FnDecl*>(visible[i]->decl);
+        VarDecl *var = dynamic_cast<VarDecl*>(visible[i]->decl);
+        Type *type = fn ? fn->GetType() : var ? var->GetType() : NULL;
+        if (i) result += ',';
+        result += "{\"label\":";
+        AppendQuoted(result, visible[i]->name);
+        result += ",\"kind\":" + to_string(fn ? FunctionItem : VariableItem);
+        if (type) {
+            ostringstream detail;
+            detail << type;
+            result += ",\"detail\":";
+            AppendQuoted(result, detail.str());
+        }
+        // keeps the client's order, innermost first
+        char sortText[24];
+        snprintf(sortText, sizeof(sortText), "%08zu", i);
+        result += ",\"sortText\":\"" + string(sortText) + "\"}";
+    }
+    result += "]}";
+    Respond(id, result);
+}
+
+/* Function: Handle
+ * ----------------
+ * Acts on one message. Returns false once the client has sent exit.
+ */
+static bool initialized, shutdownAsked;
+static chrono::milliseconds debounce;
+
+static bool Handle(const Json *message)
+{
+    if (message == NULL || message->kind != Json::Object) {
+        RespondError(NULL, message ? InvalidRequest : ParseError,
+                     message ? "Invalid request" : "Parse error");
+        return true;
+    }
+    const char *method = GetString(message, "method", "");
+    const Json *id = message->Get("id");
+    const Json *params = message->Get("params");
+    const Json *textDocument = params ? params->Get("textDocument") : NULL;
+    string uri = GetString(textDocument, "uri", "");
+
+    if (!strcmp(method, "exit"))
+        return false;
+    if (!strcmp(method, "initialize")) {
+        initialized = true;
+        Respond(id, "{\"capabilities\":{\"textDocumentSync\":{\"openClose\":true,\"change\":2},"
+                    "\"hoverProvider\":true,\"completionProvider\":{}},"
+                    "\"serverInfo\":{\"name\":\"glc\"}}");
+    } else if (!initialized || shutdownAsked) {
+        if (id) RespondError(id, initialized ? InvalidRequest : ServerNotInitialized,
+                             initialized ? "Shut down" : "Not initialized");
+    } else if (!strcmp(method, "shutdown")) {
+        shutdownAsked = true;
+        Respond(id, "null");
+    } else if (!strcmp(method, "textDocument/didOpen")) {
+        Document *&doc = documents[uri];
+        if (!doc) doc = new Document;
+        doc->uri = uri;
+        doc->text = GetString(textDocument, "text", "");
+        doc->version = (int)GetNumber(textDocument, "version");
+        doc->dirty = true;
+        doc->due = Clock::now();
+    } else if (!strcmp(method, "textDocument/didChange")) {
+        auto it = documents.find(uri);
+        if (it == documents.end()) return true;
+        Document *doc = it->second;
+        ApplyChanges(doc, params->Get("contentChanges"));
+        doc->version = (int)GetNumber(textDocument, "version", doc->version);
+        doc->dirty = true;
+        doc->due = Clock::now() + debounce;
+    } else if (!strcmp(method, "textDocument/didClose")) {
+        auto it = documents.find(uri);
+        if (it == documents.end()) return true;
+        Document *doc = it->second;
+        documents.erase(it);
+        doc->version = 0;
+        Publish(doc, vector<Diagnostic>());     // clears them in the client
+        delete doc;
+    } else if (!strcmp(method, "textDocument/hover")) {
+        auto it = documents.find(uri);
+        if (it == documents.end()) Respond(id, "null");
+        else Hover(it->second, id, params->Get("position"));
+    } else if (!strcmp(method, "textDocument/completion")) {
+        auto it = documents.find(uri);
+        if (it == documents.end()) Respond(id, "null");
+        else Complete(it->second, id, params->Get("position"));
+    } else if (id) {
+        RespondError(id, MethodNotFound, "Method not found");
+    }
+    return true;
+}
+
+int ServeLsp()
+{
+    const char *ms = GetOption("lsp-debounce");
+    debounce = chrono::milliseconds(ms ? atoi(ms) : 150);
+    SymbolTable::keepScopes = true;     // for completion
+    int protocol = dup(STDOUT_FILENO);
+    if (protocol < 0 || !(out = fdopen(protocol, "wb")))
+        Failure("Cannot keep standard output for the protocol");
+    fflush(stdout);
+    dup2(STDERR_FILENO, STDOUT_FILENO);
+    thread(ReadMessages).detach();    // left blocked in a read at exit
+
+    for (;;) {
+        Json *message = NULL;
+        Document *doc = NULL;
+        {
+            unique_lock<mutex> guard(inboxLock);
+            for (;;) {
+                if (!inbox.empty()) {
+                    message = inbox.front();
+                    inbox.pop_front();
+                    break;
+                }
+                doc = NextDue();
+                if (doc && doc->due <= Clock::now()) {
+                    checking = doc->uri;
+                    cancelCheck = false;
+                    break;
+                }
+                doc = NULL;
+                if (inputEnded) return shutdownAsked ? 0 : 1;
+                if (Document *next = NextDue()) arrived.wait_until(guard, next->due);
+                else arrived.wait(guard);
+            }
+        }
+        if (doc) {
+            Check(doc);
+            continue;
+        }
+        bool more = Handle(message);
+        delete message;
+        if (!more) return shutdownAsked ? 0 : 1;
+    }
+}
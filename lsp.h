@@ -0,0 +1,36 @@
+/* File: lsp.h
+ * -----------
+ * glc --lsp serves the Language Server Protocol over standard input and
+ * output, so that an editor keeps one glc running and has each open
+ * shader checked as it is edited, instead of starting glc on every save.
+ *
+ * The server handles initialize, shutdown and exit, and the
+ * textDocument/didOpen, didChange and didClose notifications,
+ * textDocument/hover, which it answers with the type of the expression
+ * under the cursor (see ast_index.h), and textDocument/completion, which
+ * it answers with the names in scope there (see SavedScope in
+ * symtable.h). Changes may send the whole text or only the ranges
+ * edited. Each open document
+ * has its own IncrementalChecker (see incremental.h), so a check after
+ * an edit only does again what the edit touched. The errors glc would
+ * print are sent back with textDocument/publishDiagnostics.
+ *
+ * Edits usually come in bursts, one per keystroke, so a document is
+ * checked once no change to it has come for --lsp-debounce=<ms>
+ * milliseconds (150 by default). Messages are read on a thread of their
+ * own: when a change comes for the document being checked, the check is
+ * given up, and the document is checked again once the changes stop.
+ */
+
+#ifndef _H_lsp
+#define _H_lsp
+
+/* Function: ServeLsp
+ * ------------------
+ * Serves the protocol until the client sends exit or closes standard
+ * input. Returns the exit status: 0 if shutdown was asked for first,
+ * 1 otherwise. InitScanner() and InitParser() must have been called.
+ */
+int ServeLsp();
+
+#endif
@@ -6,25 +6,232 @@
  
 #include <string.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
 #include "utility.h"
 #include "errors.h"
 #include "parser.h"
+#include "bast.h"
+#include "incremental.h"
+#include "ast_index.h"
+#include "ast_expr.h"
+#include "ast_decl.h"
+#include "symtable.h"
+#include "lsp.h"
+#include "prelude.h"
 
 
+/* Function: PushParseInput()
+ * ---------------------------
+ * Parses standard input with the push parser, handing over whatever
+ * each read() returns (at most chunkSize bytes), so diagnostics appear
+ * while a pipe is still being written.
+ */
+static void PushParseInput(size_t chunkSize)
+{
+    char *chunk = (char *)malloc(chunkSize);
+    if (!chunk) Failure("Out of memory reading input");
+    StartPushParse();
+    ssize_t n;
+    while ((n = read(STDIN_FILENO, chunk, chunkSize)) > 0)
+        if (!PushInput(chunk, n)) break;
+    FinishPushParse();
+    free(chunk);
+}
+
+// Appends everything f holds to text
+static void ReadAll(FILE *f, string &text)
+{
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        text.append(chunk, n);
+}
+
+/* Function: RecheckInput()
+ * ------------------------
+ * --recheck=<file>[,<file>...] checks standard input, then each file in
+ * turn as an edited version of what came before it, with one
+ * IncrementalChecker, printing the errors of every version. Returns the
+ * number of errors in the last one.
+ */
+static int RecheckInput(const char *paths)
+{
+    IncrementalChecker checker;
+    string text;
+    ReadAll(stdin, text);
+    int errors = checker.Update(text.data(), text.size());
+    string list = paths;
+    for (size_t start = 0; start <= list.size(); ) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) end = list.size();
+        string path = list.substr(start, end - start);
+        start = end + 1;
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f) Failure("Cannot read %s", path.c_str());
+        text.clear();
+        ReadAll(f, text);
+        fclose(f);
+        errors = checker.Update(text.data(), text.size());
+    }
+    return errors;
+}
+
+/* Function: CheckBatch()
+ * -----------------------
+ * --batch=<file>[,<file>...] parses and checks each file as a
+ * translation unit of its own, in one process, so that with --preprocess
+ * a file they include is read and scanned only once. Errors name the
+ * file they are in. Returns the number of files with errors.
+ */
+static int CheckBatch(const char *paths)
+{
+    if (GetOption("stream-check"))
+        Failure("--batch cannot be combined with --stream-check");
+    int failed = 0;
+    string list = paths;
+    for (size_t start = 0; start <= list.size(); ) {
+        size_t end = list.find(',', start);
+        if (end == string::npos) end = list.size();
+        string path = list.substr(start, end - start);
+        start = end + 1;
+        FILE *f = fopen(path.c_str(), "rb");
+        if (!f) Failure("Cannot read %s", path.c_str());
+        string text;
+        ReadAll(f, text);
+        fclose(f);
+        ScanInput(text.data(), text.size(), path.c_str());
+        yyparse();
+        if (ReportError::NumErrors() > 0) failed++;
+        ReportError::ResetNumErrors();
+    }
+    return failed;
+}
+
+// Reads the file of a --query-type or --query-scope position,
+// <file>:<line>:<col>, into text
+static void ReadQuery(const char *option, const char *query, string &text,
+                      int &line, int &column)
+{
+    string path = query;
+    size_t colon2 = path.rfind(':');
+    size_t colon1 = colon2 == string::npos || colon2 == 0 ? string::npos : path.rfind(':', colon2 - 1);
+    if (colon1 == string::npos || colon1 == 0)
+        Failure("--%s wants <file>:<line>:<col>, not %s", option, query);
+    line = atoi(path.c_str() + colon1 + 1);
+    column = atoi(path.c_str() + colon2 + 1);
+    path.resize(colon1);
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) Failure("Cannot read %s", path.c_str());
+    ReadAll(f, text);
+    fclose(f);
+}
+
+/* Function: QueryType()
+ * ----------------------
+ * --query-type=<file>:<line>:<col> checks the file and prints the
+ * innermost expression at that position with the type the checker gave
+ * it, as "<kind> <line>:<col>-<line>:<col> <type>", the way an editor
+ * shows it on hover. The errors the file has are not printed. Returns
+ * nonzero if no checked expression is there.
+ */
+static int QueryType(const char *query)
+{
+    string text;
+    int line, column;
+    ReadQuery("query-type", query, text, line, column);
+    IncrementalChecker checker;
+    vector<Diagnostic> found;
+    checker.Update(text.data(), text.size(), &found);
+    Expr *expr = checker.Index()->ExprAt(line, column);
+    if (!expr) {
+        printf("No checked expression at %d:%d\n", line, column);
+        return 1;
+    }
+    yyltype *loc = expr->GetLocation();
+    cout << expr->GetPrintNameForNode() << ' ' << loc->first_line << ':' << loc->first_column
+         << '-' << loc->last_line << ':' << loc->last_column << ' ' << expr->type << endl;
+    return 0;
+}
+
+/* Function: QueryScope()
+ * -----------------------
+ * --query-scope=<file>:<line>:<col> checks the file and prints the names
+ * in scope at that position, innermost first, one per line as
+ * "<name> variable|function <type>", the way an editor lists them for
+ * completion. The errors the file has are not printed.
+ */
+static int QueryScope(const char *query)
+{
+    string text;
+    int line, column;
+    ReadQuery("query-scope", query, text, line, column);
+    SymbolTable::keepScopes = true;
+    IncrementalChecker checker;
+    vector<Diagnostic> found;
+    checker.Update(text.data(), text.size(), &found);
+    vector<const Symbol *> visible;
+    checker.VisibleAt(line, column, visible);
+    for (const Symbol *sym : visible) {
+        FnDecl *fn = dynamic_cast<FnDecl*>(sym->decl);
+        VarDecl *var = dynamic_cast<VarDecl*>(sym->decl);
+        Type *type = fn ? fn->GetType() : var ? var->GetType() : NULL;
+        cout << sym->name << (fn ? " function " : " variable ");
+        if (type) cout << type;
+        cout << endl;
+    }
+    return 0;
+}
+
 /* Function: main()
  * ----------------
  * Entry point to the entire program.  We parse the command line and turn
  * on any debugging flags requested by the user when invoking the program.
  * InitScanner() is used to set up the scanner.
  * InitParser() is used to set up the parser. The call to yyparse() will
- * attempt to parse a complete program from the input. 
+ * attempt to parse a complete program from the input. With --push[=bytes]
+ * the input is instead fed to the parser in chunks as it is read.
+ * --print-ast=<file> prints a binary AST written by --emit-ast instead
+ * (as text, or JSON with --dump-format=json), --recheck=<file>
+ * checks an edit of the input incrementally, --query-type=<file>:<line>:<col>
+ * prints the type of the expression at a position and --query-scope the
+ * names in scope there, --lsp serves the Language Server Protocol on
+ * standard input and output, and --batch checks a list of files.
+ * --prelude=<file> starts every check with the declarations a program
+ * saved with --emit-prelude.
  */
 int main(int argc, char *argv[])
 {
     ParseCommandLine(argc, argv);
+    if (const char *path = GetOption("print-ast")) {
+        const BastFile *ast = LoadAst(path);
+        if (!ast) Failure("%s is not a valid binary AST file", path);
+        PrintAst(ast, AstFormatOption());
+        UnloadAst(ast);
+        return 0;
+    }
     InitScanner();
     InitParser();
-    yyparse();
+    if (const char *path = GetOption("prelude")) {
+        const vector<Decl*> *prelude = LoadPrelude(path);
+        if (!prelude) Failure("%s is not a valid prelude", path);
+        Program::UsePrelude(prelude);
+    }
+    if (const char *paths = GetOption("recheck"))
+        return (RecheckInput(paths) == 0? 0 : -1);
+    if (const char *query = GetOption("query-type"))
+        return QueryType(query);
+    if (const char *query = GetOption("query-scope"))
+        return QueryScope(query);
+    if (GetOption("lsp"))
+        return ServeLsp();
+    if (const char *paths = GetOption("batch"))
+        return (CheckBatch(paths) == 0? 0 : -1);
+    if (const char *push = GetOption("push"))
+        PushParseInput(*push ? atoi(push) : 4096);
+    else
+        yyparse();
+    FinishScanner();
     return (ReportError::NumErrors() == 0? 0 : -1);
 }
 
@@ -10,7 +10,7 @@
   // here we need to include things needed for the yylval union
   // (types, classes, constants, etc.)
   
-#include "scanner.h"            // for MaxIdentLen
+#include "scanner.h"            // for yylex
 #include "list.h"       	// because we use all these types
 #include "ast.h"		// in the union, we need their declarations
 #include "ast_type.h"
@@ -35,4 +35,16 @@
 int yyparse();              // Defined in the generated y.tab.c file
 void InitParser();          // Defined in parser.y
 
+// How deeply constructs may nest unless --max-depth says otherwise
+#define DefaultMaxDepth 1000000
+
+// Parsing input fed in chunks, defined in parser.y
+void StartPushParse();
+bool PushInput(const char *chunk, size_t len);
+int FinishPushParse();
+
+// Parsing one piece of a source held in memory (see incremental.h),
+// defined in parser.y
+List<Decl*> *ParseDecls(const char *text, size_t len, int firstLine, bool *complete);
+
 #endif
@@ -19,8 +19,47 @@
 #include "scanner.h" // for yylex
 #include "parser.h"
 #include "errors.h"
+#include "bast.h"
+#include "ast_store.h"
+#include "prelude.h"
 
 void yyerror(const char *msg); // standard error-handling routine
+static void DumpAst(Program *program);
+static void EmitAst(Program *program, const char *path);
+static void StartStreamedEmit();
+static void EmitStreamed(Decl *decl);
+static void FinishStreamedEmit();
+static void EmitPrelude(Program *program, const char *path);
+
+static bool streamCheck;       // --stream-check, see InitParser
+static bool streamEmit;        // --emit-ast, checked as it is parsed
+static bool declsOnly;         // parsing for ParseDecls
+static List<Decl*> *parsedDecls;
+static int maxDepth;           // --max-depth, see InitParser
+static void CheckNesting(Decl *decl);
+
+// A level of nesting takes the parser a few states, so its stacks may
+// grow to a multiple of the depth allowed in the tree
+#define YYMAXDEPTH (10 * maxDepth)
+
+// Bison's default, also carrying over which file a span is in (a rule
+// matched inside an included file takes its file from the first token)
+#define YYLLOC_DEFAULT(Current, Rhs, N)                               \
+    do {                                                              \
+        if (N) {                                                      \
+            (Current).file = YYRHSLOC(Rhs, 1).file;                   \
+            (Current).first_line = YYRHSLOC(Rhs, 1).first_line;       \
+            (Current).first_column = YYRHSLOC(Rhs, 1).first_column;   \
+            (Current).last_line = YYRHSLOC(Rhs, N).last_line;         \
+            (Current).last_column = YYRHSLOC(Rhs, N).last_column;     \
+        } else {                                                      \
+            (Current).file = YYRHSLOC(Rhs, 0).file;                   \
+            (Current).first_line = (Current).last_line =              \
+                YYRHSLOC(Rhs, 0).last_line;                           \
+            (Current).first_column = (Current).last_column =          \
+                YYRHSLOC(Rhs, 0).last_column;                         \
+        }                                                             \
+    } while (0)
 
 %}
 
@@ -29,6 +68,12 @@ void yyerror(const char *msg); // standard error-handling routine
  * and associativity options, and so on.
  */
  
+/* Build both the usual yyparse() and a push parser (yypush_parse), which
+ * takes one token per call. The push parser lets PushInput() below
+ * parse input as it arrives instead of after all of it has been read.
+ */
+%define api.push-pull both
+
 /* yylval 
  * ------
  * Here we define the type of the yylval global variable that is used by
@@ -42,7 +87,7 @@ void yyerror(const char *msg); // standard error-handling routine
     int integerConstant;
     bool boolConstant;
     double floatConstant;
-    char identifier[MaxIdentLen+1]; // +1 for terminating null
+    const char *identifier;   // interned, see intern.h
     Decl *decl;
     FnDecl *funcDecl;
     List<Decl*> *declList;
@@ -65,10 +110,9 @@ void yyerror(const char *msg); // standard error-handling routine
  * Bison will assign unique numbers to these and export the #define
  * in the generated y.tab.h header file.
  */
-%token   T_Void T_Bool T_Int T_Float T_Uint
-%token   T_Bvec2 T_Bvec3 T_Bvec4 T_Ivec2 T_Ivec3 T_Ivec4
-%token   T_Uvec2 T_Uvec3 T_Uvec4 T_Vec2 T_Vec3 T_Vec4
-%token   T_Mat2  T_Mat3 T_Mat4
+%token   <typeDecl> T_Void T_TypeName T_Uint
+%token   <typeDecl> T_Bvec2 T_Bvec3 T_Bvec4 T_Ivec2 T_Ivec3 T_Ivec4
+%token   <typeDecl> T_Uvec2 T_Uvec3 T_Uvec4
 %token   T_While T_For T_If T_Else T_Return T_Break T_Continue T_Do 
 %token   T_Switch T_Case T_Default
 %token   T_In T_Out T_Const T_Uniform
@@ -137,19 +181,44 @@ Program   :    DeclList            {
                                       /* pp2: The @1 is needed to convince 
                                        * yacc to set up yylloc. You can remove 
                                        * it once you have other uses of @n*/
-                                      Program *program = new Program($1);
+                                      if (declsOnly) {
+                                          // the caller of ParseDecls checks them
+                                          parsedDecls = $1;
+                                      }
+                                      else if (streamCheck) {
+                                          // each Decl was checked as it was reduced
+                                          Program::FinishStreamedCheck();
+                                      }
+                                      else if (streamEmit) {
+                                          // each Decl was checked and emitted as it was reduced
+                                          FinishStreamedEmit();
+                                      }
                                       // if no errors, advance to next phase
-                                      if (ReportError::NumErrors() == 0) {
+                                      else if (ReportError::NumErrors() == 0) {
+                                          Program *program = new Program($1);
                                           if ( IsDebugOn("dumpAST") ) {
-                                            program->Print(0);
+                                            DumpAst(program);
                                           }
                                           program->Check();
+                                          if ( const char *path = GetOption("emit-ast") )
+                                            EmitAst(program, path);
+                                          if ( const char *path = GetOption("emit-prelude") )
+                                            EmitPrelude(program, path);
                                       }
                                     }
           ;
 
-DeclList  :    DeclList Decl        { ($$=$1)->Append($2); }
-          |    Decl                 { ($$ = new List<Decl*>)->Append($1); }
+DeclList  :    DeclList Decl        { ($$=$1)->Append($2);
+                                      CheckNesting($2);
+                                      if (streamCheck) Program::CheckStreamed($2);
+                                      else if (streamEmit && !declsOnly) EmitStreamed($2); }
+          |    Decl                 { ($$ = new List<Decl*>)->Append($1);
+                                      CheckNesting($1);
+                                      if (streamCheck) Program::CheckStreamed($1);
+                                      else if (streamEmit && !declsOnly) {
+                                          StartStreamedEmit();
+                                          EmitStreamed($1);
+                                      } }
           ;
 
 /* combine external_declaration and function_definition into a single rule
@@ -236,20 +305,12 @@ TypeQualify    : T_In       {$$ = TypeQualifier::inTypeQualifier;}
                | T_Uniform  {$$ = TypeQualifier::uniformTypeQualifier;}
                ;
 
-TypeDecl       : T_Int                   { $$ = Type::intType;    }
-               | T_Void                  { $$ = Type::voidType;   }
-               | T_Float                 { $$ = Type::floatType;  }
-               | T_Bool                  { $$ = Type::boolType;   }
-               | T_Vec2                  { $$ = Type::vec2Type;   }
-               | T_Vec3                  { $$ = Type::vec3Type;   }
-               | T_Vec4                  { $$ = Type::vec4Type;   }
-               | T_Mat2                  { $$ = Type::mat2Type;   }
-               | T_Mat3                  { $$ = Type::mat3Type;   }
-               | T_Mat4                  { $$ = Type::mat4Type;   }
+TypeDecl       : T_TypeName              { $$ = $1; }
+               | T_Void                  { $$ = $1; }
                ;
 
-CompoundStatement : T_LeftBrace T_RightBrace               { $$ = new StmtBlock(new List<VarDecl*>, new List<Stmt *>); }
-                  | T_LeftBrace StatementList T_RightBrace { $$ = new StmtBlock(new List<VarDecl*>, $2); }
+CompoundStatement : T_LeftBrace T_RightBrace               { $$ = new StmtBlock(new List<VarDecl*>, new List<Stmt *>, @$); }
+                  | T_LeftBrace StatementList T_RightBrace { $$ = new StmtBlock(new List<VarDecl*>, $2, @$); }
                   ;
 
 StatementList : Statement                     { ($$ = new List<Stmt*>)->Append($1); }
@@ -500,5 +561,195 @@ AssignOp           : T_Equal         { $$ = new Operator(yylloc, $1);   }
 void InitParser()
 {
    PrintDebug("parser", "Initializing parser");
-   yydebug = false;
+   // Checking declarations as they are parsed; dumping or emitting the
+   // AST, or emitting a prelude, needs the whole tree, so turns this off.
+   // Emitting the AST can stream it into its store instead, unless the
+   // tree is wanted whole anyway
+   streamCheck = GetOption("stream-check") && !IsDebugOn("dumpAST")
+                 && !GetOption("emit-ast") && !GetOption("emit-prelude");
+   streamEmit = GetOption("emit-ast") && !IsDebugOn("dumpAST")
+                && !GetOption("emit-prelude");
+   const char *depth = GetOption("max-depth");
+   maxDepth = depth && atoi(depth) > 0 ? atoi(depth) : DefaultMaxDepth;
+   // Bison starts a trivial YYLTYPE at line 1; an error before the first
+   // token (an empty file) is reported at line 0
+   yylloc = yyltype();
+#if YYDEBUG
+   yydebug = false;    // release builds are generated without -t
+#endif
+}
+
+/* Function: CheckNesting
+ * -----------------------
+ * Nothing recurses through the tree (see ast.h), but every walk keeps a
+ * stack as deep as the tree, and the parser's own stacks grow with it
+ * (YYMAXDEPTH). A top-level declaration nested more than --max-depth
+ * levels deep is reported here, before any walk, so that the budget
+ * bounds what those stacks may take; the default admits a sum of
+ * hundreds of thousands of terms.
+ */
+static void CheckNesting(Decl *decl)
+{
+   if (decl->GetHeight() <= maxDepth) return;
+   Node *deep = decl->FindTooDeep(maxDepth);
+   if (!deep) deep = decl;
+   yyltype *loc = NULL;
+   for (Node *n = deep; n && !loc; n = n->GetParent())
+      loc = n->GetLocation();
+   ReportError::NestingTooDeep(loc);
+}
+
+/* Function: ParseDecls
+ * ---------------------
+ * Parses a piece of the source that begins line firstLine and holds
+ * whole top-level declarations, and returns them unchecked. Errors are
+ * reported as yyparse() reports them, and *complete is set false if a
+ * syntax error stopped the parse. The parser reduces a Program before it
+ * finds that a token which cannot start a declaration is an error, so
+ * the declarations before such a token are still returned (yyparse()
+ * checks them); after any other syntax error the result is NULL.
+ */
+List<Decl*> *ParseDecls(const char *text, size_t len, int firstLine, bool *complete)
+{
+   ScanText(text, len, firstLine);
+   yylloc = yyltype();
+   declsOnly = true;
+   parsedDecls = NULL;
+   *complete = (yyparse() == 0);
+   declsOnly = false;
+   return parsedDecls;
+}
+
+/* Function: StartPushParse, PushInput, FinishPushParse
+ * ----------------------------------------------------
+ * Parse input that arrives in pieces (from a pipe, a socket, ...)
+ * instead of calling yyparse(). Each chunk given to PushInput() is
+ * scanned and parsed as far as its last complete line, so syntax errors
+ * are reported as soon as their line has been received. PushInput()
+ * returns false once the parse has finished early, after which further
+ * input is ignored. FinishPushParse() marks the end of the input and
+ * returns what yyparse() would have.
+ */
+static yypstate *pushState;
+static int pushStatus;
+
+void StartPushParse()
+{
+   pushState = yypstate_new();
+   if (!pushState) Failure("Out of memory starting the parser");
+   pushStatus = YYPUSH_MORE;
+}
+
+// Hands the parser every token the scanner can produce so far
+static void PushTokens()
+{
+   while (pushStatus == YYPUSH_MORE) {
+      int token = yylex();
+      if (token == MoreInputNeeded) return;
+      yychar = token;
+      pushStatus = yypush_parse(pushState);
+   }
+}
+
+bool PushInput(const char *chunk, size_t len)
+{
+   if (pushStatus != YYPUSH_MORE) return false;
+   FeedInput(chunk, len);
+   PushTokens();
+   return pushStatus == YYPUSH_MORE;
+}
+
+int FinishPushParse()
+{
+   if (pushStatus == YYPUSH_MORE) {
+      FinishInput();
+      PushTokens();
+   }
+   yypstate_delete(pushState);
+   pushState = NULL;
+   return pushStatus;
+}
+
+/* Function: DumpAst
+ * -----------------
+ * Prints the tree for -d dumpAST, in the format Node::Print uses unless
+ * --dump-format=json is given, through one buffered AstPrinter.
+ */
+static void DumpAst(Program *program)
+{
+   AstPrinter printer(AstFormatOption());
+   program->Emit(&printer);
+   printer.Finish();
+}
+
+/* Function: EmitAst
+ * -----------------
+ * Writes the checked tree to a binary AST file (--emit-ast=<path>) for
+ * other tools to load with LoadAst().
+ */
+static void EmitAst(Program *program, const char *path)
+{
+   AstStore store;
+   program->Emit(&store);
+   if (!WriteAst(store, path))
+      Failure("Cannot write the AST to %s", path);
+}
+
+static AstStore *emitStore;    // the program emitted so far
+static vector<Diagnostic> emitErrors;
+
+/* Function: StartStreamedEmit, EmitStreamed, FinishStreamedEmit
+ * -------------------------------------------------------------
+ * --emit-ast without the whole tree: each declaration is checked as
+ * it is reduced (see Program::CheckStreamed) and emitted into the store
+ * before its body is freed, so the store, not the linked tree, holds
+ * the program and the tree never has more than one function body.
+ * EmitAst() writes only a program that parsed without errors, and its
+ * check's errors are printed only then; so the streamed checks' errors
+ * are held back until the whole program has parsed, and printed (in
+ * the same order) or dropped with the store.
+ */
+static void StartStreamedEmit()
+{
+   Program::FinishStreamedCheck();   // left by a parse that stopped early
+   delete emitStore;
+   emitStore = new AstStore;
+   emitStore->BeginNode("Program", NULL, NULL, NULL);   // as Program::Emit
+   emitErrors.clear();
+}
+
+static void EmitStreamed(Decl *decl)
+{
+   ReportError::CollectOnThisThread(&emitErrors);
+   Program::CheckStreamed(decl, emitStore);
+   ReportError::CollectOnThisThread(NULL);
+}
+
+static void FinishStreamedEmit()
+{
+   Program::FinishStreamedCheck();
+   if (ReportError::NumErrors() == 0) {
+      for (size_t i = 0; i < emitErrors.size(); i++)
+         ReportError::Replay(emitErrors[i]);
+      emitStore->EndNode();
+      const char *path = GetOption("emit-ast");
+      if (!WriteAst(*emitStore, path))
+         Failure("Cannot write the AST to %s", path);
+   }
+   delete emitStore;
+   emitStore = NULL;
+   emitErrors.clear();
+}
+
+/* Function: EmitPrelude
+ * ---------------------
+ * Saves the global declarations of the checked program as a prelude
+ * (--emit-prelude=<path>, see prelude.h), if it checked without errors.
+ */
+static void EmitPrelude(Program *program, const char *path)
+{
+   if (ReportError::NumErrors() > 0)
+      return;
+   if (!WritePrelude(program, path))
+      Failure("Cannot write the prelude to %s", path);
 }
@@ -0,0 +1,288 @@
+/* File: prelude.cc
+ * ----------------
+ * Writing and loading preludes (see prelude.h).
+ */
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <sstream>
+#include <string>
+#include <unordered_map>
+#include "prelude.h"
+#include "ast_decl.h"
+#include "ast_expr.h"
+#include "ast_stmt.h"
+#include "ast_type.h"
+#include "intern.h"
+
+// The qualifiers an entry's qualifier field numbers from 1
+static TypeQualifier **Qualifiers()
+{
+    static TypeQualifier *qualifiers[] = {
+        TypeQualifier::inTypeQualifier, TypeQualifier::outTypeQualifier,
+        TypeQualifier::constTypeQualifier, TypeQualifier::uniformTypeQualifier,
+    };
+    return qualifiers;
+}
+static const int NumQualifiers = 4;
+
+static uint8_t QualifierIndex(TypeQualifier *typeq)
+{
+    for (int i = 0; i < NumQualifiers; i++)
+        if (Qualifiers()[i] == typeq) return i + 1;
+    return 0;
+}
+
+/* Writing */
+
+class PreludeWriter {
+    vector<PreludeEntry> entries;
+    string strings;
+    unordered_map<string, uint32_t> offsets;
+
+    uint32_t Add(const string &s) {
+        if (s.empty()) return 0;
+        unordered_map<string, uint32_t>::iterator it = offsets.find(s);
+        if (it != offsets.end()) return it->second;
+        uint32_t off = strings.size();
+        strings.append(s.c_str(), s.size() + 1);
+        offsets[s] = off;
+        return off;
+    }
+
+    PreludeEntry &Begin(PreludeEntryKind kind, Decl *d, Type *type, TypeQualifier *typeq) {
+        PreludeEntry e;
+        memset(&e, 0, sizeof(e));
+        e.kind = kind;
+        e.qualifier = QualifierIndex(typeq);
+        e.name = Add(d->GetIdentifier()->GetName());
+        ArrayType *array = dynamic_cast<ArrayType*>(type);
+        if (array) {
+            e.arraySize = array->GetElemCount();
+            type = array->GetElemType();
+        }
+        if (type) {
+            ostringstream name;
+            type->PrintToStream(name);
+            e.type = Add(name.str());
+        }
+        yyltype *loc = d->GetLocation();
+        e.firstLine = loc->first_line;
+        e.firstColumn = loc->first_column;
+        e.lastLine = loc->last_line;
+        e.lastColumn = loc->last_column;
+        entries.push_back(e);
+        return entries.back();
+    }
+
+  public:
+    PreludeWriter() { strings.push_back('\0'); }    // offset 0 is ""
+
+    void AddVariable(VarDecl *v, PreludeEntryKind kind) {
+        PreludeEntry &e = Begin(kind, v, v->GetType(), v->GetTypeQualifier());
+        Constant c = v->GetConstant();
+        e.valueKind = c.kind;
+        if (c.kind == Constant::Float) e.value.floatValue = c.floatValue;
+        else if (c.kind == Constant::Bool) e.value.intValue = c.boolValue;
+        else e.value.intValue = c.intValue;
+    }
+
+    void AddFunction(FnDecl *f) {
+        List<VarDecl*> *formals = f->GetFormals();
+        Begin(P_Function, f, f->GetType(), f->GetTypeQualifier()).formalCount =
+            formals->NumElements();
+        for (int i = 0; i < formals->NumElements(); i++)
+            AddVariable(formals->Nth(i), P_Formal);
+    }
+
+    void Add(Decl *d) {
+        if (FnDecl *f = dynamic_cast<FnDecl*>(d)) AddFunction(f);
+        else AddVariable(static_cast<VarDecl*>(d), P_Variable);
+    }
+
+    bool Write(const char *path) {
+        FILE *f = fopen(path, "wb");
+        if (!f) return false;
+        PreludeHeader header;
+        memset(&header, 0, sizeof(header));
+        memcpy(header.magic, PreludeMagic, 4);
+        header.version = PreludeVersion;
+        header.entryCount = entries.size();
+        header.entryOffset = sizeof(header);     // a multiple of 8
+        header.stringOffset = header.entryOffset + entries.size() * sizeof(PreludeEntry);
+        header.stringSize = strings.size();
+        bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+               && fwrite(entries.data(), sizeof(PreludeEntry), entries.size(), f) == entries.size()
+               && fwrite(strings.data(), 1, strings.size(), f) == strings.size();
+        return fclose(f) == 0 && ok;
+    }
+};
+
+bool WritePrelude(Program *program, const char *path)
+{
+    PreludeWriter writer;
+    if (const vector<Decl *> *prelude = Program::GetPrelude())
+        for (Decl *d : *prelude)
+            writer.Add(d);
+    List<Decl*> *decls = program->GetDecls();
+    for (int i = 0; i < decls->NumElements(); i++)
+        writer.Add(decls->Nth(i));
+    return writer.Write(path);
+}
+
+
+/* Loading */
+
+// The built-in type named name, or NULL
+static Type *BuiltinType(const char *name)
+{
+    static Type **types[] = {
+        &Type::intType, &Type::uintType, &Type::floatType, &Type::boolType, &Type::voidType,
+        &Type::vec2Type, &Type::vec3Type, &Type::vec4Type,
+        &Type::mat2Type, &Type::mat3Type, &Type::mat4Type,
+        &Type::ivec2Type, &Type::ivec3Type, &Type::ivec4Type,
+        &Type::bvec2Type, &Type::bvec3Type, &Type::bvec4Type,
+        &Type::uvec2Type, &Type::uvec3Type, &Type::uvec4Type,
+    };
+    static unordered_map<string, Type *> byName;
+    if (byName.empty())
+        for (Type **t : types) {
+            ostringstream s;
+            (*t)->PrintToStream(s);
+            byName[s.str()] = *t;
+        }
+    unordered_map<string, Type *>::iterator it = byName.find(name);
+    return it == byName.end() ? NULL : it->second;
+}
+
+// Checks everything the loader follows
+static bool IsWellFormed(const PreludeHeader *h, size_t size)
+{
+    if (memcmp(h->magic, PreludeMagic, 4) != 0 || h->version != PreludeVersion)
+        return false;
+    if (h->entryOffset % 8 != 0 || h->entryOffset < sizeof(PreludeHeader)
+        || h->entryOffset > size
+        || (size - h->entryOffset) / sizeof(PreludeEntry) < h->entryCount)
+        return false;
+    if (h->stringSize == 0 || h->stringOffset > size || size - h->stringOffset < h->stringSize)
+        return false;
+    const char *strings = (const char *)h + h->stringOffset;
+    if (strings[0] != '\0' || strings[h->stringSize - 1] != '\0')
+        return false;
+
+    const PreludeEntry *entries = (const PreludeEntry *)((const char *)h + h->entryOffset);
+    uint32_t formalsLeft = 0;      // of the last function
+    for (uint32_t i = 0; i < h->entryCount; i++) {
+        const PreludeEntry &e = entries[i];
+        if (e.kind > P_Formal || e.qualifier > NumQualifiers || e.valueKind > Constant::Bool
+            || e.name == 0 || e.name >= h->stringSize || e.type >= h->stringSize)
+            return false;
+        if (e.type ? !BuiltinType(strings + e.type) : (!e.qualifier || e.kind == P_Function))
+            return false;
+        if ((e.kind == P_Formal) != (formalsLeft > 0))
+            return false;
+        formalsLeft = e.kind == P_Function ? e.formalCount : e.kind == P_Formal ? formalsLeft - 1 : 0;
+    }
+    return formalsLeft == 0;
+}
+
+static yyltype Location(const PreludeEntry &e)
+{
+    yyltype loc = yyltype();
+    loc.first_line = e.firstLine;
+    loc.first_column = e.firstColumn;
+    loc.last_line = e.lastLine;
+    loc.last_column = e.lastColumn;
+    return loc;
+}
+
+static Identifier *MakeIdentifier(const PreludeEntry &e, const char *strings)
+{
+    const char *name = strings + e.name;
+    return new Identifier(Location(e), Intern(name, strlen(name)));
+}
+
+static Type *MakeType(const PreludeEntry &e, const char *strings)
+{
+    Type *type = e.type ? BuiltinType(strings + e.type) : NULL;
+    if (type && e.arraySize)
+        type = new ArrayType(Location(e), type, e.arraySize);
+    return type;
+}
+
+static TypeQualifier *MakeQualifier(const PreludeEntry &e)
+{
+    return e.qualifier ? Qualifiers()[e.qualifier - 1] : NULL;
+}
+
+// Makes the declaration of a variable or formal entry
+static VarDecl *MakeVariable(const PreludeEntry &e, const char *strings)
+{
+    Identifier *id = MakeIdentifier(e, strings);
+    Type *type = MakeType(e, strings);
+    TypeQualifier *typeq = MakeQualifier(e);
+    Expr *value = NULL;
+    switch (e.valueKind) {
+      case Constant::Int: value = new IntConstant(Location(e), e.value.intValue); break;
+      case Constant::Float: value = new FloatConstant(Location(e), e.value.floatValue); break;
+      case Constant::Bool: value = new BoolConstant(Location(e), e.value.intValue != 0); break;
+    }
+    if (type && typeq) return new VarDecl(id, type, typeq, value);
+    if (typeq) return new VarDecl(id, typeq, value);
+    return new VarDecl(id, type, value);
+}
+
+static FnDecl *MakeFunction(const PreludeEntry *e, const char *strings)
+{
+    List<VarDecl*> *formals = new List<VarDecl*>;
+    for (uint32_t j = 1; j <= e->formalCount; j++)
+        formals->Append(MakeVariable(e[j], strings));
+    Identifier *id = MakeIdentifier(*e, strings);
+    Type *returnType = MakeType(*e, strings);
+    if (TypeQualifier *typeq = MakeQualifier(*e))
+        return new FnDecl(id, returnType, typeq, formals);
+    return new FnDecl(id, returnType, formals);
+}
+
+/* Function: LoadPrelude
+ * ---------------------
+ * The entries are read straight out of the mapping, which is dropped
+ * once the declarations are built: they hold interned copies of the
+ * names and the built-in types, and nothing else from the file.
+ */
+const vector<Decl *> *LoadPrelude(const char *path)
+{
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(PreludeHeader)) {
+        close(fd);
+        return NULL;
+    }
+    void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (map == MAP_FAILED) return NULL;
+    const PreludeHeader *h = (const PreludeHeader *)map;
+    if (!IsWellFormed(h, st.st_size)) {
+        munmap(map, st.st_size);
+        return NULL;
+    }
+
+    const PreludeEntry *entries = (const PreludeEntry *)((const char *)map + h->entryOffset);
+    const char *strings = (const char *)map + h->stringOffset;
+    vector<Decl *> *decls = new vector<Decl *>;
+    for (uint32_t i = 0; i < h->entryCount; i++) {
+        const PreludeEntry &e = entries[i];
+        if (e.kind == P_Variable) {
+            decls->push_back(MakeVariable(e, strings));
+        } else {
+            decls->push_back(MakeFunction(&e, strings));
+            i += e.formalCount;
+        }
+    }
+    munmap(map, st.st_size);
+    return decls;
+}
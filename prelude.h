@@ -0,0 +1,89 @@
+/* File: prelude.h
+ * ---------------
+ * A prelude is the global scope of a checked program saved to a file,
+ * so that declarations shared by many shaders are checked once:
+ *
+ *   glc --emit-prelude=common.gpre < common.glsl
+ *   glc --prelude=common.gpre < shader.glsl
+ *
+ * The second run starts with everything common.glsl declared already in
+ * the global scope, as if shader.glsl began with it, but without parsing
+ * or checking it: a prelude holds the signature of each declaration (its
+ * name, type, qualifier and location, a function's formals, and the
+ * value of a constant), not the function bodies. Declaring one of its
+ * names again is a conflict, as it would be in one file. A program
+ * checked with a prelude can emit a prelude in turn, which then holds
+ * both sets of declarations.
+ *
+ * Like a .bast file (bast.h), a prelude is meant to be mapped, so it
+ * holds no pointers: a header, an array of fixed-size entries (each
+ * function followed by one entry per formal) and a string table, in the
+ * host byte order. A prelude is only written for a program that checks
+ * without errors.
+ */
+
+#ifndef _H_prelude
+#define _H_prelude
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+class Decl;
+class Program;
+
+#define PreludeMagic "GPRE"
+#define PreludeVersion 1
+
+enum PreludeEntryKind {
+    P_Variable, P_Function, P_Formal
+};
+
+struct PreludeHeader {
+    char magic[4];           // PreludeMagic, not NUL-terminated
+    uint32_t version;        // PreludeVersion
+    uint32_t entryCount;
+    uint32_t entryOffset;    // byte offsets from the start of the file
+    uint32_t stringOffset;
+    uint32_t stringSize;
+};
+
+struct PreludeEntry {
+    uint8_t kind;            // PreludeEntryKind
+    uint8_t qualifier;       // 0, or 1 + the index of in, out, const, uniform
+    uint8_t valueKind;       // Constant::Kind of a constant's value
+    uint8_t unused;
+    uint32_t name;           // string offsets
+    uint32_t type;           // of the type's name, or of a function's return type
+    int32_t arraySize;       // the element count of an array, otherwise 0
+    uint32_t formalCount;    // of a function, whose formals follow it
+    int32_t firstLine, firstColumn, lastLine, lastColumn;
+    uint32_t unused2;
+    union {
+        int64_t intValue;    // int and bool values
+        double floatValue;
+    } value;
+};
+
+static_assert(sizeof(PreludeHeader) == 24 && sizeof(PreludeEntry) == 48,
+              "the prelude layout must not depend on the compiler");
+
+/* Function: WritePrelude
+ * ----------------------
+ * Writes the global declarations of a checked program, after those of
+ * the prelude it was checked with, if any, to path. Returns false if the
+ * file cannot be written.
+ */
+bool WritePrelude(Program *program, const char *path);
+
+/* Function: LoadPrelude
+ * ---------------------
+ * Maps the prelude at path, checks that it is well formed, and builds
+ * its declarations, ready to be entered in a global scope (functions
+ * have no body). Returns NULL if the file cannot be read or is not a
+ * valid prelude of this version.
+ */
+const vector<Decl *> *LoadPrelude(const char *path);
+
+#endif
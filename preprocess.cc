@@ -0,0 +1,728 @@
+/* File: preprocess.cc
+ * -------------------
+ * The preprocessor run between the scanner and the parser with
+ * --preprocess (see preprocess.h).
+ *
+ * Tokens come from a stack of sources: the translation unit, which the
+ * scanner reads as it goes, and above it the files it includes, replayed
+ * from their cached scans. Above those is a stack of expansions, the
+ * replacements of the macros being read, and above that the tokens read
+ * ahead (looking for a macro call's parenthesis) and given back.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include "preprocess.h"
+#include "scanner.h"
+#include "errors.h"
+#include "intern.h"
+#include "utility.h"
+
+using namespace std;
+
+#define MaxIncludeDepth 64
+#define MaxIfDepth 64           // of macros in #if naming each other
+
+struct Macro {
+    bool function;
+    vector<const char *> params;     // interned
+    vector<PPToken> body;
+    string text;                     // the replacement as written, for #if
+};
+
+// The macros defined, by interned name
+static unordered_map<const char *, Macro> macros;
+
+// An #if, #ifdef or #ifndef whose #endif has not been read
+struct Conditional {
+    bool active;         // the group being read is compiled
+    bool taken;          // a group has been compiled, or none can be
+    bool sawElse;
+    const char *name;    // "if", "ifdef" or "ifndef"
+    yyltype loc;
+};
+static vector<Conditional> conditionals;
+
+// A file being read
+struct Source {
+    const ScannedFile *file;   // NULL for the translation unit itself
+    size_t next;               // index of its next token
+    int id;                    // as in yyltype::file
+    string dir;                // where its #include "file" looks first
+    size_t conditionals;       // how many were open when it was entered
+};
+static vector<Source> sources;
+static vector<const ScannedFile *> fileScans;   // by id, NULL for 0
+static vector<string> fileNames;                // by id
+
+// A macro's replacement being read. An argument being expanded before
+// it is substituted is read as a barrier, which ends like a file.
+struct Expansion {
+    vector<PPToken> tokens;
+    size_t next;
+    const Macro *macro;
+    bool barrier;
+};
+static vector<Expansion> expansions;
+static vector<PPToken> lookahead;     // given back, the next one last
+
+// Included files by real path, kept for the whole run
+static unordered_map<string, ScannedFile *> includeCache;
+static vector<string> includePath;
+static int version;
+
+
+// The directory a file's path is in, "" for the current one
+static string DirName(const string &path)
+{
+    size_t slash = path.rfind('/');
+    if (slash == string::npos) return "";
+    return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+/* Function: StartPreprocessing
+ * ----------------------------
+ * Resets everything but the include cache for a new translation unit.
+ * The include path is read from --include-path the first time.
+ */
+void StartPreprocessing(const char *path)
+{
+    static bool started;
+    if (!started) {
+        started = true;
+        if (const char *dirs = GetOption("include-path")) {
+            string list = dirs;
+            for (size_t start = 0; start <= list.size(); ) {
+                size_t end = list.find(':', start);
+                if (end == string::npos) end = list.size();
+                if (end > start) includePath.push_back(list.substr(start, end - start));
+                start = end + 1;
+            }
+        }
+    }
+    macros.clear();
+    conditionals.clear();
+    expansions.clear();
+    lookahead.clear();
+    sources.clear();
+    fileScans.assign(1, NULL);
+    fileNames.assign(1, path ? path : "");
+    version = 110;
+    Source input = { NULL, 0, 0, path ? DirName(path) : "", 0 };
+    sources.push_back(input);
+}
+
+const char *PreprocessedFileName(int file)
+{
+    if (file < 0 || file >= (int)fileNames.size() || fileNames[file].empty())
+        return NULL;
+    return fileNames[file].c_str();
+}
+
+const char *PreprocessedFileLine(int file, int n)
+{
+    if (file <= 0 || file >= (int)fileScans.size()) return NULL;
+    const vector<const char *> &lines = fileScans[file]->lines;
+    if (n <= 0 || n > (int)lines.size()) return NULL;
+    return lines[n-1];
+}
+
+static bool Active()
+{
+    return conditionals.empty() || conditionals.back().active;
+}
+
+// Reports the conditionals opened in the innermost source but not closed
+static void CloseConditionals()
+{
+    while (conditionals.size() > sources.back().conditionals) {
+        Conditional &c = conditionals.back();
+        ReportError::Formatted(&c.loc, "Unterminated #%s", c.name);
+        conditionals.pop_back();
+    }
+}
+
+/* Function: ReadSource
+ * --------------------
+ * Reads the innermost source's next token, printing the scanner's errors
+ * with it unless it is in a group being skipped. At the end of an
+ * included file, carries on in the file that included it.
+ */
+static void ReadSource(PPToken &t)
+{
+    for (;;) {
+        Source &s = sources.back();
+        bool print = Active();
+        if (!s.file) {
+            static vector<Diagnostic> found;
+            found.clear();
+            ReportError::CollectOnThisThread(&found);
+            t.token = RawLex();
+            ReportError::CollectOnThisThread(NULL);
+            t.value = yylval;
+            t.loc = yylloc;
+            t.loc.file = 0;
+            if (print)
+                for (const Diagnostic &d : found)
+                    ReportError::Replay(d);
+        } else {
+            size_t i = s.next;
+            t = s.file->tokens[i];
+            t.loc.file = s.id;
+            if (print)
+                for (size_t k = s.file->firstDiag[i]; k < s.file->firstDiag[i+1]; k++) {
+                    Diagnostic d = s.file->diags[k];
+                    d.loc.file = s.id;
+                    ReportError::Replay(d);
+                }
+            if (t.token != 0) s.next++;
+        }
+        if (t.token != 0 || sources.size() == 1)
+            return;
+        CloseConditionals();
+        sources.pop_back();
+    }
+}
+
+// The next token before expansion, or 0 at the end of an argument
+static void NextToken(PPToken &t)
+{
+    if (!lookahead.empty()) {
+        t = lookahead.back();
+        lookahead.pop_back();
+        return;
+    }
+    while (!expansions.empty()) {
+        Expansion &e = expansions.back();
+        if (e.next < e.tokens.size()) {
+            t = e.tokens[e.next++];
+            return;
+        }
+        if (e.barrier) {
+            t.token = 0;
+            return;
+        }
+        expansions.pop_back();
+    }
+    ReadSource(t);
+}
+
+// A macro is not expanded inside its own replacement
+static bool Disabled(const Macro *m)
+{
+    for (const Expansion &e : expansions)
+        if (e.macro == m) return true;
+    return false;
+}
+
+static bool Expand(const PPToken &name);
+
+/* Function: ExpandArgument
+ * ------------------------
+ * Expands the macros in an argument of a macro call, on its own, before
+ * it is substituted for its parameter.
+ */
+static vector<PPToken> ExpandArgument(const vector<PPToken> &arg)
+{
+    size_t depth = expansions.size();
+    Expansion e = { arg, 0, NULL, true };
+    expansions.push_back(e);
+    vector<PPToken> out;
+    PPToken t;
+    for (NextToken(t); t.token != 0; NextToken(t))
+        if (t.token != T_Identifier || !Expand(t))
+            out.push_back(t);
+    while (expansions.size() > depth)
+        expansions.pop_back();
+    return out;
+}
+
+/* Function: Expand
+ * ----------------
+ * If name is a macro to expand here, reads the arguments of a call and
+ * starts reading its replacement, located where it was used. Returns
+ * false, having read nothing, if it is not.
+ */
+static bool Expand(const PPToken &name)
+{
+    const char *id = name.value.identifier;
+    auto found = macros.find(id);
+    if (found == macros.end() || Disabled(&found->second))
+        return false;
+    const Macro &m = found->second;
+    Expansion e = { vector<PPToken>(), 0, &m, false };
+    yyltype loc = name.loc;
+
+    if (!m.function) {
+        e.tokens = m.body;
+    } else {
+        PPToken t;
+        NextToken(t);
+        if (t.token != T_LeftParen) {      // just the name
+            lookahead.push_back(t);
+            return false;
+        }
+        vector<vector<PPToken> > args(1);
+        for (int depth = 1; ; ) {
+            NextToken(t);
+            if (t.token == 0 || t.token == PreprocessorDirective) {
+                ReportError::Formatted(&loc, "Unterminated call of macro %s", id);
+                lookahead.push_back(t);
+                return true;
+            }
+            if (t.token == T_LeftParen) depth++;
+            else if (t.token == T_RightParen && --depth == 0) break;
+            else if (t.token == T_Comma && depth == 1) {
+                args.push_back(vector<PPToken>());
+                continue;
+            }
+            args.back().push_back(t);
+        }
+        loc = Join(loc, t.loc);
+        if (m.params.empty() && args.size() == 1 && args[0].empty())
+            args.clear();
+        if (args.size() != m.params.size()) {
+            ReportError::Formatted(&loc, "Macro %s takes %d arguments, not %d", id,
+                                   (int)m.params.size(), (int)args.size());
+            return true;
+        }
+        for (size_t i = 0; i < args.size(); i++)
+            args[i] = ExpandArgument(args[i]);
+        for (const PPToken &b : m.body) {
+            size_t i = 0;
+            if (b.token == T_Identifier)
+                while (i < m.params.size() && m.params[i] != b.value.identifier) i++;
+            if (b.token == T_Identifier && i < m.params.size())
+                e.tokens.insert(e.tokens.end(), args[i].begin(), args[i].end());
+            else
+                e.tokens.push_back(b);
+        }
+    }
+    for (PPToken &t : e.tokens)
+        t.loc = loc;
+    expansions.push_back(e);
+    return true;
+}
+
+
+/* Directives
+ * ----------
+ * Each works on the text after its name.
+ */
+
+static inline bool IsNameStart(char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+}
+
+static inline bool IsNameChar(char c) {
+    return IsNameStart(c) || (c >= '0' && c <= '9');
+}
+
+static void SkipBlanks(const char *&p)
+{
+    while (*p == ' ' || *p == '\r') p++;
+}
+
+// Reads a name at p, or returns "" if there is none
+static string ReadName(const char *&p)
+{
+    SkipBlanks(p);
+    const char *start = p;
+    if (IsNameStart(*p))
+        while (IsNameChar(*p)) p++;
+    return string(start, p - start);
+}
+
+static bool IsPredefined(const string &name)
+{
+    return name == "__LINE__" || name == "__FILE__" || name == "__VERSION__";
+}
+
+static bool IsDefined(const string &name)
+{
+    return IsPredefined(name) || macros.count(Intern(name.data(), name.size()));
+}
+
+/* Class: Condition
+ * ----------------
+ * Evaluates the expression of an #if or #elif by recursive descent, with
+ * C's operators and precedence. An object-like macro stands for its
+ * replacement, evaluated as an expression of its own.
+ */
+class Condition {
+    const char *p;
+    const yyltype *loc;
+    int depth;
+    int skipping;          // inside the operand && or || or ?: does not use
+    const char *error;
+
+    long long Unary();
+    long long Binary(int minPrecedence);
+
+  public:
+    Condition(const char *text, const yyltype *loc, int depth)
+        : p(text), loc(loc), depth(depth), skipping(0), error(NULL) {}
+
+    // Whether the whole text is an expression; its value in value, and
+    // otherwise what is wrong with it in Error()
+    bool Evaluate(long long &value) {
+        value = Binary(1);
+        SkipBlanks(p);
+        if (!error && *p) error = "Invalid #if expression";
+        return !error;
+    }
+    const char *Error() { return error; }
+};
+
+long long Condition::Unary()
+{
+    SkipBlanks(p);
+    char c = *p;
+    if (c == '(') {
+        p++;
+        long long value = Binary(1);
+        SkipBlanks(p);
+        if (*p != ')') error = "Invalid #if expression";
+        else p++;
+        return value;
+    }
+    if (c == '!' || c == '~' || c == '-' || c == '+') {
+        p++;
+        long long value = Unary();
+        return c == '!' ? !value : c == '~' ? ~value : c == '-' ? (long long)(0 - (unsigned long long)value) : value;
+    }
+    if (c >= '0' && c <= '9') {
+        char *end;
+        long long value = strtoll(p, &end, 0);
+        for (p = end; *p == 'u' || *p == 'U' || *p == 'l' || *p == 'L'; p++)
+            ;
+        return value;
+    }
+    string name = ReadName(p);
+    if (name.empty()) {
+        error = "Invalid #if expression";
+        return 0;
+    }
+    if (name == "defined") {
+        SkipBlanks(p);
+        bool paren = (*p == '(');
+        if (paren) p++;
+        name = ReadName(p);
+        SkipBlanks(p);
+        if (name.empty() || (paren && *p++ != ')'))
+            error = "Invalid #if expression";
+        return IsDefined(name);
+    }
+    if (name == "__LINE__") return loc->first_line;
+    if (name == "__FILE__") return loc->file;
+    if (name == "__VERSION__") return version;
+    auto found = macros.find(Intern(name.data(), name.size()));
+    if (found == macros.end())
+        return 0;
+    if (found->second.function) {
+        error = "Function-like macro in #if expression";
+        return 0;
+    }
+    if (depth >= MaxIfDepth) {
+        error = "Macros in #if expression nested too deeply";
+        return 0;
+    }
+    Condition inner(found->second.text.c_str(), loc, depth + 1);
+    inner.skipping = skipping;
+    long long value;
+    if (!inner.Evaluate(value))
+        error = inner.Error();
+    return value;
+}
+
+// How tightly the binary operator at p binds (0 for none), and its length
+static int Precedence(const char *p, int &len)
+{
+    static const struct { char text[3]; int precedence; } ops[] = {
+        {"||", 2}, {"&&", 3}, {"==", 7}, {"!=", 7}, {"<=", 8}, {">=", 8},
+        {"<<", 9}, {">>", 9}, {"?", 1}, {"|", 4}, {"^", 5}, {"&", 6},
+        {"<", 8}, {">", 8}, {"+", 10}, {"-", 10}, {"*", 11}, {"/", 11}, {"%", 11},
+    };
+    for (const auto &op : ops) {
+        len = strlen(op.text);
+        if (!strncmp(p, op.text, len)) return op.precedence;
+    }
+    return 0;
+}
+
+long long Condition::Binary(int minPrecedence)
+{
+    long long left = Unary();
+    for (;;) {
+        SkipBlanks(p);
+        int len, precedence = Precedence(p, len);
+        if (error || precedence < minPrecedence || precedence == 0)
+            return left;
+        char op = p[0], op2 = len > 1 ? p[1] : '\0';
+        p += len;
+        if (op == '?') {
+            skipping += !left;
+            long long yes = Binary(1);
+            skipping -= !left;
+            SkipBlanks(p);
+            if (*p != ':') {
+                error = "Invalid #if expression";
+                return 0;
+            }
+            p++;
+            skipping += !!left;
+            long long no = Binary(1);
+            skipping -= !!left;
+            left = left ? yes : no;
+            continue;
+        }
+        bool unused = (op == '|' && op2 == '|' && left) || (op == '&' && op2 == '&' && !left);
+        skipping += unused;
+        long long right = Binary(precedence + 1);
+        skipping -= unused;
+        if ((op == '/' || op == '%') && right == 0) {
+            if (!skipping) error = "Division by zero in #if expression";
+            left = 0;
+            continue;
+        }
+        // Arithmetic wraps around: it is done on the unsigned bits, since
+        // signed overflow is undefined, and LLONG_MIN / -1 (which would
+        // trap) gives LLONG_MIN
+        unsigned long long ul = left, ur = right;
+        if ((op == '/' || op == '%') && right == -1) {
+            left = op == '/' ? (long long)(0 - ul) : 0;
+            continue;
+        }
+        switch (op) {
+          case '|': left = op2 ? (left || right) : (left | right); break;
+          case '&': left = op2 ? (left && right) : (left & right); break;
+          case '^': left ^= right; break;
+          case '=': left = (left == right); break;
+          case '!': left = (left != right); break;
+          case '<': left = op2 == '<' ? (long long)(ul << (right & 63)) : op2 ? left <= right : left < right; break;
+          case '>': left = op2 == '>' ? left >> (right & 63) : op2 ? left >= right : left > right; break;
+          case '+': left = (long long)(ul + ur); break;
+          case '-': left = (long long)(ul - ur); break;
+          case '*': left = (long long)(ul * ur); break;
+          case '/': left /= right; break;
+          case '%': left %= right; break;
+        }
+    }
+}
+
+static bool EvaluateCondition(const char *p, yyltype *loc)
+{
+    Condition condition(p, loc, 0);
+    long long value;
+    if (condition.Evaluate(value))
+        return value != 0;
+    ReportError::Formatted(loc, "%s", condition.Error());
+    return false;
+}
+
+/* Function: Define
+ * ----------------
+ * #define NAME replacement, or NAME(params) replacement with the
+ * parenthesis right after the name. The replacement is scanned now;
+ * the scanner's errors in it are reported at the #define.
+ */
+static void Define(const char *p, yyltype *loc)
+{
+    string name = ReadName(p);
+    if (name.empty()) {
+        ReportError::Formatted(loc, "Missing macro name in #define");
+        return;
+    }
+    Macro m;
+    m.function = (*p == '(');
+    if (m.function) {
+        p++;
+        SkipBlanks(p);
+        if (*p == ')') p++;
+        else for (;;) {
+            string param = ReadName(p);
+            SkipBlanks(p);
+            if (param.empty() || (*p != ',' && *p != ')')) {
+                ReportError::Formatted(loc, "Invalid parameters of macro %s", name.c_str());
+                return;
+            }
+            m.params.push_back(Intern(param.data(), param.size()));
+            if (*p++ == ')') break;
+        }
+    }
+    SkipBlanks(p);
+    m.text = p;
+    while (!m.text.empty() && (m.text.back() == ' ' || m.text.back() == '\r'))
+        m.text.pop_back();
+
+    ScannedFile body;
+    ScanWhole(m.text.data(), m.text.size(), false, &body);
+    for (Diagnostic &d : body.diags) {
+        if (d.hasLoc) d.loc = *loc;
+        ReportError::Replay(d);
+    }
+    for (const char *line : body.lines)
+        if (*line) free((char *)line);
+    body.tokens.pop_back();        // the end of input
+    m.body.swap(body.tokens);
+    macros[Intern(name.data(), name.size())] = m;
+}
+
+static void Undef(const char *p, yyltype *loc)
+{
+    string name = ReadName(p);
+    if (name.empty())
+        ReportError::Formatted(loc, "Missing macro name in #undef");
+    else
+        macros.erase(Intern(name.data(), name.size()));
+}
+
+// An included file's scan, from the cache or read and scanned now
+static const ScannedFile *ScanIncluded(const string &path)
+{
+    char *real = realpath(path.c_str(), NULL);
+    if (!real) return NULL;
+    ScannedFile *&scan = includeCache[real];
+    free(real);
+    if (scan) {
+        PrintDebug("preprocess", "Reusing the scan of %s", path.c_str());
+        return scan;
+    }
+    FILE *f = fopen(path.c_str(), "rb");
+    if (!f) return NULL;
+    string text;
+    char chunk[1 << 16];
+    size_t n;
+    while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+        text.append(chunk, n);
+    fclose(f);
+    PrintDebug("preprocess", "Scanning %s", path.c_str());
+    scan = new ScannedFile;
+    ScanWhole(text.data(), text.size(), true, scan);
+    return scan;
+}
+
+/* Function: Include
+ * -----------------
+ * #include "file" or <file>: finds the file and starts reading it.
+ */
+static void Include(const char *p, yyltype *loc)
+{
+    SkipBlanks(p);
+    char close = *p == '"' ? '"' : *p == '<' ? '>' : '\0';
+    const char *end = close ? strchr(p + 1, close) : NULL;
+    if (!end) {
+        ReportError::Formatted(loc, "Invalid #include");
+        return;
+    }
+    string name(p + 1, end - p - 1);
+    if (sources.size() > MaxIncludeDepth) {
+        ReportError::Formatted(loc, "#include nested too deeply");
+        return;
+    }
+    vector<string> dirs;
+    if (close == '"') dirs.push_back(sources.back().dir);
+    dirs.insert(dirs.end(), includePath.begin(), includePath.end());
+    for (const string &dir : dirs) {
+        string path = name[0] == '/' || dir.empty() ? name : dir + "/" + name;
+        const ScannedFile *scan = ScanIncluded(path);
+        if (!scan) continue;
+        Source s = { scan, 0, (int)fileScans.size(), DirName(path), conditionals.size() };
+        fileScans.push_back(scan);
+        fileNames.push_back(path);
+        sources.push_back(s);
+        return;
+    }
+    ReportError::Formatted(loc, "Cannot find include file: %s", name.c_str());
+}
+
+/* Function: Directive
+ * -------------------
+ * Acts on a directive. In a group being skipped only the conditionals
+ * are looked at, to find where the group ends.
+ */
+static void Directive(PPToken &t)
+{
+    const char *p = t.value.identifier;
+    yyltype *loc = &t.loc;
+    string name = ReadName(p);
+    bool active = Active();
+    bool opened = conditionals.size() > sources.back().conditionals;
+
+    if (name == "if" || name == "ifdef" || name == "ifndef") {
+        Conditional c;
+        c.name = name == "if" ? "if" : name == "ifdef" ? "ifdef" : "ifndef";
+        c.loc = *loc;
+        c.sawElse = false;
+        c.active = false;
+        if (active && name == "if") {
+            c.active = EvaluateCondition(p, loc);
+        } else if (active) {
+            string macro = ReadName(p);
+            if (macro.empty())
+                ReportError::Formatted(loc, "Missing macro name in #%s", c.name);
+            else
+                c.active = IsDefined(macro) == (name == "ifdef");
+        }
+        c.taken = c.active || !active;
+        conditionals.push_back(c);
+    } else if (name == "elif" || name == "else") {
+        if (!opened) {
+            ReportError::Formatted(loc, "#%s without #if", name.c_str());
+            return;
+        }
+        Conditional &c = conditionals.back();
+        if (c.sawElse) {
+            ReportError::Formatted(loc, "#%s after #else", name.c_str());
+            c.active = false;
+            return;
+        }
+        c.sawElse = (name == "else");
+        c.active = !c.taken && (c.sawElse || EvaluateCondition(p, loc));
+        c.taken = c.taken || c.active;
+    } else if (name == "endif") {
+        if (!opened) ReportError::Formatted(loc, "#endif without #if");
+        else conditionals.pop_back();
+    } else if (!active) {
+        return;
+    } else if (name == "define") {
+        Define(p, loc);
+    } else if (name == "undef") {
+        Undef(p, loc);
+    } else if (name == "include") {
+        Include(p, loc);
+    } else if (name == "error") {
+        SkipBlanks(p);
+        ReportError::Formatted(loc, "#error %s", p);
+    } else if (name == "version") {
+        version = atoi(p);
+    } else if (name != "extension" && name != "pragma" && name != "line" && !name.empty()) {
+        ReportError::Formatted(loc, "Unknown preprocessor directive: #%s", name.c_str());
+    }
+}
+
+/* Function: PreprocessedLex
+ * -------------------------
+ * Returns the next token for the parser, acting on the directives and
+ * expanding the macros on the way to it.
+ */
+int PreprocessedLex()
+{
+    PPToken t;
+    for (;;) {
+        NextToken(t);
+        if (t.token == PreprocessorDirective) {
+            Directive(t);
+        } else if (t.token == 0) {
+            CloseConditionals();
+            return 0;
+        } else if (Active() && (t.token != T_Identifier || !Expand(t))) {
+            yylval = t.value;
+            yylloc = t.loc;
+            return t.token;
+        }
+    }
+}
@@ -0,0 +1,76 @@
+/* File: preprocess.h
+ * ------------------
+ * The GLSL preprocessor, turned on with --preprocess. It sits between
+ * the hand-written scanner and the parser: yylex() returns the tokens of
+ * PreprocessedLex(), which reads the scanner's tokens and acts on the
+ * directives among them.
+ *
+ *   #define NAME tokens          #if expr     #ifdef NAME    #ifndef NAME
+ *   #define NAME(a, b) tokens    #elif expr   #else          #endif
+ *   #undef NAME                  #include "file"  or  <file>
+ *   #error text                  #version, #extension, #pragma, #line
+ *
+ * Macros are expanded on tokens, not text: a macro's replacement is
+ * scanned once when it is defined, and a function-like macro's
+ * arguments are expanded and then substituted token for token (there is
+ * no # or ##). A macro is not expanded again inside its own expansion. #if evaluates
+ * an integer expression with C's operators over numbers, defined(NAME)
+ * and object-like macros; any other name counts as 0, except that
+ * __VERSION__ (from #version, 110 without one), __LINE__ and __FILE__
+ * are predefined there (the scanner takes no names starting with '_').
+ * #extension, #pragma and #line are accepted and otherwise ignored.
+ *
+ * "file" is looked for next to the file including it, then in each
+ * directory of --include-path=dir[:dir...]; <file> only in the latter.
+ * An included file is scanned into tokens once, the first time any
+ * translation unit includes it, and its tokens, scanner errors and lines
+ * are kept in a cache keyed by its real path. Including it again (from
+ * another file, or another translation unit of a --batch run) replays
+ * the cached tokens instead of reading and scanning it again.
+ *
+ * Every token keeps its place in the file it came from: yyltype::file
+ * is 0 for the translation unit itself and otherwise numbers the files
+ * it included, in the order they were entered, and errors in an
+ * included file name it and show its line. A macro's replacement takes
+ * the location of the macro's name where it was used (and for a call,
+ * up to its closing parenthesis).
+ */
+
+#ifndef _H_preprocess
+#define _H_preprocess
+
+#include <string>
+#include <vector>
+#include "errors.h"
+#include "parser.h" // for YYSTYPE
+
+using namespace std;
+
+struct PPToken {
+    int token;
+    YYSTYPE value;
+    yyltype loc;
+};
+
+// A file or macro body scanned all at once (see ScanWhole in scanner.h).
+// The errors and echoed characters of tokens[i] are diags[firstDiag[i]]
+// up to diags[firstDiag[i+1]]; the tokens end with the end-of-input token.
+struct ScannedFile {
+    vector<PPToken> tokens;
+    vector<size_t> firstDiag;
+    vector<Diagnostic> diags;
+    vector<const char *> lines;
+};
+
+// Starts on a translation unit read from path (NULL for standard input),
+// forgetting the macros of the one before but keeping the include cache
+void StartPreprocessing(const char *path);
+
+// The next token after preprocessing, as yylex() returns it
+int PreprocessedLex();
+
+// The name and line n of a file numbered as in yyltype::file
+const char *PreprocessedFileName(int file);
+const char *PreprocessedFileLine(int file, int n);
+
+#endif
@@ -0,0 +1,73 @@
+/* File: ring.h
+ * ------------
+ * A bounded, lock-free queue between exactly one producer thread and one
+ * consumer thread. Push() waits while the ring is full and Pop() while
+ * it is empty, so the capacity is what keeps a fast producer from
+ * running arbitrarily far ahead. Once the consumer Close()s the ring, a
+ * Push() that would wait drops its element and returns false instead, so
+ * a producer left behind by a consumer that stopped early can finish.
+ *
+ * Each side caches the other side's index and only reloads it when the
+ * ring looks full (or empty), so in the steady state a Push or Pop
+ * touches no cache line written by the other thread except the slot.
+ */
+
+#ifndef _H_ring
+#define _H_ring
+
+#include <atomic>
+#include <thread>
+#include <stddef.h>
+
+template<class Elem> class Ring {
+  private:
+    Elem *slots;
+    size_t mask;
+    alignas(64) std::atomic<size_t> head;  // next slot to read
+    size_t tailSeen;                       // consumer's copy of tail
+    alignas(64) std::atomic<size_t> tail;  // next slot to write
+    size_t headSeen;                       // producer's copy of head
+    std::atomic<bool> closed;
+
+  public:
+    Ring(size_t capacity);   // rounded up to a power of two
+    ~Ring() { delete[] slots; }
+
+    bool Push(const Elem &elem);
+    Elem Pop();
+    void Close() { closed.store(true, std::memory_order_release); }
+};
+
+template<class Elem> Ring<Elem>::Ring(size_t capacity)
+  : head(0), tailSeen(0), tail(0), headSeen(0), closed(false) {
+    size_t size = 2;
+    while (size < capacity) size *= 2;
+    slots = new Elem[size];
+    mask = size - 1;
+}
+
+template<class Elem> bool Ring<Elem>::Push(const Elem &elem) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    while (t - headSeen > mask) {
+        headSeen = head.load(std::memory_order_acquire);
+        if (t - headSeen <= mask) break;
+        if (closed.load(std::memory_order_acquire)) return false;
+        std::this_thread::yield();
+    }
+    slots[t & mask] = elem;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+}
+
+template<class Elem> Elem Ring<Elem>::Pop() {
+    size_t h = head.load(std::memory_order_relaxed);
+    while (h == tailSeen) {
+        tailSeen = tail.load(std::memory_order_acquire);
+        if (h == tailSeen) std::this_thread::yield();
+    }
+    Elem elem = slots[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return elem;
+}
+
+#endif
@@ -0,0 +1,28 @@
+vec3 n;
+vec2 uv;
+float t;
+int i;
+bool b;
+
+float length(vec2 v) {
+   return v.x + v.y;
+}
+
+void main() {
+   t = sin(t) + cos(t) * pow(t, 2.0);
+   t = dot(n, n) + length(uv);
+   n = normalize(cross(n, n));
+   uv = clamp(uv, 0.0, 1.0);
+   n = mix(n, n, t);
+   t = abs(i);
+   i = abs(i);
+   t = sqrt(i);
+   t = max(t, 1);
+   b = any(lessThan(uv, uv));
+   t = distance(n, uv);
+   t = sin(b);
+   t = length(n);
+   t = dot(n);
+   t = clamp(t, 0.0, 1.0, 2.0);
+   t = fract();
+}
@@ -0,0 +1,19 @@
+const int n = 4;
+const int m = n * 2 - 1;
+float weights[8];
+int none[0];
+
+void main() {
+   int i;
+   int local[0];
+   bool b;
+   b = n > 3;
+   switch (i) {
+     case n: i = 0; break;
+     case m: i = 1; break;
+     case n + 3: i = 2; break;
+     case (n - 1) * 2: i = 3; break;
+     case m - 1: i = 4; break;
+     case i + 1: i = 5; break;
+   }
+}
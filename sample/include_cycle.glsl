@@ -0,0 +1,9 @@
+#include "shapes.glslh"
+#include "points.glslh"
+
+void main() {
+   origin = origin + origin;
+}
+
+#include "loop.glslh"
+#include "nowhere.glslh"
@@ -0,0 +1,14 @@
+int small;
+float f;
+
+void main() {
+   small = 2147483647;
+   small = 4294967295;
+   small = 4294967296;
+   small = 0xFFFFFFFF;
+   small = 0x100000000;
+   small = 99999999999999999999;
+   f = 1.5f;
+   f = 340282346638528859811704183484516925440.0;
+   f = 1000000000000000000000000000000000000000000.0;
+}
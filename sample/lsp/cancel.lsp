@@ -0,0 +1,17 @@
+options --lsp-debounce=0
+text body 300000 "   a = a + a * a;\n"
+send {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+wait response 1
+# A change comes while this long document is checked (or before the
+# check starts): nothing is published for version 1
+send {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///long.glsl","languageId":"glsl","version":1,"text":"void main() {\n   float a;\n{{body}}}\n"}}}
+send {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///long.glsl","version":2},"contentChanges":[{"range":{"start":{"line":1,"character":3},"end":{"line":1,"character":8}},"text":"int"}]}}
+wait publish 2
+# The same while an edit is checked again
+send {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///long.glsl","version":3},"contentChanges":[{"range":{"start":{"line":300001,"character":7},"end":{"line":300001,"character":16}},"text":"true"}]}}
+sleep 30
+send {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///long.glsl","version":4},"contentChanges":[{"range":{"start":{"line":300001,"character":7},"end":{"line":300001,"character":11}},"text":"a - a"}]}}
+wait publish 4
+send {"jsonrpc":"2.0","id":2,"method":"shutdown"}
+wait response 2
+send {"jsonrpc":"2.0","method":"exit"}
@@ -0,0 +1,20 @@
+options --lsp-debounce=300
+send {"jsonrpc":"2.0","id":1,"method":"initialize","params":{}}
+wait response 1
+send {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///edit.glsl","languageId":"glsl","version":1,"text":"float scale;\n\nvoid main() {\n   scale = 1;\n}\n"}}}
+wait publish 1
+# A burst of range edits, well within the debounce, is checked once:
+# there is no publish for versions 2 to 5
+send {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///edit.glsl","version":2},"contentChanges":[{"range":{"start":{"line":3,"character":11},"end":{"line":3,"character":12}},"text":"1.0"}]}}
+send {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///edit.glsl","version":3},"contentChanges":[{"range":{"start":{"line":1,"character":0},"end":{"line":1,"character":0}},"text":"int count;\n"}]}}
+send {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///edit.glsl","version":4},"contentChanges":[{"range":{"start":{"line":5,"character":0},"end":{"line":5,"character":0}},"text":"   count = scale;\n"}]}}
+send {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///edit.glsl","version":5},"contentChanges":[{"range":{"start":{"line":0,"character":0},"end":{"line":0,"character":5}},"text":"vec2"},{"range":{"start":{"line":4,"character":11},"end":{"line":4,"character":14}},"text":"ve"}]}}
+send {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///edit.glsl","version":6},"contentChanges":[{"range":{"start":{"line":4,"character":11},"end":{"line":4,"character":13}},"text":"scale"}]}}
+wait publish 6
+# A change may also send the whole text
+send {"jsonrpc":"2.0","method":"textDocument/didChange","params":{"textDocument":{"uri":"file:///edit.glsl","version":7},"contentChanges":[{"text":"void main() {\n   int a;\n   a = 1 +;\n}\n"}]}}
+wait publish 7
+# Closing clears the diagnostics
+send {"jsonrpc":"2.0","method":"textDocument/didClose","params":{"textDocument":{"uri":"file:///edit.glsl"}}}
+wait publish 0
+# No shutdown before the input ends: the exit status is 1
@@ -0,0 +1,31 @@
+options --lsp-debounce=20
+# Requests before initialize are refused
+send {"jsonrpc":"2.0","id":1,"method":"textDocument/hover","params":{}}
+wait response 1
+send {"jsonrpc":"2.0","id":2,"method":"initialize","params":{"capabilities":{}}}
+wait response 2
+send {"jsonrpc":"2.0","method":"initialized","params":{}}
+send {"jsonrpc":"2.0","method":"textDocument/didOpen","params":{"textDocument":{"uri":"file:///shader.glsl","languageId":"glsl","version":1,"text":"const int size = 4;\nfloat scale;\n\nfloat twice(float v) {\n   return v * 2.0;\n}\n\nvoid main() {\n   vec3 color;\n   bool b;\n   scale = twice(scale);\n   color.x = scale;\n   b = size;\n}\n"}}}
+wait publish 1
+# The type of color.x, of the call, and of a name in no scope
+send {"jsonrpc":"2.0","id":3,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///shader.glsl"},"position":{"line":11,"character":9}}}
+wait response 3
+send {"jsonrpc":"2.0","id":4,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///shader.glsl"},"position":{"line":10,"character":12}}}
+wait response 4
+send {"jsonrpc":"2.0","id":5,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///shader.glsl"},"position":{"line":2,"character":0}}}
+wait response 5
+# The names in scope in main and at the top level
+send {"jsonrpc":"2.0","id":6,"method":"textDocument/completion","params":{"textDocument":{"uri":"file:///shader.glsl"},"position":{"line":12,"character":3}}}
+wait response 6
+send {"jsonrpc":"2.0","id":7,"method":"textDocument/completion","params":{"textDocument":{"uri":"file:///shader.glsl"},"position":{"line":2,"character":0}}}
+wait response 7
+send {"jsonrpc":"2.0","id":8,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///other.glsl"},"position":{"line":0,"character":0}}}
+wait response 8
+send {"jsonrpc":"2.0","id":9,"method":"workspace/symbol","params":{"query":""}}
+wait response 9
+send {"jsonrpc":"2.0","id":10,"method":"shutdown"}
+wait response 10
+# Only exit is taken after shutdown
+send {"jsonrpc":"2.0","id":11,"method":"textDocument/hover","params":{"textDocument":{"uri":"file:///shader.glsl"},"position":{"line":11,"character":9}}}
+wait response 11
+send {"jsonrpc":"2.0","method":"exit"}
@@ -0,0 +1,68 @@
+// Nesting past --max-depth (40 levels here) is reported for each
+// top-level declaration at the node that goes past it, and nothing is
+// checked; shallow() is within the budget, and parentheses add no level
+
+int shallow() {
+  return 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 10 + 11 + 12 + 13 + 14 + 15;
+}
+
+int parens() {
+  return (((((((((((((((((((((((((((((((((((((((((((((1)))))))))))))))))))))))))))))))))))))))))))));
+}
+
+int sum() {
+  return 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 0 + 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 0 + 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 0 + 1 + 2 + 3 + 4 + 5 + 6 + 7 + 8 + 9 + 0 + 1 + 2 + 3 + 4 + 5;
+}
+
+int negated() {
+  return - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - - 1;
+}
+
+int chain(int x) {
+  if (x == 0) return 0;
+  else if (x == 1) return 1;
+  else if (x == 2) return 2;
+  else if (x == 3) return 3;
+  else if (x == 4) return 4;
+  else if (x == 5) return 5;
+  else if (x == 6) return 6;
+  else if (x == 7) return 7;
+  else if (x == 8) return 8;
+  else if (x == 9) return 9;
+  else if (x == 10) return 10;
+  else if (x == 11) return 11;
+  else if (x == 12) return 12;
+  else if (x == 13) return 13;
+  else if (x == 14) return 14;
+  else if (x == 15) return 15;
+  else if (x == 16) return 16;
+  else if (x == 17) return 17;
+  else if (x == 18) return 18;
+  else if (x == 19) return 19;
+  else if (x == 20) return 20;
+  else if (x == 21) return 21;
+  else if (x == 22) return 22;
+  else if (x == 23) return 23;
+  else if (x == 24) return 24;
+  else if (x == 25) return 25;
+  else if (x == 26) return 26;
+  else if (x == 27) return 27;
+  else if (x == 28) return 28;
+  else if (x == 29) return 29;
+  else if (x == 30) return 30;
+  else if (x == 31) return 31;
+  else if (x == 32) return 32;
+  else if (x == 33) return 33;
+  else if (x == 34) return 34;
+  else if (x == 35) return 35;
+  else if (x == 36) return 36;
+  else if (x == 37) return 37;
+  else if (x == 38) return 38;
+  else if (x == 39) return 39;
+  else if (x == 40) return 40;
+  else if (x == 41) return 41;
+  else if (x == 42) return 42;
+  else if (x == 43) return 43;
+  else if (x == 44) return 44;
+  return 0;
+}
@@ -0,0 +1,37 @@
+float scale(float x) {
+   return x * 2.0;
+}
+
+vec2 scale(vec2 v) {
+   return v + v;
+}
+
+int scale(int x, int by) {
+   return x * by;
+}
+
+float blend(int a, float b) {
+   return b;
+}
+
+float blend(float a, int b) {
+   return a;
+}
+
+float scale(float y) {
+   return y;
+}
+
+void main() {
+   float f;
+   vec2 v;
+   int i;
+   f = scale(f);
+   v = scale(v);
+   i = scale(i, 3);
+   f = scale(i);
+   f = blend(1, 2.0);
+   f = blend(1, 2);
+   f = scale(true);
+   v = scale(v, v);
+}
@@ -0,0 +1,12 @@
+const int lights = 4;
+vec3 ambient;
+float shininess;
+
+float attenuate(float d, float k) {
+   return 1.0 / (1.0 + k * d);
+}
+
+vec3 shade(vec3 color, float d) {
+   shininess = attenuate(d, 0.25);
+   return color + ambient;
+}
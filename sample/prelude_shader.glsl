@@ -0,0 +1,13 @@
+vec3 result;
+float ambient;
+
+void main() {
+   float d;
+   d = 2.0;
+   result = shade(ambient, d);
+   result = shade(result, lights);
+   shininess = attenuate(d, 0.5);
+   switch (lights) {
+     case lights: d = 1.0; break;
+   }
+}
@@ -0,0 +1,29 @@
+#version 330
+#include "shapes.glslh"
+#include <points.glslh>
+
+#if SIDES == 4 && defined(AREA)
+int corners;
+#elif SIDES > 4
+float corners;
+#else
+#error shapes.glslh was not included
+#endif
+
+#if __VERSION__ >= 330
+bool modern;
+#endif
+
+#ifdef MISSING
+bool never;
+#endif
+
+void main() {
+   float a;
+   a = area(2.0, 3.0);
+   a = AREA(a, 2.0);
+   corners = SIDES;
+   origin = origin + origin;
+   modern = true;
+   never = true;
+}
@@ -0,0 +1,25 @@
+#if (-9223372036854775807 - 1) / -1 == -9223372036854775807 - 1
+int quotient;
+#endif
+#if (-9223372036854775807 - 1) % -1 == 0
+int remainder;
+#endif
+#if 9223372036854775807 + 1 < 0
+int sum;
+#endif
+#if -9223372036854775807 - 2 > 0
+int difference;
+#endif
+#if 4611686018427387904 * 4 == 0
+int product;
+#endif
+#if (1 << 63) < 0 && -(-9223372036854775807 - 1) < 0
+int shift;
+#endif
+#if 1 / 0
+int never;
+#endif
+
+void main() {
+   quotient = remainder + sum + difference + product + shift;
+}
@@ -0,0 +1,17 @@
+/* A comment with braces: { ; } */
+const int size = 4;
+float scale;
+
+void unused() {
+   bool b;
+   b = 1
+}
+
+float twice(float v) {
+   return v * 2.0;
+}
+
+void main() {
+   float r;
+   r = twice(scale);
+}
@@ -0,0 +1,21 @@
+/* A comment with braces: { ; } */
+const int size = 3;
+float scale;
+
+void unused() {
+   bool b;
+   b = 1;
+}
+
+float twice(float v) {
+   return v * 2.0;
+}
+
+void main() {
+   float r;
+   r = twice(scale);
+   switch (size) {
+     case size: r = 1.0; break;
+     case 2 * 2: r = 2.0; break;
+   }
+}
@@ -0,0 +1,8 @@
+void f() {
+  vec3 a;
+  float b;
+  b = a.5y + 1.5;
+  x = b;
+}
+
+int x;
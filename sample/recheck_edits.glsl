@@ -0,0 +1,19 @@
+const int size = 4;
+float scale;
+
+float twice(float v) {
+   return v * 2.0;
+}
+
+void main() {
+   float r;
+   r = twice(scale);
+   switch (size) {
+     case 4: r = 1.0; break;
+   }
+}
+
+void unused() {
+   bool b;
+   b = 1;
+}
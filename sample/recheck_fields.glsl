@@ -0,0 +1,6 @@
+void f() {
+  vec3 a;
+  a.
+}
+
+int x;
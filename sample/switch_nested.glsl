@@ -0,0 +1,13 @@
+const int four = 4;
+
+int pick(int x) {
+   int y;
+   y = 0;
+   switch (x) {
+     case 1: y = 1; break;
+     case 2*2: case four: y = 4; break;
+     case 3: case 5: case 1: y = 3; break;
+     case 6: case x: y = 6; break;
+   }
+   return y;
+}
@@ -10,14 +10,58 @@
 
 #include <stdio.h>
 
-#define MaxIdentLen 31    // Maximum length for identifiers
-
 extern char *yytext;      // Text of lexeme just scanned
 
 
-int yylex();              // Defined in the generated lex.yy.c file
+int yylex();              // Defined in fastscan.cc, dispatches to the
+                          // scanner selected with --scanner
+
+// Returned by yylex() when input is being fed in chunks and the
+// scanner has reached the end of what it has been given so far
+#define MoreInputNeeded (-1)
+
+void FeedInput(const char *chunk, size_t len); // Defined in fastscan.cc,
+void FinishInput();                            // hand-written scanner only
 
-void InitScanner();                 // Defined in scanner.l user subroutines
+void InitScanner();                 // Defined in fastscan.cc
+void FinishScanner();               // ditto, once the parse is done
 const char *GetLineNumbered(int n); // ditto
+
+// Line n of a file (0 for the input, see preprocess.h) and the name to
+// give it in errors, or NULL to leave the input unnamed
+const char *SourceLine(int file, int n);
+const char *SourceName(int file);
+
+// Restarts the scanner on the whole of a translation unit held in
+// memory, read from path (--batch, hand-written scanner only)
+void ScanInput(const char *text, size_t len, const char *path);
+
+// Returned by RawLex() when --preprocess is on for a line starting with
+// '#': yylval.identifier holds the rest of the directive
+#define PreprocessorDirective (-2)
+
+// What the preprocessor reads: the hand-written scanner's tokens, and
+// ScanWhole() for a file or macro body all at once
+struct ScannedFile;
+int RawLex();
+void ScanWhole(const char *text, size_t len, bool directives, ScannedFile *into);
+
+// Scanning a piece of a source held in memory (hand-written scanner
+// only): ScanText() restarts the scanner on text that begins line
+// firstLine, and once UseSourceLines() is given a LineSource,
+// GetLineNumbered() asks it for the lines
+class LineSource {
+  public:
+    virtual ~LineSource() {}
+    virtual const char *LineNumbered(int n) = 0;
+};
+void ScanText(const char *text, size_t len, int firstLine);
+void UseSourceLines(LineSource *lines);
+
+// The flex-generated scanner (scanner.l), present when the build
+// defines HAVE_FLEX_SCANNER
+int FlexLex();
+void InitFlexScanner();
+const char *FlexLineNumbered(int n);
  
 #endif
@@ -4,27 +4,276 @@
  */
 
 #include "symtable.h"
+#include "ast_decl.h"
+#include "ast_type.h"
+#include "utility.h"
+#include <algorithm>
 #include <iostream>
+#include <limits.h>
+#include <stdint.h>
 
 using namespace std;
 /* Scope Table Class */
-ScopedTable::ScopedTable() {}
-ScopedTable::~ScopedTable() {}
+ScopedTable::ScopedTable() : global(NULL), position(0), saved(NULL) {}
+ScopedTable::ScopedTable(GlobalScope *g, int pos) : global(g), position(pos), saved(NULL) {}
+ScopedTable::~ScopedTable() {
+	for ( size_t i = 0; i < overloadSets.size(); i++ )
+		delete overloadSets[i];
+}
 void ScopedTable::insert(Symbol &sym){
 	symbols.insert (  pair<const char*, Symbol>(sym.name,sym) );
+	if ( saved != NULL ) saved->add(sym);
 }
 
 void ScopedTable::remove(Symbol &sym){
 	symbols.erase( sym.name );
 }
 
+static thread_local vector<const char *> *globalLookups;
+
+void ScopedTable::RecordGlobalLookups(vector<const char *> *names){
+	globalLookups = names;
+}
+
 Symbol* ScopedTable::find(const char *name){
+	if ( global != NULL ) {
+		if ( globalLookups != NULL ) globalLookups->push_back(name);
+		return global->find(name, position);
+	}
 	SymbolIterator iter = symbols.find(name);
 	Symbol* sym = (iter != symbols.end()) ? &iter->second : NULL;
 	return sym;
 }
 
+OverloadSet* ScopedTable::newOverloadSet(){
+	overloadSets.push_back(new OverloadSet);
+	return overloadSets.back();
+}
+
+/* Overload Set */
+static uint64_t Signature(const vector<Type *> &types){
+	uint64_t h = types.size();
+	for ( size_t i = 0; i < types.size(); i++ )
+		h = (h ^ (uintptr_t)types[i]) * 0x9E3779B97F4A7C15ull + 0x632BE59BD9B4E019ull;
+	return h;
+}
+
+// The latest of the first count members with exactly the given formal
+// types, or -1
+int OverloadSet::find(const vector<Type *> &types, int count) const {
+	unordered_map<uint64_t, vector<int> >::const_iterator it = bySignature.find(Signature(types));
+	if ( it == bySignature.end() )
+		return -1;
+	for ( size_t i = it->second.size(); i > 0; i-- ) {
+		int m = it->second[i-1];
+		if ( m < count && members[m].formals == types )
+			return m;
+	}
+	return -1;
+}
+
+int OverloadSet::add(FnDecl *fn, FnDecl **replaced){
+	Member m = { fn, vector<Type *>(), INT_MAX };
+	List<VarDecl*> *formals = fn->GetFormals();
+	for ( int i = 0; i < formals->NumElements(); i++ )
+		m.formals.push_back(formals->Nth(i)->GetType());
+
+	int index = members.size();
+	int same = find(m.formals, index);
+	*replaced = same >= 0 ? members[same].fn : NULL;
+	if ( same >= 0 )
+		members[same].replacedBy = index;
+	numVisible.push_back((index ? numVisible.back() : 0) + (same >= 0 ? 0 : 1));
+	bySignature[Signature(m.formals)].push_back(index);
+	if ( byArity.size() <= m.formals.size() )
+		byArity.resize(m.formals.size() + 1);
+	byArity[m.formals.size()].push_back(index);
+	members.push_back(m);
+	return members.size();
+}
+
+FnDecl* OverloadSet::lone(int count) const {
+	// the last member is never replaced among the first count
+	return numVisible[count-1] == 1 ? members[count-1].fn : NULL;
+}
+
+FnDecl* OverloadSet::resolve(const vector<Type *> &args, int count, bool *ambiguous) const {
+	*ambiguous = false;
+	int exact = find(args, count);
+	if ( exact >= 0 )
+		return members[exact].fn;
+	if ( args.size() >= byArity.size() )
+		return NULL;
+
+	vector<int> which;
+	vector<const vector<Type *> *> candidates;
+	const vector<int> &sameArity = byArity[args.size()];
+	for ( size_t i = 0; i < sameArity.size() && sameArity[i] < count; i++ ) {
+		const Member &m = members[sameArity[i]];
+		if ( m.replacedBy < count )
+			continue;
+		which.push_back(sameArity[i]);
+		candidates.push_back(&m.formals);
+	}
+	int best = PickOverload(args, candidates);
+	*ambiguous = best == -2;
+	return best >= 0 ? members[which[best]].fn : NULL;
+}
+
+void OverloadSet::visible(int count, vector<FnDecl *> &out) const {
+	for ( int i = 0; i < count; i++ )
+		if ( members[i].replacedBy >= count )
+			out.push_back(members[i].fn);
+}
+
+int PickOverload(const vector<Type *> &args, const vector<const vector<Type *> *> &candidates){
+	vector< vector<int> > costs;
+	vector<int> viable;
+	for ( size_t c = 0; c < candidates.size(); c++ ) {
+		vector<int> cost;
+		for ( size_t i = 0; i < args.size(); i++ ) {
+			int k = args[i]->ConversionTo((*candidates[c])[i]);
+			if ( k < 0 )
+				break;
+			cost.push_back(k);
+		}
+		if ( cost.size() == args.size() ) {
+			viable.push_back(c);
+			costs.push_back(cost);
+		}
+	}
+	if ( viable.empty() )
+		return -1;
+
+	// the best is no worse than any other for every argument
+	for ( size_t b = 0; b < viable.size(); b++ ) {
+		bool best = true;
+		for ( size_t o = 0; o < viable.size() && best; o++ )
+			for ( size_t i = 0; i < args.size() && best; i++ )
+				if ( o != b && costs[b][i] > costs[o][i] )
+					best = false;
+		bool unique = true;
+		for ( size_t o = 0; o < viable.size() && best && unique; o++ )
+			if ( o != b && costs[o] == costs[b] )
+				unique = false;
+		if ( best && unique )
+			return viable[b];
+	}
+	return -2;
+}
+
+/* Global Scope */
+GlobalScope::~GlobalScope(){
+	delete table;
+}
+
+static inline size_t HashName(const char *name){
+	return ((uintptr_t)name >> 3) * 0x9E3779B97F4A7C15ull;
+}
+
+void GlobalScope::record(int pos, Symbol &sym){
+	Assert(slots.empty()); // not frozen yet
+	Version v = { pos, sym };
+	versions.push_back(v);
+}
+
+void GlobalScope::freeze(ScopedTable *t){
+	table = t;
+	// group by name; the stable sort keeps each group in position order
+	stable_sort(versions.begin(), versions.end(),
+		    [](const Version &a, const Version &b) { return a.sym.name < b.sym.name; });
+
+	size_t size = 16;
+	while ( size < 2 * versions.size() ) size *= 2;
+	Slot empty = { NULL, 0, 0 };
+	slots.assign(size, empty);
+	mask = size - 1;
+
+	for ( int i = 0; i < versions.size(); ) {
+		int j = i + 1;
+		while ( j < versions.size() && versions[j].sym.name == versions[i].sym.name ) j++;
+		size_t h = HashName(versions[i].sym.name) & mask;
+		while ( slots[h].name != NULL ) h = (h + 1) & mask;
+		Slot s = { versions[i].sym.name, i, j - i };
+		slots[h] = s;
+		i = j;
+	}
+}
+
+Symbol* GlobalScope::find(const char *name, int pos){
+	Assert(!slots.empty()); // frozen
+	size_t h = HashName(name) & mask;
+	for ( ; slots[h].name != NULL; h = (h + 1) & mask ) {
+		if ( slots[h].name != name )
+			continue;
+		for ( int i = slots[h].first + slots[h].count - 1; i >= slots[h].first; i-- )
+			if ( versions[i].position <= pos )
+				return &versions[i].sym;
+		return NULL;
+	}
+	return NULL;
+}
+
+void GlobalScope::visible(int pos, vector<const Symbol *> &out,
+			  unordered_set<const char *> &seen){
+	Assert(!slots.empty()); // frozen
+	vector<const Version *> found;
+	for ( size_t h = 0; h < slots.size(); h++ ) {
+		if ( slots[h].name == NULL || seen.count(slots[h].name) )
+			continue;
+		for ( int i = slots[h].first + slots[h].count - 1; i >= slots[h].first; i-- )
+			if ( versions[i].position <= pos ) {
+				found.push_back(&versions[i]);
+				break;
+			}
+	}
+	// in the order they were declared, not the table's
+	sort(found.begin(), found.end(),
+	     [](const Version *a, const Version *b) { return a->position < b->position; });
+	for ( size_t i = 0; i < found.size(); i++ ) {
+		seen.insert(found[i]->sym.name);
+		out.push_back(&found[i]->sym);
+	}
+}
+
+/* Saved Scope */
+SavedScope::SavedScope(SavedScope *p) : parent(p), parentCount(0) {
+	if ( p != NULL ) {
+		parentCount = p->symbols.size();
+		p->nested.push_back(this);
+	}
+}
+
+SavedScope::~SavedScope() {
+	for ( size_t i = 0; i < nested.size(); i++ )
+		delete nested[i];
+}
+
+// Whether the declaration of sym ends before line:column
+static bool DeclaredBefore(const Symbol &sym, int line, int column){
+	yyltype *loc = sym.decl->GetLocation();
+	return loc == NULL || loc->last_line < line ||
+	       (loc->last_line == line && loc->last_column < column);
+}
+
+void SavedScope::visible(int line, int column, vector<const Symbol *> &out,
+			 unordered_set<const char *> &seen) const {
+	size_t count = symbols.size();
+	while ( count > 0 && !DeclaredBefore(symbols[count-1], line, column) )
+		count--;
+	for ( const SavedScope *s = this; s != NULL; count = s->parentCount, s = s->parent ) {
+		// the later of two symbols with one name replaced the earlier
+		for ( size_t i = count; i > 0; i-- ) {
+			const Symbol &sym = s->symbols[i-1];
+			if ( seen.insert(sym.name).second )
+				out.push_back(&sym);
+		}
+	}
+}
+
 /* SymbolTable */
+bool SymbolTable::keepScopes = false;
+
 SymbolTable::SymbolTable() {}
 SymbolTable::~SymbolTable() {}
 void SymbolTable::pop(){
@@ -32,7 +281,23 @@ void SymbolTable::pop(){
 }
 
 void SymbolTable::push(){
+	ScopedTable *table = new ScopedTable();
+	if ( !tables.empty() && tables.back()->saved != NULL )
+		table->saved = new SavedScope(tables.back()->saved);
+	tables.push_back(table);
+}
+
+SavedScope *SymbolTable::pushSaved(){
 	tables.push_back(new ScopedTable());
+	return tables.back()->saved = new SavedScope(NULL);
+}
+
+SavedScope *SymbolTable::getSavedScope(){
+	return tables.empty() ? NULL : tables.back()->saved;
+}
+
+void SymbolTable::push(ScopedTable *table){
+	tables.push_back(table);
 }
 
 void SymbolTable::insert(Symbol &sym){
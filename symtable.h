@@ -13,7 +13,10 @@
 #ifndef _H_symtable
 #define _H_symtable
 
+#include <stdint.h>
 #include <map>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 #include <iostream>
 #include <string.h>
@@ -22,7 +25,11 @@
 using namespace std;
 
 class Decl;
+class FnDecl;
 class Stmt;
+class Type;
+class OverloadSet;
+class ScopedTable;
 
 enum EntryKind {
   E_FunctionDecl,
@@ -30,19 +37,78 @@ enum EntryKind {
 };
 
 struct Symbol {
-  char *name;
-  Decl *decl;
+  const char *name;
+  Decl *decl;                 // of a function, the last one entered
   EntryKind kind;
   int someInfo;
+  OverloadSet *overloads;     // of a function, all functions of the name
+  int overloadCount;          // how many of them this symbol sees
 
-  Symbol() : name(NULL), decl(NULL), kind(E_VarDecl), someInfo(0) {}
-  Symbol(char *n, Decl *d, EntryKind k, int info = 0) :
+  Symbol() : name(NULL), decl(NULL), kind(E_VarDecl), someInfo(0),
+        overloads(NULL), overloadCount(0) {}
+  Symbol(const char *n, Decl *d, EntryKind k, int info = 0) :
         name(n),
         decl(d),
         kind(k),
-        someInfo(info) {}
+        someInfo(info),
+        overloads(NULL),
+        overloadCount(0) {}
 };
 
+/* OverloadSet holds the functions declared with one name, which GLSL
+ * allows as long as their formal types differ. Like a saved scope, a
+ * set is only ever appended to, and a symbol refers to it together with
+ * how many functions it had when the symbol was entered: every version
+ * of the name in a global scope shares one set, and sees the functions
+ * declared up to its position.
+ *
+ * The functions are indexed by signature, a hash of the formal types
+ * (compared by identity, as the checker compares types), so a call
+ * whose arguments have exactly the types of some function's formals
+ * finds it in one probe however many overloads there are. Only a call
+ * that needs an implicit conversion looks through the functions taking
+ * as many arguments, for the best one (see PickOverload).
+ */
+class OverloadSet {
+  struct Member {
+    FnDecl *fn;
+    vector<Type *> formals;
+    int replacedBy;        // the later member with the same formals, or INT_MAX
+  };
+  vector<Member> members;
+  vector<int> numVisible;  // the members not replaced once member i was added
+  unordered_map<uint64_t, vector<int> > bySignature;
+  vector< vector<int> > byArity;
+
+  int find(const vector<Type *> &types, int count) const;
+
+  public:
+    // Adds fn and returns the number of functions the set then has. A
+    // function with the formal types of one before replaces it, and
+    // *replaced is set to that one (otherwise to NULL).
+    int add(FnDecl *fn, FnDecl **replaced);
+    // The only function seen by a symbol that sees count, or NULL if
+    // it sees more than one
+    FnDecl *lone(int count) const;
+    // The function of those count that a call with arguments of types
+    // args resolves to, or NULL if none takes them or, setting
+    // *ambiguous, no one of them is the best
+    FnDecl *resolve(const vector<Type *> &args, int count, bool *ambiguous) const;
+    // Appends the functions of those count that are not replaced, in
+    // the order they were added
+    void visible(int count, vector<FnDecl *> &out) const;
+};
+
+/* Function: PickOverload
+ * ----------------------
+ * Returns the index of the candidate parameter list (each as long as
+ * args) a call with arguments of types args resolves to: of those whose
+ * every parameter takes its argument (see Type::ConversionTo), the one
+ * that converts no argument at a higher cost than any other does. Returns
+ * -1 if no candidate takes the arguments, and -2 if none is the best.
+ */
+int PickOverload(const vector<Type *> &args, const vector<const vector<Type *> *> &candidates);
+
 struct lessStr {
   bool operator()(const char* s1, const char* s2) const
   { return strcmp(s1, s2) < 0; }
@@ -50,16 +116,98 @@ struct lessStr {
  
 typedef map<const char *, Symbol, lessStr>::iterator SymbolIterator;
 
+/* GlobalScope records what the global scope held as each top-level
+ * declaration was checked: every symbol together with the position of
+ * the declaration that entered it. Looking a name up "at position i"
+ * gives the latest symbol entered at or before i, which is the one the
+ * serial check would find while checking declaration i.
+ *
+ * Once all declarations are recorded, freeze() lays the symbols out in
+ * one array, grouped by name, and indexes the groups with an open
+ * addressing table keyed on the name pointer: names are interned (see
+ * intern.h), so a lookup never compares strings. The frozen scope is
+ * never modified again, so any number of threads read it without locks.
+ */
+class GlobalScope {
+  struct Version {
+    int position;
+    Symbol sym;
+  };
+  struct Slot {
+    const char *name;      // NULL if empty
+    int first, count;      // the name's run in versions
+  };
+  vector<Version> versions;
+  vector<Slot> slots;
+  size_t mask;
+  ScopedTable *table;      // owned: the overload sets are kept there
+
+  public:
+    GlobalScope() : mask(0), table(NULL) {}
+    ~GlobalScope();
+    void record(int position, Symbol &sym);
+    // Freezes the scope, recorded from table, which it then owns
+    void freeze(ScopedTable *table);
+    Symbol *find(const char *name, int position);
+    // Appends the symbol each name not in seen has at position, in the
+    // order they were declared, and adds the names to seen
+    void visible(int position, vector<const Symbol *> &out,
+                 unordered_set<const char *> &seen);
+};
+
+/* SavedScope keeps what a scope of a function held after the scope is
+ * popped, so that the names visible at a point in the body can be found
+ * later without checking it again (for completion in an editor).
+ *
+ * Saved scopes are persistent: a scope's symbols are only ever appended
+ * to, and a nested scope refers to the scope around it together with how
+ * many symbols that one had when the nested one was opened, instead of
+ * copying them. A scope and the scopes nested in it therefore share what
+ * they have in common, and a snapshot of the names in effect at any
+ * point is just a scope and a count. The outermost scope of a function
+ * (its formals and the top of its body) owns the scopes nested in it.
+ */
+class SavedScope {
+  const SavedScope *parent;
+  size_t parentCount;          // of the parent's symbols, when opened
+  vector<Symbol> symbols;      // in the order they were entered
+  vector<SavedScope *> nested;
+
+  public:
+    SavedScope(SavedScope *parent);
+    ~SavedScope();
+
+    void add(Symbol &sym)  { symbols.push_back(sym); }
+    // Appends the symbols in effect at line:column, a point in this
+    // scope, innermost first and once per name, adding their names to
+    // seen. A symbol is in effect once its declaration has ended.
+    void visible(int line, int column, vector<const Symbol *> &out,
+                 unordered_set<const char *> &seen) const;
+};
+
 class ScopedTable {
   map<const char *, Symbol, lessStr> symbols;
+  GlobalScope *global;     // if set, this table is a view of it
+  int position;
+  SavedScope *saved;       // if set, what is inserted is kept there too
+  vector<OverloadSet *> overloadSets;    // owned
 
   public:
     ScopedTable();
+    ScopedTable(GlobalScope *g, int position);
     ~ScopedTable();
 
     void insert(Symbol &sym); 
     void remove(Symbol &sym);
     Symbol *find(const char *name);
+    // A new, empty set for the functions of a name entered here
+    OverloadSet *newOverloadSet();
+
+    // Appends every name this thread looks up through a view of a
+    // global scope to names, until called again with NULL
+    static void RecordGlobalLookups(vector<const char *> *names);
+
+    friend class SymbolTable;
 };
    
 class SymbolTable {
@@ -70,12 +218,23 @@ class SymbolTable {
     SymbolTable();
     ~SymbolTable();
 
+    // Whether function bodies keep their scopes (see SavedScope); set
+    // before checking, by the modes that answer queries afterwards
+    static bool keepScopes;
+
     void push();
+    void push(ScopedTable *table);
     void pop();
+    // Pushes a scope that is saved, with the scopes nested in it, into
+    // the SavedScope returned
+    SavedScope *pushSaved();
+    // The saved scope of the innermost table, or NULL
+    SavedScope *getSavedScope();
 
     void insert(Symbol &sym);
     void remove(Symbol &sym);
     Symbol *find(const char *name);
+    OverloadSet *newOverloadSet() { return tables.back()->newOverloadSet(); }
     FnDecl *getCurrentFn();
     bool returnFound;
     void setCurrentFn(FnDecl* fnDecl);
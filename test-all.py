@@ -14,20 +14,43 @@
 # will need to do your own testing.  Be sure to look over these tests
 # carefully and to think over what cases are covered and, more importantly,
 # what cases are not.
+#
+# A test that needs command-line options lists them in a file named like
+# it with the extension .args. A test that reads a file another test
+# writes (such as a prelude saved with --emit-prelude) names that test in
+# a file with the extension .needs, and runs after it; the other tests run
+# in order of their names.
 
 import os
 from subprocess import *
 
-TEST_DIRECTORY = 'samples'
+TEST_DIRECTORY = 'sample'
+
+def sideFile(file, extension):
+  return os.path.join(TEST_DIRECTORY, '%s.%s' % (file.split('.')[0], extension))
+
+def runTest(file, done):
+  if file in done:
+    return
+  done.add(file)
+  needsName = sideFile(file, 'needs')
+  if os.path.exists(needsName):
+    for needed in open(needsName).read().split():
+      runTest(needed + '.glsl', done)
+
+  refName = sideFile(file, 'out')
+  argsName = sideFile(file, 'args')
+  testName = os.path.join(TEST_DIRECTORY, file)
 
-for _, _, files in os.walk(TEST_DIRECTORY):
-  for file in files:
-    if not (file.endswith('.glsl') or file.endswith('.frag')):
-      continue
-    refName = os.path.join(TEST_DIRECTORY, '%s.out' % file.split('.')[0])
-    testName = os.path.join(TEST_DIRECTORY, file)
+  args = ''
+  if os.path.exists(argsName):
+    args = open(argsName).read().strip() + ' '
+  result = Popen('./glc ' + args + '< ' + testName, shell = True, stderr = STDOUT, stdout = PIPE)
+  result = Popen('diff -w - ' + refName, shell = True, stdin = result.stdout, stdout = PIPE)
+  print 'Executing test "%s"' % testName
+  print ''.join(result.stdout.readlines())
 
-    result = Popen('./glc < ' + testName, shell = True, stderr = STDOUT, stdout = PIPE)
-    result = Popen('diff -w - ' + refName, shell = True, stdin = result.stdout, stdout = PIPE)
-    print 'Executing test "%s"' % testName
-    print ''.join(result.stdout.readlines())
+done = set()
+for file in sorted(os.listdir(TEST_DIRECTORY)):
+  if file.endswith('.glsl') or file.endswith('.frag'):
+    runTest(file, done)
@@ -0,0 +1,125 @@
+#!/bin/python
+#
+# File: test-lsp.py
+# -----------------
+# Drives glc --lsp with the scripted client sessions in sample/lsp and
+# compares what the server sends with the expected transcripts, as
+# test-all.py does for the samples. Run from the directory holding glc.
+#
+# A session (name.lsp) is a list of commands, one per line:
+#
+#   options <args>          glc's options besides --lsp (the first line)
+#   text <name> <count> <string>
+#                           defines {{name}}, in the strings of the messages
+#                           sent, as the JSON string <string> repeated
+#                           <count> times, for large documents
+#   send <message>          sends a JSON message, with each {{name}} replaced
+#   wait publish <version>  waits for diagnostics published for <version>
+#   wait response <id>      waits for the response to request <id>
+#   sleep <ms>              waits that long
+#
+# Every message the server sends is written to the transcript as it is
+# read, waited for or not, and the transcript ends with glc's exit status
+# once it has ended (after exit, or when the session runs out).
+# Diagnostics published for a version a later change made stale, or a
+# second publish where the changes should have been checked once, show
+# up there as lines the expected transcript (name.out) does not have.
+
+from __future__ import print_function
+import json, os, re, subprocess, sys, threading, time
+try:
+  import queue
+except ImportError:
+  import Queue as queue
+
+TEST_DIRECTORY = os.path.join('sample', 'lsp')
+TIMEOUT = 20
+
+def readMessages(stream, messages):
+  while True:
+    header = b''
+    while not header.endswith(b'\r\n\r\n'):
+      c = stream.read(1)
+      if not c:
+        messages.put(None)
+        return
+      header += c
+    length = int(re.search(br'Content-Length: *(\d+)', header).group(1))
+    messages.put(json.loads(stream.read(length).decode('utf-8')))
+
+def runSession(path):
+  lines = open(path).read().splitlines()
+  options = []
+  if lines and lines[0].startswith('options '):
+    options = lines.pop(0).split()[1:]
+  server = subprocess.Popen(['./glc', '--lsp'] + options, stdin = subprocess.PIPE,
+                            stdout = subprocess.PIPE, stderr = open(os.devnull, 'w'))
+  messages = queue.Queue()
+  reader = threading.Thread(target = readMessages, args = (server.stdout, messages))
+  reader.daemon = True
+  reader.start()
+  transcript = []
+  texts = {}
+  ended = [False]
+
+  def receive(timeout):
+    try:
+      message = messages.get(timeout = timeout)
+    except queue.Empty:
+      return False
+    if message is None:
+      ended[0] = True
+      return False
+    transcript.append('<- ' + json.dumps(message, sort_keys = True))
+    return message
+
+  def waitFor(matches, what):
+    deadline = time.time() + TIMEOUT
+    while not ended[0] and time.time() < deadline:
+      message = receive(deadline - time.time())
+      if message and matches(message):
+        return
+    transcript.append('timed out waiting for ' + what)
+
+  for line in lines:
+    words = line.split(None, 2)
+    if not words or words[0].startswith('#'):
+      continue
+    if words[0] == 'text':
+      name, rest = words[1], words[2].split(None, 1)
+      texts[name] = json.loads(rest[1]) * int(rest[0])
+    elif words[0] == 'send':
+      body = line.split(None, 1)[1]
+      for name in texts:
+        body = body.replace('{{%s}}' % name, json.dumps(texts[name])[1:-1])
+      body = json.dumps(json.loads(body)).encode('utf-8')
+      server.stdin.write(b'Content-Length: ' + str(len(body)).encode() + b'\r\n\r\n' + body)
+      server.stdin.flush()
+    elif words[0] == 'wait' and words[1] == 'publish':
+      version = int(words[2])
+      waitFor(lambda m: m.get('method') == 'textDocument/publishDiagnostics' and
+                        m['params'].get('version') == version, line)
+    elif words[0] == 'wait' and words[1] == 'response':
+      id = int(words[2])
+      waitFor(lambda m: 'method' not in m and m.get('id') == id, line)
+    elif words[0] == 'sleep':
+      time.sleep(int(words[1]) / 1000.0)
+    else:
+      transcript.append('bad command: ' + line)
+
+  server.stdin.close()
+  while not ended[0] and receive(TIMEOUT):
+    pass
+  status = server.wait()
+  transcript.append('exit %d' % status)
+  return '\n'.join(transcript) + '\n'
+
+for file in sorted(os.listdir(TEST_DIRECTORY)):
+  if not file.endswith('.lsp'):
+    continue
+  testName = os.path.join(TEST_DIRECTORY, file)
+  refName = os.path.join(TEST_DIRECTORY, '%s.out' % file.split('.')[0])
+  print('Executing test "%s"' % testName)
+  result = subprocess.Popen('diff -w - ' + refName, shell = True, stdin = subprocess.PIPE,
+                            stdout = subprocess.PIPE)
+  print(result.communicate(runSession(testName).encode('utf-8'))[0].decode('utf-8'))
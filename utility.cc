@@ -11,8 +11,17 @@
 using std::vector;
 
 static vector<const char*> debugKeys;
+static vector<const char*> optionNames, optionValues;
 static const int BufferSize = 2048;
 
+// The "--name" options the compiler reads with GetOption
+static const char *const knownOptions[] = {
+  "batch", "check-threads", "dump-format", "emit-ast", "emit-prelude",
+  "include-path", "lsp", "lsp-debounce", "max-depth", "pipeline", "prelude",
+  "preprocess", "print-ast", "push", "query-scope", "query-type", "recheck",
+  "scanner", "stream-check",
+};
+
 void Failure(const char *format, ...) {
   va_list args;
   char errbuf[BufferSize];
@@ -58,19 +67,53 @@ void PrintDebug(const char *key, const char *format, ...) {
   printf("+++ (%s): %s%s", key, buf, buf[strlen(buf)-1] != '\n'? "\n" : "");
 }
 
+const char *GetOption(const char *name) {
+  for (unsigned int i = 0; i < optionNames.size(); i++)
+    if (!strcmp(optionNames[i], name))
+      return optionValues[i];
+
+  return NULL;
+}
+
+static bool IsKnownOption(const char *name) {
+  for (unsigned int i = 0; i < sizeof(knownOptions) / sizeof(*knownOptions); i++)
+    if (!strcmp(knownOptions[i], name))
+      return true;
+
+  return false;
+}
+
+static void PrintUsage(int argc, char *argv[]) {
+  printf("Incorrect Use:   ");
+  for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
+  printf("\n");
+  printf("Correct Usage:   [--option[=value] ...] -d <debug-key-1> <debug-key-2> ... \n");
+}
+
 void ParseCommandLine(int argc, char *argv[]) {
-  if (argc == 1)
+  int first = 1;
+  for (; first < argc && !strncmp(argv[first], "--", 2); first++) {
+    char *name = argv[first] + 2;
+    char *eq = strchr(name, '=');
+    if (eq) *eq = '\0';
+    if (!IsKnownOption(name)) {
+      PrintUsage(argc, argv);
+      printf("Unknown option:  --%s\n", name);
+      exit(2);
+    }
+    optionNames.push_back(name);
+    optionValues.push_back(eq ? eq + 1 : "");
+  }
+
+  if (first == argc)
     return;
   
-  if (strcmp(argv[1], "-d") != 0) { // first arg is not -d
-    printf("Incorrect Use:   ");
-    for (int i = 1; i < argc; i++) printf("%s ", argv[i]);
-    printf("\n");
-    printf("Correct Usage:   -d <debug-key-1> <debug-key-2> ... \n");
+  if (strcmp(argv[first], "-d") != 0) { // first arg is not -d
+    PrintUsage(argc, argv);
     exit(2);
   }
 
-  for (int i = 2; i < argc; i++)
+  for (int i = first + 1; i < argc; i++)
     SetDebugForKey(argv[i], true);
 }
 
@@ -39,6 +39,20 @@ void Failure(const char *format, ...);
 #define Assert(expr)  \
   ((expr) ? (void)0 : Failure("Assertion failed: %s, line %d:\n    %s", __FILE__, __LINE__, #expr))
 
+/**
+ * Macro: DebugAssert()
+ * Usage: DebugAssert(index < count);
+ * ----------------------------------
+ * Like Assert, but compiled out of release builds (NDEBUG), for checks
+ * on paths too hot to pay for them there, such as List indexing.
+ */
+
+#ifdef NDEBUG
+#define DebugAssert(expr)  ((void)0)
+#else
+#define DebugAssert(expr)  Assert(expr)
+#endif
+
 /**
  * Function: PrintDebug()
  * Usage: PrintDebug("parser", "found ident %s\n", ident);
@@ -73,12 +87,24 @@ void SetDebugForKey(const char *key, bool val);
 
 bool IsDebugOn(const char *key);
 
+/**
+ * Function: GetOption()
+ * Usage: if (const char *s = GetOption("scanner")) ...
+ * ----------------------------------------------------
+ * Returns the value of a "--name=value" command-line option, the empty
+ * string for a bare "--name", or NULL if the option was not given.
+ */
+
+const char *GetOption(const char *name);
+
 /**
  * Function: ParseCommandLine
  * --------------------------
- * Turn on the debugging flags from the command line.  Verifies that
- * first argument is -d, and then interpret all the arguments that follow
- * as being flags to turn on.
+ * Turn on the debugging flags from the command line.  Any number of
+ * "--name[=value]" options may come first; they are recorded for
+ * GetOption, and a name the compiler does not read is a usage error
+ * (the list is in utility.cc). If anything follows, it must be -d, and all the arguments
+ * after it are interpreted as debugging flags to turn on.
  */
 
 void ParseCommandLine(int argc, char *argv[]);